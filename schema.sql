@@ -75,14 +75,35 @@ CREATE TABLE DimMetricType (
     Unit VARCHAR(20)
 );
 
+-- ============================================
+-- PARTITIONING (fact tables by month on DateKey)
+-- the months of CALENDAR::FIRST_YEAR to CALENDAR::LAST_YEAR (calendar.hh); etl create_schema adds
+-- the months missing after the range is raised
+-- ============================================
+
+IF NOT EXISTS (SELECT * FROM sys.partition_functions WHERE name='pf_DateKey')
+CREATE PARTITION FUNCTION pf_DateKey (INT) AS RANGE RIGHT FOR VALUES (
+    20200101, 20200201, 20200301, 20200401, 20200501, 20200601, 20200701, 20200801, 20200901, 20201001, 20201101, 20201201,
+    20210101, 20210201, 20210301, 20210401, 20210501, 20210601, 20210701, 20210801, 20210901, 20211001, 20211101, 20211201,
+    20220101, 20220201, 20220301, 20220401, 20220501, 20220601, 20220701, 20220801, 20220901, 20221001, 20221101, 20221201,
+    20230101, 20230201, 20230301, 20230401, 20230501, 20230601, 20230701, 20230801, 20230901, 20231001, 20231101, 20231201,
+    20240101, 20240201, 20240301, 20240401, 20240501, 20240601, 20240701, 20240801, 20240901, 20241001, 20241101, 20241201,
+    20250101, 20250201, 20250301, 20250401, 20250501, 20250601, 20250701, 20250801, 20250901, 20251001, 20251101, 20251201,
+    20260101, 20260201, 20260301, 20260401, 20260501, 20260601, 20260701, 20260801, 20260901, 20261001, 20261101, 20261201,
+    20270101
+);
+
+IF NOT EXISTS (SELECT * FROM sys.partition_schemes WHERE name='ps_DateKey')
+CREATE PARTITION SCHEME ps_DateKey AS PARTITION pf_DateKey ALL TO ([PRIMARY]);
+
 -- ============================================
 -- FACT TABLES
 -- ============================================
 
 IF NOT EXISTS (SELECT * FROM sys.tables WHERE name='FactDailyStock')
 CREATE TABLE FactDailyStock (
-    StockFactKey BIGINT PRIMARY KEY IDENTITY(1,1),
-    DateKey INT FOREIGN KEY REFERENCES DimDate(DateKey),
+    StockFactKey BIGINT IDENTITY(1,1) NOT NULL,
+    DateKey INT NOT NULL FOREIGN KEY REFERENCES DimDate(DateKey),
     CompanyKey INT FOREIGN KEY REFERENCES DimCompany(CompanyKey),
     OpenPrice DECIMAL(12,2),
     HighPrice DECIMAL(12,2),
@@ -95,13 +116,14 @@ CREATE TABLE FactDailyStock (
     DailyReturn DECIMAL(8,6),
     MovingAvg50 DECIMAL(12,2),
     MovingAvg200 DECIMAL(12,2),
-    RSI DECIMAL(6,2)
-);
+    RSI DECIMAL(6,2),
+    CONSTRAINT PK_FactDailyStock PRIMARY KEY (DateKey, StockFactKey)
+) ON ps_DateKey(DateKey);
 
 IF NOT EXISTS (SELECT * FROM sys.tables WHERE name='FactFinancials')
 CREATE TABLE FactFinancials (
-    FinancialKey BIGINT PRIMARY KEY IDENTITY(1,1),
-    DateKey INT FOREIGN KEY REFERENCES DimDate(DateKey),
+    FinancialKey BIGINT IDENTITY(1,1) NOT NULL,
+    DateKey INT NOT NULL FOREIGN KEY REFERENCES DimDate(DateKey),
     CompanyKey INT FOREIGN KEY REFERENCES DimCompany(CompanyKey),
     Revenue DECIMAL(18,2),
     GrossProfit DECIMAL(18,2),
@@ -123,8 +145,9 @@ CREATE TABLE FactFinancials (
     OperatingMargin DECIMAL(8,4),
     NetMargin DECIMAL(8,4),
     ROE DECIMAL(8,4),
-    ROA DECIMAL(8,4)
-);
+    ROA DECIMAL(8,4),
+    CONSTRAINT PK_FactFinancials PRIMARY KEY (DateKey, FinancialKey)
+) ON ps_DateKey(DateKey);
 
 IF NOT EXISTS (SELECT * FROM sys.tables WHERE name='FactValuation')
 CREATE TABLE FactValuation (
@@ -143,6 +166,44 @@ CREATE TABLE FactValuation (
     ShortRatio DECIMAL(8,2)
 );
 
+-- Sector x trading day aggregate of FactDailyStock, maintained by the ETL
+IF NOT EXISTS (SELECT * FROM sys.tables WHERE name='FactSectorDaily')
+CREATE TABLE FactSectorDaily (
+    DateKey INT NOT NULL FOREIGN KEY REFERENCES DimDate(DateKey),
+    Sector VARCHAR(50) NOT NULL,
+    Companies INT,
+    TotalMarketCap DECIMAL(20,2),
+    TotalVolume BIGINT,
+    AvgReturn DECIMAL(10,6),
+    PRIMARY KEY (DateKey, Sector)
+);
+
+-- only for a FactDailyStock created before partitioning, the partitioned table is clustered on DateKey
+IF NOT EXISTS (SELECT * FROM sys.indexes WHERE name='IX_FactDailyStock_DateKey')
+AND NOT EXISTS (SELECT * FROM sys.indexes i JOIN sys.partition_schemes ps ON ps.data_space_id=i.data_space_id
+    WHERE i.object_id=OBJECT_ID('FactDailyStock') AND i.index_id<=1)
+CREATE INDEX IX_FactDailyStock_DateKey ON FactDailyStock (DateKey)
+    INCLUDE (CompanyKey, Volume, MarketCap, DailyReturn);
+
+-- ============================================
+-- LOAD STATE (incremental ETL)
+-- ============================================
+
+IF NOT EXISTS (SELECT * FROM sys.tables WHERE name='EtlLoadState')
+CREATE TABLE EtlLoadState (
+    SourceName VARCHAR(260) PRIMARY KEY,
+    Fingerprint VARCHAR(64) NOT NULL,
+    LoadedAt DATETIME NOT NULL
+);
+
+IF NOT EXISTS (SELECT * FROM sys.tables WHERE name='EtlWatermark')
+CREATE TABLE EtlWatermark (
+    TableName VARCHAR(50) NOT NULL,
+    Ticker VARCHAR(10) NOT NULL,
+    MaxDateKey INT NOT NULL,
+    PRIMARY KEY (TableName, Ticker)
+);
+
 -- ============================================
 -- SEED DATA
 -- ============================================
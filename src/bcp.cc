@@ -0,0 +1,238 @@
+#include "bcp.hh"
+#include "log.hh"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//bcp_t::bcp_t
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bcp_t::bcp_t(odbc_t& odbc) :
+  m_odbc(odbc),
+  m_batch_size(BCP::BATCH_SIZE),
+  m_nbr_sent(0),
+  m_nbr_committed(0),
+  m_active(false)
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//bcp_t::~bcp_t
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bcp_t::~bcp_t()
+{
+  if (m_active)
+  {
+    done();
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//bcp_t::init
+//starts a bulk copy into 'table'; 'columns' names the columns sent, 'ctypes' has the C type of each
+//every 'batch_size' rows are committed with bcp_batch; 'tablock' takes a bulk update table lock
+//(hint TABLOCK), which allows minimal logging and parallel loads into a heap
+//columns are bound by their ordinal in sys.columns, not by position, so a table with more columns
+//(e.g. created by schema.sql) or in another order is loaded correctly; columns not sent are NULL or
+//their default, an identity column is generated by the server
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int bcp_t::init(const std::string& table, const std::vector<std::string>& columns, const std::vector<SQLSMALLINT>& ctypes,
+  int batch_size, bool tablock)
+{
+#ifdef HAVE_MSODBCSQL
+  if (columns.size() != ctypes.size())
+  {
+    LOG_ERROR("bcp", "Bulk copy into " << table << ": " << columns.size() << " columns, " << ctypes.size() << " types");
+    return -1;
+  }
+
+  //ordinals are read before bcp_init, the connection is used by the bulk copy afterwards
+  typed_table_t ordinals;
+  if (m_odbc.fetch("SELECT name, column_id FROM sys.columns WHERE object_id=OBJECT_ID(?)", { table }, ordinals) < 0)
+  {
+    return -1;
+  }
+  m_ordinals.assign(columns.size(), 0);
+  for (size_t idx = 0; idx < columns.size(); idx++)
+  {
+    for (size_t row = 0; row < ordinals.nbr_rows; row++)
+    {
+      if (ordinals.col("name").get_string(row) == columns[idx])
+      {
+        m_ordinals[idx] = static_cast<int>(ordinals.col("column_id").get_int(row));
+        break;
+      }
+    }
+    if (m_ordinals[idx] == 0)
+    {
+      LOG_ERROR("bcp", "Bulk copy into " << table << ": no column " << columns[idx]);
+      return -1;
+    }
+  }
+
+  m_ctypes = ctypes;
+  m_batch_size = batch_size > 0 ? batch_size : BCP::BATCH_SIZE;
+  m_nbr_sent = 0;
+  m_nbr_committed = 0;
+
+  //buffers are sized once, bcp_bind keeps pointers to the elements
+  m_dbl.assign(ctypes.size(), 0);
+  m_i64.assign(ctypes.size(), 0);
+  m_i32.assign(ctypes.size(), 0);
+  m_str.assign(ctypes.size(), std::string());
+
+  if (bcp_init(m_odbc.m_hdbc, table.c_str(), NULL, NULL, DB_IN) == FAIL)
+  {
+    extract_error(m_odbc.m_hdbc, SQL_HANDLE_DBC);
+    return -1;
+  }
+  m_active = true;
+
+  if (tablock && bcp_control(m_odbc.m_hdbc, BCPHINTS, (void*)"TABLOCK") == FAIL)
+  {
+    extract_error(m_odbc.m_hdbc, SQL_HANDLE_DBC);
+  }
+
+  for (size_t idx = 0; idx < m_ctypes.size(); idx++)
+  {
+    int col = m_ordinals[idx];
+    SQLRETURN rc = FAIL;
+    switch (m_ctypes[idx])
+    {
+    case SQL_C_DOUBLE:
+      rc = bcp_bind(m_odbc.m_hdbc, (const BYTE*)&m_dbl[idx], 0, sizeof(double), NULL, 0, SQLFLT8, col);
+      break;
+    case SQL_C_SBIGINT:
+      rc = bcp_bind(m_odbc.m_hdbc, (const BYTE*)&m_i64[idx], 0, sizeof(int64_t), NULL, 0, SQLINT8, col);
+      break;
+    case SQL_C_LONG:
+      rc = bcp_bind(m_odbc.m_hdbc, (const BYTE*)&m_i32[idx], 0, sizeof(int32_t), NULL, 0, SQLINT4, col);
+      break;
+    default:
+      //pointer and length are set for each row with bcp_colptr and bcp_collen
+      rc = bcp_bind(m_odbc.m_hdbc, NULL, 0, SQL_VARLEN_DATA, NULL, 0, SQLCHARACTER, col);
+      break;
+    }
+
+    if (rc == FAIL)
+    {
+      extract_error(m_odbc.m_hdbc, SQL_HANDLE_DBC);
+      done();
+      return -1;
+    }
+  }
+  return 0;
+#else
+  (void)columns;
+  (void)ctypes;
+  (void)batch_size;
+  (void)tablock;
+  LOG_ERROR("bcp", "Bulk copy into " << table << " requires the msodbcsql driver SDK (HAVE_MSODBCSQL)");
+  return -1;
+#endif
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//bcp_t::send_row
+//copies 'values' (one per column, NULL allowed) to the bound buffers and sends the row
+//numbers are converted to the column C type, e.g. a param_t(int) into a SQL_C_DOUBLE column
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int bcp_t::send_row(const std::vector<param_t>& values)
+{
+#ifdef HAVE_MSODBCSQL
+  if (!m_active || values.size() != m_ctypes.size())
+  {
+    return -1;
+  }
+
+  for (size_t idx = 0; idx < m_ctypes.size(); idx++)
+  {
+    const param_t& value = values[idx];
+    int col = m_ordinals[idx];
+    DBINT len = SQL_NULL_DATA;
+
+    if (value.ind != SQL_NULL_DATA)
+    {
+      switch (m_ctypes[idx])
+      {
+      case SQL_C_DOUBLE:
+        m_dbl[idx] = value.ctype == SQL_C_CHAR ? atof(value.str.c_str()) : value.dbl;
+        len = sizeof(double);
+        break;
+      case SQL_C_SBIGINT:
+        m_i64[idx] = value.ctype == SQL_C_CHAR ? atoll(value.str.c_str()) :
+          (value.ctype == SQL_C_DOUBLE ? static_cast<int64_t>(value.dbl) : value.i64);
+        len = sizeof(int64_t);
+        break;
+      case SQL_C_LONG:
+        m_i32[idx] = value.ctype == SQL_C_CHAR ? atoi(value.str.c_str()) :
+          (value.ctype == SQL_C_DOUBLE ? static_cast<int32_t>(value.dbl) : static_cast<int32_t>(value.i64));
+        len = sizeof(int32_t);
+        break;
+      default:
+        m_str[idx] = value.str;
+        len = static_cast<DBINT>(m_str[idx].size());
+        bcp_colptr(m_odbc.m_hdbc, (const BYTE*)m_str[idx].c_str(), col);
+        break;
+      }
+    }
+
+    if (bcp_collen(m_odbc.m_hdbc, len, col) == FAIL)
+    {
+      extract_error(m_odbc.m_hdbc, SQL_HANDLE_DBC);
+      return -1;
+    }
+  }
+
+  if (bcp_sendrow(m_odbc.m_hdbc) == FAIL)
+  {
+    extract_error(m_odbc.m_hdbc, SQL_HANDLE_DBC);
+    return -1;
+  }
+  m_nbr_sent++;
+
+  if (m_nbr_sent % m_batch_size == 0)
+  {
+    DBINT nbr_rows = bcp_batch(m_odbc.m_hdbc);
+    if (nbr_rows < 0)
+    {
+      extract_error(m_odbc.m_hdbc, SQL_HANDLE_DBC);
+      return -1;
+    }
+    m_nbr_committed += nbr_rows;
+  }
+  return 0;
+#else
+  (void)values;
+  return -1;
+#endif
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//bcp_t::done
+//commits the last batch and ends the bulk copy
+//returns total number of rows committed, -1 on error
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+long long bcp_t::done()
+{
+#ifdef HAVE_MSODBCSQL
+  if (!m_active)
+  {
+    return -1;
+  }
+  m_active = false;
+
+  DBINT nbr_rows = bcp_done(m_odbc.m_hdbc);
+  if (nbr_rows < 0)
+  {
+    extract_error(m_odbc.m_hdbc, SQL_HANDLE_DBC);
+    return -1;
+  }
+  m_nbr_committed += nbr_rows;
+  return m_nbr_committed;
+#else
+  return -1;
+#endif
+}
@@ -0,0 +1,50 @@
+#ifndef BCP_HH
+#define BCP_HH 1
+
+#include <string>
+#include <vector>
+#include "odbc.hh"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//BCP
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace BCP
+{
+  //rows sent between bcp_batch commits
+  const int BATCH_SIZE = 100000;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//bcp_t
+//bulk copy into a SQL Server table with the msodbcsql extensions (bcp_init, bcp_bind, bcp_sendrow,
+//bcp_batch, bcp_done); rows are streamed with the TDS bulk load protocol instead of INSERT statements
+//the odbc_t connection must be opened with connect(conn, true), which sets SQL_COPT_SS_BCP
+//requires the driver SDK header msodbcsql.h (HAVE_MSODBCSQL), otherwise init() returns -1
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class bcp_t
+{
+public:
+  bcp_t(odbc_t& odbc);
+  ~bcp_t();
+  int init(const std::string& table, const std::vector<std::string>& columns, const std::vector<SQLSMALLINT>& ctypes,
+    int batch_size = BCP::BATCH_SIZE, bool tablock = true);
+  int send_row(const std::vector<param_t>& values);
+  long long done();
+
+private:
+  odbc_t& m_odbc;
+  std::vector<SQLSMALLINT> m_ctypes; //C type of each column sent: SQL_C_DOUBLE, SQL_C_SBIGINT, SQL_C_LONG or SQL_C_CHAR
+  std::vector<int> m_ordinals; //server column ordinal (sys.columns.column_id) of each column sent
+  std::vector<double> m_dbl; //bound row buffers, one element per column
+  std::vector<int64_t> m_i64;
+  std::vector<int32_t> m_i32;
+  std::vector<std::string> m_str;
+  int m_batch_size;
+  long long m_nbr_sent;
+  long long m_nbr_committed;
+  bool m_active;
+};
+
+#endif
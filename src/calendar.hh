@@ -0,0 +1,129 @@
+#ifndef CALENDAR_HH
+#define CALENDAR_HH 1
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//CALENDAR
+//proleptic Gregorian calendar arithmetic for DimDate, without libc time calls (mktime, localtime)
+//all functions are constexpr, O(1) per date and independent of the time zone
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace CALENDAR
+{
+  const char* const MONTH_NAME[13] = { "", "January", "February", "March", "April", "May", "June",
+    "July", "August", "September", "October", "November", "December" };
+
+  const char* const DAY_NAME[7] = { "Sunday", "Monday", "Tuesday", "Wednesday", "Thursday", "Friday", "Saturday" };
+
+  //days before the first day of each month in a common year, month 1-12
+  constexpr int DAYS_BEFORE_MONTH[13] = { 0, 0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334 };
+
+  //federal fiscal year starts in October
+  constexpr int FISCAL_START_MONTH = 10;
+
+  //years of the warehouse: DimDate is loaded and the fact tables have monthly partitions for them,
+  //and datagen writes dates in them
+  constexpr int FIRST_YEAR = 2020;
+  constexpr int LAST_YEAR = 2026;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//is_leap_year
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+constexpr bool is_leap_year(int year)
+{
+  return year % 4 == 0 && (year % 100 != 0 || year % 400 == 0);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//days_in_month
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+constexpr int days_in_month(int year, int month)
+{
+  return month == 2 ? (is_leap_year(year) ? 29 : 28) :
+    ((month == 4 || month == 6 || month == 9 || month == 11) ? 30 : 31);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//day_of_year
+//0-based, January 1 is 0 (same as struct tm tm_yday)
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+constexpr int day_of_year(int year, int month, int day)
+{
+  return CALENDAR::DAYS_BEFORE_MONTH[month] + (month > 2 && is_leap_year(year) ? 1 : 0) + day - 1;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//days_from_civil
+//days since 1970-01-01 (negative before), era based, valid for any year
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+constexpr long long days_from_civil(int year, int month, int day)
+{
+  long long y = month <= 2 ? year - 1 : year;
+  long long era = (y >= 0 ? y : y - 399) / 400;
+  long long yoe = y - era * 400;
+  long long doy = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+  long long doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + doe - 719468;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//day_of_week
+//0 is Sunday (same as struct tm tm_wday); 1970-01-01 was a Thursday
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+constexpr int day_of_week(int year, int month, int day)
+{
+  long long days = days_from_civil(year, month, day);
+  return static_cast<int>((days % 7 + 11) % 7);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//calendar_day_t
+//DimDate attributes of one date
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct calendar_day_t
+{
+  int date_key; //YYYYMMDD
+  int year;
+  int quarter;
+  int month;
+  int day;
+  int week; //1-53, days 1-7 of the year are week 1
+  int day_of_week; //0 is Sunday
+  int is_weekend;
+  int fiscal_year;
+  int fiscal_quarter; //same formula as the rows already in DimDate: ((month + 5) / 3) % 4 + 1
+};
+
+constexpr calendar_day_t make_calendar_day(int year, int month, int day)
+{
+  return calendar_day_t
+  {
+    year * 10000 + month * 100 + day,
+    year,
+    (month - 1) / 3 + 1,
+    month,
+    day,
+    day_of_year(year, month, day) / 7 + 1,
+    day_of_week(year, month, day),
+    (day_of_week(year, month, day) == 0 || day_of_week(year, month, day) == 6) ? 1 : 0,
+    month >= CALENDAR::FISCAL_START_MONTH ? year + 1 : year,
+    ((month + 5) / 3) % 4 + 1
+  };
+}
+
+//checked at compile time
+static_assert(day_of_week(1970, 1, 1) == 4, "1970-01-01 is a Thursday");
+static_assert(day_of_week(2000, 2, 29) == 2, "2000-02-29 is a Tuesday");
+static_assert(day_of_week(2025, 12, 30) == 2, "2025-12-30 is a Tuesday");
+static_assert(day_of_week(1969, 12, 31) == 3, "1969-12-31 is a Wednesday");
+static_assert(day_of_year(2024, 12, 31) == 365, "2024 is a leap year");
+static_assert(make_calendar_day(2025, 10, 1).fiscal_year == 2026, "FY2026 starts in October 2025");
+static_assert(make_calendar_day(2025, 9, 30).fiscal_year == 2025, "FY2025 ends in September 2025");
+
+#endif
@@ -2,9 +2,22 @@
 #include <iostream>
 #include <string>
 #include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <algorithm>
 #include <assert.h>
 #include <stdlib.h>
 #include "csv.hh"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////
 //read_csv_t::read_csv_t
@@ -16,15 +29,29 @@ read_csv_t::read_csv_t()
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////
 //read_csv_t::open
+//reads the whole file into 'm_buffer' with one read, the buffer is sized from the file size first
 /////////////////////////////////////////////////////////////////////////////////////////////////////
 
 int read_csv_t::open(const std::string& file_name)
 {
-  ifs.open(file_name.c_str());
+  std::ifstream ifs(file_name.c_str(), std::ios::binary | std::ios::ate);
   if (!ifs)
   {
     return -1;
   }
+  std::streamoff size = ifs.tellg();
+  if (size < 0)
+  {
+    return -1;
+  }
+  m_buffer.resize(static_cast<size_t>(size));
+  ifs.seekg(0);
+  if (!ifs.read(&m_buffer[0], size))
+  {
+    m_buffer.clear();
+    return -1;
+  }
+  m_tokenizer.reset(m_buffer.data(), m_buffer.size());
   return 0;
 }
 
@@ -34,7 +61,8 @@ int read_csv_t::open(const std::string& file_name)
 
 void read_csv_t::close()
 {
-  ifs.close();
+  m_tokenizer.reset(nullptr, 0);
+  m_buffer.clear();
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -43,173 +71,357 @@ void read_csv_t::close()
 
 std::vector<std::string> read_csv_t::read_row_by_comma()
 {
-  bool quote_mode = false;
-  std::vector<std::string> row;
-  std::string column;
-  char c;
-  while (ifs.get(c))
-  {
-    switch (c)
-    {
-      /////////////////////////////////////////////////////////////////////////////////////////////////////
-      //separator ',' detected.
-      //in quote mode add character to column
-      //push column if not in quote mode
-      /////////////////////////////////////////////////////////////////////////////////////////////////////
-
-    case ',':
-      if (quote_mode == true)
-      {
-        column += c;
-      }
-      else
-      {
-        row.push_back(column);
-        column.clear();
-      }
-      break;
+  return read_row(',');
+}
 
-      /////////////////////////////////////////////////////////////////////////////////////////////////////
-      //quote '"' detected.
-      //toggle quote mode
-      /////////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//read_csv_t::read_row_by_tab
+/////////////////////////////////////////////////////////////////////////////////////////////////////
 
-    case '"':
-      quote_mode = !quote_mode;
-      break;
+std::vector<std::string> read_csv_t::read_row_by_tab()
+{
+  return read_row('\t');
+}
 
-      /////////////////////////////////////////////////////////////////////////////////////////////////////
-      //line end detected
-      //in quote mode add character to column
-      //return row if not in quote mode
-      /////////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//read_csv_t::read_row
+//returns empty vector if end of file detected
+/////////////////////////////////////////////////////////////////////////////////////////////////////
 
-    case '\n':
-    case '\r':
-      if (quote_mode == true)
-      {
-        column += c;
-      }
-      else
-      {
-        //push last column
-        row.push_back(column);
-        return row;
-      }
-      break;
+std::vector<std::string> read_csv_t::read_row(char separator)
+{
+  std::vector<std::string_view> fields;
+  m_tokenizer.set_separator(separator);
+  m_tokenizer.next_row(fields);
+  std::vector<std::string> row(fields.begin(), fields.end());
+  return row;
+}
 
-      /////////////////////////////////////////////////////////////////////////////////////////////////////
-      //default, add character to column
-      /////////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//parse_csv_parallel
+//a range boundary can fall inside a quoted field (which may hold line ends), so a range cannot simply
+//start at the first line end after its offset:
+//  pass 1   - per range, in parallel: the parity of its quotes, and its first row start assuming the
+//             range offset is outside quotes (speculative, the state is not known yet; it is almost
+//             always right, quoted fields are short)
+//  resolve  - the state at each offset is the XOR of the parities before it; the row start of a range
+//             whose offset is inside quotes is found again from that state
+//  pass 2   - the threads tokenize the ranges [start N, start N+1); the calling thread hands the chunks
+//             to 'visitor' while the threads parse at most RANGES_PER_THREAD ranges ahead of it
+/////////////////////////////////////////////////////////////////////////////////////////////////////
 
-    default:
-      column += c;
-      break;
-    }
+int parse_csv_parallel(const char* data, size_t size, size_t nbr_threads, bool ordered,
+  const std::function<int(csv_chunk_t& chunk)>& visitor)
+{
+  if (size == 0)
+  {
+    return 0;
   }
+  size_t nbr_ranges = (size + CSV_PARALLEL::RANGE_SIZE - 1) / CSV_PARALLEL::RANGE_SIZE;
+  nbr_threads = std::max<size_t>(1, std::min(nbr_threads, nbr_ranges));
 
   /////////////////////////////////////////////////////////////////////////////////////////////////////
-  //handle last row if file doesn't end with newline
+  //pass 1: quote parity and speculative row start of each range
   /////////////////////////////////////////////////////////////////////////////////////////////////////
 
-  if (!column.empty() || !row.empty())
+  std::vector<size_t> parity(nbr_ranges);
+  std::vector<size_t> starts(nbr_ranges + 1);
+  std::atomic<size_t> next_scan(0);
+  std::vector<std::thread> threads;
+  for (size_t idx = 0; idx < nbr_threads; idx++)
   {
-    row.push_back(column);
-    ifs.close();
-    return row;
+    threads.emplace_back([&]()
+      {
+        size_t range;
+        while ((range = next_scan.fetch_add(1)) < nbr_ranges)
+        {
+          size_t offset = range * CSV_PARALLEL::RANGE_SIZE;
+          size_t len = std::min(CSV_PARALLEL::RANGE_SIZE, size - offset);
+          parity[range] = count_quotes(data + offset, len) & 1;
+          starts[range] = csv_row_start(data, size, offset, false);
+        }
+      });
   }
+  for (size_t idx = 0; idx < threads.size(); idx++)
+  {
+    threads[idx].join();
+  }
+  threads.clear();
 
-  //return empty vector if end of file detected
-  ifs.close();
-  std::vector<std::string> v;
-  return v;
-}
-/////////////////////////////////////////////////////////////////////////////////////////////////////
-//read_csv_t::read_row_by_tab
-/////////////////////////////////////////////////////////////////////////////////////////////////////
-
-std::vector<std::string> read_csv_t::read_row_by_tab()
-{
-  bool quote_mode = false;
-  std::vector<std::string> row;
-  std::string column;
-  char c;
-  while (ifs.get(c))
+  size_t quoted = 0;
+  for (size_t range = 0; range < nbr_ranges; range++)
   {
-    switch (c)
+    if (quoted)
     {
-      /////////////////////////////////////////////////////////////////////////////////////////////////////
-      //separator '\t' detected.
-      //in quote mode add character to column
-      //push column if not in quote mode
-      /////////////////////////////////////////////////////////////////////////////////////////////////////
+      starts[range] = csv_row_start(data, size, range * CSV_PARALLEL::RANGE_SIZE, true);
+    }
+    quoted ^= parity[range];
+  }
+  starts[nbr_ranges] = size;
 
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+  //pass 2: tokenize the ranges; 'done' lists the finished ranges in completion order
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
 
-    case '\t':
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::vector<csv_chunk_t> chunks(nbr_ranges);
+  std::vector<char> ready(nbr_ranges, 0);
+  std::deque<size_t> done;
+  size_t next_parse = 0;
+  size_t nbr_delivered = 0;
+  size_t window = nbr_threads * CSV_PARALLEL::RANGES_PER_THREAD;
+  bool stop = false;
 
-      if (quote_mode == true)
-      {
-        column += c;
-      }
-      else
+  for (size_t idx = 0; idx < nbr_threads; idx++)
+  {
+    threads.emplace_back([&]()
       {
-        row.push_back(column);
-        column.clear();
-      }
-      break;
+        csv_tokenizer_t tokenizer;
+        size_t nbr_fields = 0;
+        size_t nbr_rows = 0;
+        while (true)
+        {
+          size_t range;
+          {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [&]() { return stop || next_parse >= nbr_ranges || next_parse < nbr_delivered + window; });
+            if (stop || next_parse >= nbr_ranges)
+            {
+              return;
+            }
+            range = next_parse++;
+          }
 
-      /////////////////////////////////////////////////////////////////////////////////////////////////////
-      //quote '"' detected.
-      //toggle quote mode
-      /////////////////////////////////////////////////////////////////////////////////////////////////////
+          //ranges have about the same rows, the arrays are sized from the previous one
+          csv_chunk_t chunk;
+          chunk.fields.reserve(nbr_fields + nbr_fields / 8);
+          chunk.ends.reserve(nbr_rows + nbr_rows / 8);
+          tokenizer.reset(data + starts[range], starts[range + 1] - starts[range]);
+          while (tokenizer.next_row(chunk.fields) > 0)
+          {
+            chunk.ends.push_back(chunk.fields.size());
+          }
+          tokenizer.swap_unquoted(chunk.unquoted);
+          nbr_fields = chunk.fields.size();
+          nbr_rows = chunk.size();
 
-    case '"':
-      quote_mode = !quote_mode;
-      break;
-
-      /////////////////////////////////////////////////////////////////////////////////////////////////////
-      //line end detected
-      //in quote mode add character to column
-      //return row if not in quote mode
-      /////////////////////////////////////////////////////////////////////////////////////////////////////
+          {
+            std::lock_guard<std::mutex> lock(mutex);
+            chunks[range] = std::move(chunk);
+            ready[range] = 1;
+            done.push_back(range);
+          }
+          cv.notify_all();
+        }
+      });
+  }
 
-    case '\n':
-    case '\r':
-      if (quote_mode == true)
+  int rc = 0;
+  for (size_t count = 0; count < nbr_ranges; count++)
+  {
+    csv_chunk_t chunk;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      size_t range = count;
+      if (ordered)
       {
-        column += c;
+        cv.wait(lock, [&]() { return ready[range] != 0; });
       }
       else
       {
-        //push last column
-        row.push_back(column);
-        return row;
+        cv.wait(lock, [&]() { return !done.empty(); });
+        range = done.front();
+        done.pop_front();
       }
+      chunk = std::move(chunks[range]);
+      nbr_delivered++;
+    }
+    cv.notify_all();
+    if (!chunk.empty() && visitor(chunk) < 0)
+    {
+      rc = -1;
       break;
+    }
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stop = true;
+  }
+  cv.notify_all();
+  for (size_t idx = 0; idx < threads.size(); idx++)
+  {
+    threads[idx].join();
+  }
+  return rc;
+}
 
-      /////////////////////////////////////////////////////////////////////////////////////////////////////
-      //default, add character to column
-      /////////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//map_csv_t::map_csv_t
+/////////////////////////////////////////////////////////////////////////////////////////////////////
 
-    default:
-      column += c;
-      break;
+map_csv_t::map_csv_t() :
+  m_data(nullptr),
+  m_size(0),
+#ifdef _WIN32
+  m_file(INVALID_HANDLE_VALUE),
+  m_mapping(nullptr)
+#else
+  m_fd(-1)
+#endif
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//map_csv_t::~map_csv_t
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+map_csv_t::~map_csv_t()
+{
+  close();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//map_csv_t::open
+//maps the whole file read-only; an empty file opens with no rows
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int map_csv_t::open(const std::string& file_name)
+{
+  close();
+
+#ifdef _WIN32
+  m_file = CreateFileA(file_name.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+    FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+  if (m_file == INVALID_HANDLE_VALUE)
+  {
+    return -1;
+  }
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(m_file, &size))
+  {
+    close();
+    return -1;
+  }
+  m_size = static_cast<size_t>(size.QuadPart);
+  if (m_size > 0)
+  {
+    m_mapping = CreateFileMappingA(m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (m_mapping == NULL)
+    {
+      close();
+      return -1;
+    }
+    m_data = static_cast<const char*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+    if (m_data == NULL)
+    {
+      close();
+      return -1;
+    }
+  }
+#else
+  m_fd = ::open(file_name.c_str(), O_RDONLY);
+  if (m_fd < 0)
+  {
+    return -1;
+  }
+  struct stat st;
+  if (fstat(m_fd, &st) < 0)
+  {
+    close();
+    return -1;
+  }
+  m_size = static_cast<size_t>(st.st_size);
+  if (m_size > 0)
+  {
+    void* data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, m_fd, 0);
+    if (data == MAP_FAILED)
+    {
+      close();
+      return -1;
     }
+    madvise(data, m_size, MADV_SEQUENTIAL);
+    m_data = static_cast<const char*>(data);
   }
+#endif
 
-  /////////////////////////////////////////////////////////////////////////////////////////////////////
-  //handle last row if file doesn't end with newline
-  /////////////////////////////////////////////////////////////////////////////////////////////////////
+  m_tokenizer.reset(m_data, m_size);
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//map_csv_t::close
+//unmaps the file; the fields returned by read_row are invalid afterwards
+/////////////////////////////////////////////////////////////////////////////////////////////////////
 
-  if (!column.empty() || !row.empty())
+void map_csv_t::close()
+{
+#ifdef _WIN32
+  if (m_data)
+  {
+    UnmapViewOfFile(m_data);
+  }
+  if (m_mapping)
+  {
+    CloseHandle(m_mapping);
+  }
+  if (m_file != INVALID_HANDLE_VALUE)
+  {
+    CloseHandle(m_file);
+  }
+  m_mapping = nullptr;
+  m_file = INVALID_HANDLE_VALUE;
+#else
+  if (m_data)
+  {
+    munmap(const_cast<char*>(m_data), m_size);
+  }
+  if (m_fd >= 0)
   {
-    row.push_back(column);
-    ifs.close();
-    return row;
+    ::close(m_fd);
   }
+  m_fd = -1;
+#endif
+  m_data = nullptr;
+  m_size = 0;
+  m_tokenizer.reset(nullptr, 0);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//map_csv_t::size
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t map_csv_t::size() const
+{
+  return m_size;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//map_csv_t::read_row
+//appends the fields of the next row to 'fields' (not cleared, see csv_chunk_t)
+//returns the number of fields appended, 0 at end of file; an empty line is one empty field
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t map_csv_t::read_row(std::vector<std::string_view>& fields)
+{
+  return m_tokenizer.next_row(fields);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//map_csv_t::read_parallel
+//rows from the current position to the end of the file, see parse_csv_parallel
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int map_csv_t::read_parallel(size_t nbr_threads, bool ordered, const std::function<int(csv_chunk_t& chunk)>& visitor)
+{
+  size_t pos = m_tokenizer.position();
+  int rc = parse_csv_parallel(m_data + pos, m_size - pos, nbr_threads, ordered, visitor);
 
-  //return empty vector if end of file detected
-  ifs.close();
-  std::vector<std::string> v;
-  return v;
+  //move the tokenizer to the end; the fields it copied for earlier read_row calls are kept
+  std::deque<std::string> unquoted;
+  m_tokenizer.swap_unquoted(unquoted);
+  m_tokenizer.reset(m_data + m_size, 0);
+  m_tokenizer.swap_unquoted(unquoted);
+  return rc;
 }
@@ -1,12 +1,29 @@
 #ifndef READ_CSV_HH
 #define READ_CSV_HH 1
 
-#include <fstream>
 #include <string>
+#include <string_view>
 #include <vector>
+#include <deque>
+#include <functional>
+#include "csv_scan.hh"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//CSV_PARALLEL
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace CSV_PARALLEL
+{
+  //bytes of a file per parallel parse task; the rows of a range are one csv_chunk_t
+  const size_t RANGE_SIZE = 1 << 20;
+
+  //ranges parsed or waiting for the caller, per thread, before the parse threads block
+  const size_t RANGES_PER_THREAD = 4;
+}
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////
 //read_csv_t
+//open reads the whole file; rows are split by csv_tokenizer_t and returned as copies
 /////////////////////////////////////////////////////////////////////////////////////////////////////
 
 class read_csv_t
@@ -18,7 +35,90 @@ public:
   std::vector<std::string> read_row_by_comma();
   std::vector<std::string> read_row_by_tab();
 private:
-  std::ifstream ifs;
+  std::string m_buffer;
+  csv_tokenizer_t m_tokenizer;
+  std::vector<std::string> read_row(char separator);
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//csv_row_t
+//one row of a map_csv_t, a view of consecutive fields; valid while the fields it points to are
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct csv_row_t
+{
+  const std::string_view* fields;
+  size_t nbr_fields;
+
+  size_t size() const { return nbr_fields; }
+  const std::string_view& operator[](size_t idx) const { return fields[idx]; }
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//csv_chunk_t
+//rows of a map_csv_t stored as one array of fields and the end offset of each row, so a chunk of
+//rows costs two allocations instead of one per row and one per field
+//'unquoted' holds the fields copied with quotes removed by a parallel parse (parse_csv_parallel); it
+//moves with the chunk
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct csv_chunk_t
+{
+  std::vector<std::string_view> fields;
+  std::vector<size_t> ends;
+  std::deque<std::string> unquoted;
+
+  size_t size() const { return ends.size(); }
+  bool empty() const { return ends.empty(); }
+  void clear() { fields.clear(); ends.clear(); unquoted.clear(); }
+  csv_row_t row(size_t idx) const
+  {
+    size_t start = idx == 0 ? 0 : ends[idx - 1];
+    return csv_row_t{ fields.data() + start, ends[idx] - start };
+  }
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//parse_csv_parallel
+//splits a buffer into ranges of CSV_PARALLEL::RANGE_SIZE bytes and parses them on 'nbr_threads'
+//threads; 'visitor' is called on the calling thread with the rows of each range, in file order if
+//'ordered', else as the ranges are done; a visitor that returns -1 stops the parse
+//the fields are views into 'data' (or into the chunk, see csv_chunk_t)
+//returns 0, -1 if stopped by the visitor
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int parse_csv_parallel(const char* data, size_t size, size_t nbr_threads, bool ordered,
+  const std::function<int(csv_chunk_t& chunk)>& visitor);
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//map_csv_t
+//comma separated file read through a read-only memory mapping; read_row appends the fields of the next
+//row as std::string_view pointing into the mapping, nothing is copied or allocated per row
+//rows are split by csv_tokenizer_t (quoting rules there)
+//the views stay valid until close(), so rows can be handed to other threads
+//read_parallel parses the rest of the file with parse_csv_parallel; the file is at its end afterwards
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class map_csv_t
+{
+public:
+  map_csv_t();
+  ~map_csv_t();
+  int open(const std::string& file_name);
+  void close();
+  size_t read_row(std::vector<std::string_view>& fields);
+  int read_parallel(size_t nbr_threads, bool ordered, const std::function<int(csv_chunk_t& chunk)>& visitor);
+  size_t size() const;
+private:
+  const char* m_data;
+  size_t m_size;
+  csv_tokenizer_t m_tokenizer;
+#ifdef _WIN32
+  void* m_file;
+  void* m_mapping;
+#else
+  int m_fd;
+#endif
 };
 
 #endif
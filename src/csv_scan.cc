@@ -0,0 +1,401 @@
+#include "csv_scan.hh"
+#include <cstring>
+#include <algorithm>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define CSV_SCAN_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CSV_SCAN_SSE2 1
+#endif
+
+#if defined(__PCLMUL__)
+#include <wmmintrin.h>
+#define CSV_SCAN_PCLMUL 1
+#endif
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//count_bits, lowest_bit
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static inline size_t count_bits(uint64_t bits)
+{
+#if defined(_MSC_VER)
+  return static_cast<size_t>(__popcnt64(bits));
+#else
+  return static_cast<size_t>(__builtin_popcountll(bits));
+#endif
+}
+
+static inline size_t lowest_bit(uint64_t bits)
+{
+#if defined(_MSC_VER)
+  unsigned long idx;
+  _BitScanForward64(&idx, bits);
+  return static_cast<size_t>(idx);
+#else
+  return static_cast<size_t>(__builtin_ctzll(bits));
+#endif
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//bits_between
+//mask of bits [lo, hi), 0 <= lo <= hi <= 64
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static inline uint64_t bits_between(size_t lo, size_t hi)
+{
+  if (lo >= hi)
+  {
+    return 0;
+  }
+  uint64_t below_hi = hi == 64 ? ~0ULL : (1ULL << hi) - 1;
+  uint64_t below_lo = (1ULL << lo) - 1;
+  return below_hi & ~below_lo;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//csv_scan_block
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void csv_scan_block(const char* block, char separator, csv_masks_t& masks)
+{
+#if defined(CSV_SCAN_AVX2)
+  __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block));
+  __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + 32));
+  auto match = [&](char c) -> uint64_t
+    {
+      __m256i v = _mm256_set1_epi8(c);
+      uint64_t bits_lo = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, v)));
+      uint64_t bits_hi = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, v)));
+      return bits_lo | (bits_hi << 32);
+    };
+  masks.separator = match(separator);
+  masks.quote = match('"');
+  masks.newline = match('\n') | match('\r');
+#elif defined(CSV_SCAN_SSE2)
+  __m128i v0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block));
+  __m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 16));
+  __m128i v2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 32));
+  __m128i v3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 48));
+  auto match = [&](char c) -> uint64_t
+    {
+      __m128i v = _mm_set1_epi8(c);
+      uint64_t b0 = static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v0, v)));
+      uint64_t b1 = static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v1, v)));
+      uint64_t b2 = static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v2, v)));
+      uint64_t b3 = static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v3, v)));
+      return b0 | (b1 << 16) | (b2 << 32) | (b3 << 48);
+    };
+  masks.separator = match(separator);
+  masks.quote = match('"');
+  masks.newline = match('\n') | match('\r');
+#else
+  masks.separator = 0;
+  masks.quote = 0;
+  masks.newline = 0;
+  for (size_t idx = 0; idx < CSV_SCAN::BLOCK_SIZE; idx++)
+  {
+    uint64_t bit = 1ULL << idx;
+    char c = block[idx];
+    masks.separator |= c == separator ? bit : 0;
+    masks.quote |= c == '"' ? bit : 0;
+    masks.newline |= (c == '\n' || c == '\r') ? bit : 0;
+  }
+#endif
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//prefix_xor
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint64_t prefix_xor(uint64_t bits)
+{
+#if defined(CSV_SCAN_PCLMUL)
+  __m128i product = _mm_clmulepi64_si128(_mm_set_epi64x(0, static_cast<long long>(bits)), _mm_set1_epi8(-1), 0);
+  return static_cast<uint64_t>(_mm_cvtsi128_si64(product));
+#else
+  bits ^= bits << 1;
+  bits ^= bits << 2;
+  bits ^= bits << 4;
+  bits ^= bits << 8;
+  bits ^= bits << 16;
+  bits ^= bits << 32;
+  return bits;
+#endif
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//count_quotes
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t count_quotes(const char* data, size_t size)
+{
+  csv_masks_t masks;
+  size_t nbr_quotes = 0;
+  size_t offset = 0;
+  for (; offset + CSV_SCAN::BLOCK_SIZE <= size; offset += CSV_SCAN::BLOCK_SIZE)
+  {
+    csv_scan_block(data + offset, ',', masks);
+    nbr_quotes += count_bits(masks.quote);
+  }
+  for (; offset < size; offset++)
+  {
+    nbr_quotes += data[offset] == '"' ? 1 : 0;
+  }
+  return nbr_quotes;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//csv_row_start
+//a row starts after a line end outside quotes, except between the '\r' and '\n' of a "\r\n"
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t csv_row_start(const char* data, size_t size, size_t offset, bool quoted)
+{
+  if (offset == 0)
+  {
+    return 0;
+  }
+  if (offset >= size)
+  {
+    return size;
+  }
+
+  //the byte before 'offset' is not a quote if it is a line end, so 'quoted' is its state too
+  char prev = data[offset - 1];
+  if (!quoted && (prev == '\n' || (prev == '\r' && data[offset] != '\n')))
+  {
+    return offset;
+  }
+
+  for (size_t idx = offset; idx < size; idx++)
+  {
+    char c = data[idx];
+    if (c == '"')
+    {
+      quoted = !quoted;
+    }
+    else if (!quoted && (c == '\n' || c == '\r'))
+    {
+      if (c == '\r' && idx + 1 < size && data[idx + 1] == '\n')
+      {
+        idx++;
+      }
+      return idx + 1;
+    }
+  }
+  return size;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//csv_tokenizer_t::csv_tokenizer_t
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+csv_tokenizer_t::csv_tokenizer_t() :
+  m_data(nullptr),
+  m_size(0),
+  m_pos(0),
+  m_separator(','),
+  m_block(0),
+  m_masks{ 0, 0, 0 },
+  m_quoted_in(0),
+  m_quoted_out(0),
+  m_ends(0)
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//csv_tokenizer_t::reset
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void csv_tokenizer_t::reset(const char* data, size_t size)
+{
+  m_data = data;
+  m_size = data ? size : 0;
+  m_pos = 0;
+  m_unquoted.clear();
+  m_block = 0;
+  m_ends = 0;
+  m_quoted_out = 0;
+  if (m_size > 0)
+  {
+    load_block(0, 0);
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//csv_tokenizer_t::set_separator
+//the current block is classified again; its field ends before the next row are dropped
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void csv_tokenizer_t::set_separator(char separator)
+{
+  if (separator == m_separator)
+  {
+    return;
+  }
+  m_separator = separator;
+  if (m_block < m_size)
+  {
+    load_block(m_block, m_quoted_in);
+    if (m_pos > m_block)
+    {
+      m_ends &= ~bits_between(0, std::min(m_pos - m_block, CSV_SCAN::BLOCK_SIZE));
+    }
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//csv_tokenizer_t::position
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t csv_tokenizer_t::position() const
+{
+  return m_pos;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//csv_tokenizer_t::swap_unquoted
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void csv_tokenizer_t::swap_unquoted(std::deque<std::string>& storage)
+{
+  m_unquoted.swap(storage);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//csv_tokenizer_t::load_block
+//classifies the block at 'offset'; the last block of the buffer is copied and padded with zeros, so
+//the kernel never reads past the buffer
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void csv_tokenizer_t::load_block(size_t offset, uint64_t quoted_in)
+{
+  const char* block = m_data + offset;
+  char tail[CSV_SCAN::BLOCK_SIZE];
+  if (offset + CSV_SCAN::BLOCK_SIZE > m_size)
+  {
+    memset(tail, 0, sizeof(tail));
+    memcpy(tail, m_data + offset, m_size - offset);
+    block = tail;
+  }
+  csv_scan_block(block, m_separator, m_masks);
+
+  uint64_t quoted = prefix_xor(m_masks.quote) ^ quoted_in;
+  m_block = offset;
+  m_quoted_in = quoted_in;
+  m_quoted_out = (quoted >> 63) ? ~0ULL : 0;
+  m_ends = (m_masks.separator | m_masks.newline) & ~quoted;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//csv_tokenizer_t::make_field
+//field text in [start, end) of the buffer, 'nbr_quotes' '"' characters inside
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::string_view csv_tokenizer_t::make_field(size_t start, size_t end, size_t nbr_quotes)
+{
+  if (nbr_quotes == 0)
+  {
+    return std::string_view(m_data + start, end - start);
+  }
+
+  //"text": the view between the quotes
+  if (nbr_quotes == 2 && end - start >= 2 && m_data[start] == '"' && m_data[end - 1] == '"')
+  {
+    return std::string_view(m_data + start + 1, end - start - 2);
+  }
+
+  //quotes removed, "" inside quotes is one quote
+  m_unquoted.push_back(std::string());
+  std::string& column = m_unquoted.back();
+  column.reserve(end - start);
+  bool quote_mode = false;
+  for (size_t idx = start; idx < end; idx++)
+  {
+    char c = m_data[idx];
+    if (c != '"')
+    {
+      column += c;
+    }
+    else if (quote_mode && idx + 1 < end && m_data[idx + 1] == '"')
+    {
+      column += c;
+      idx++;
+    }
+    else
+    {
+      quote_mode = !quote_mode;
+    }
+  }
+  return std::string_view(column);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//csv_tokenizer_t::next_row
+//pops the field ends of the current block lowest first, loading the next block when it has none left;
+//the quotes of each field are counted from the quote mask, so make_field looks at the bytes of a
+//field only if it has quotes
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t csv_tokenizer_t::next_row(std::vector<std::string_view>& fields)
+{
+  if (m_pos >= m_size)
+  {
+    return 0;
+  }
+
+  size_t nbr_fields = 0;
+  size_t start = m_pos;
+  size_t nbr_quotes = 0;
+  while (true)
+  {
+    size_t lo = start > m_block ? start - m_block : 0;
+    if (m_ends == 0)
+    {
+      nbr_quotes += count_bits(m_masks.quote & bits_between(std::min(lo, CSV_SCAN::BLOCK_SIZE), CSV_SCAN::BLOCK_SIZE));
+      if (m_block + CSV_SCAN::BLOCK_SIZE >= m_size)
+      {
+        //last row without a line end
+        fields.push_back(make_field(start, m_size, nbr_quotes));
+        nbr_fields++;
+        m_pos = m_size;
+        return nbr_fields;
+      }
+      load_block(m_block + CSV_SCAN::BLOCK_SIZE, m_quoted_out);
+      continue;
+    }
+
+    size_t bit = lowest_bit(m_ends);
+    m_ends &= m_ends - 1;
+    size_t idx = m_block + bit;
+    if (idx < start)
+    {
+      //'\n' of a "\r\n" that ended the previous row
+      continue;
+    }
+
+    nbr_quotes += count_bits(m_masks.quote & bits_between(lo, bit));
+    fields.push_back(make_field(start, idx, nbr_quotes));
+    nbr_fields++;
+    if (m_data[idx] == m_separator)
+    {
+      start = idx + 1;
+      nbr_quotes = 0;
+      continue;
+    }
+
+    if (m_data[idx] == '\r' && idx + 1 < m_size && m_data[idx + 1] == '\n')
+    {
+      idx++;
+    }
+    m_pos = idx + 1;
+    return nbr_fields;
+  }
+}
@@ -0,0 +1,93 @@
+#ifndef CSV_SCAN_HH
+#define CSV_SCAN_HH 1
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <stdint.h>
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//CSV_SCAN
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace CSV_SCAN
+{
+  //bytes classified per kernel call, one bit each in a 64-bit mask
+  const size_t BLOCK_SIZE = 64;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//csv_masks_t
+//bit N is set if byte N of a block is the separator, a quote, or a line end ('\n' or '\r')
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct csv_masks_t
+{
+  uint64_t separator;
+  uint64_t quote;
+  uint64_t newline;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//scanning kernel
+//  csv_scan_block - masks of 64 bytes, with AVX2 (2 x 32 bytes) or SSE2 (4 x 16 bytes) compares when
+//                   the compiler targets them, a scalar loop otherwise
+//  prefix_xor     - bit N is the XOR of bits 0..N; applied to the quote mask it sets the bits from
+//                   an opening quote up to its closing quote, i.e. the quoted regions (carry-less
+//                   multiply by all ones with PCLMUL, six shifts otherwise)
+//  count_quotes   - number of '"' in a buffer, from the quote masks; its parity is the quote state
+//                   after the buffer
+//  csv_row_start  - first row start at or after 'offset', given whether 'offset' is inside quotes;
+//                   'size' if no row starts there
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void csv_scan_block(const char* block, char separator, csv_masks_t& masks);
+uint64_t prefix_xor(uint64_t bits);
+size_t count_quotes(const char* data, size_t size);
+size_t csv_row_start(const char* data, size_t size, size_t offset, bool quoted);
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//csv_tokenizer_t
+//splits a buffer into rows of fields, one 64-byte block at a time: the kernel marks separators, quotes
+//and line ends, prefix_xor removes those inside quotes, and the remaining bits are field ends; bytes
+//between field ends are not looked at
+//  reset         - buffer to tokenize; it must stay valid while the fields are used
+//  next_row      - appends the fields of the next row to 'fields' as views into the buffer; returns the
+//                  number of fields appended, 0 at the end of the buffer; an empty line is one empty
+//                  field
+//  set_separator - ',' by default
+//  position      - offset of the next row in the buffer
+//  swap_unquoted - exchanges the storage of the copied fields with 'storage', so the fields outlive the
+//                  tokenizer (elements of a std::deque keep their address when the deque is swapped)
+//a quoted field ("a,b") is the view between its quotes; a field with an escaped quote ("a""b") or text
+//around its quotes is copied once with the quotes removed, into storage kept until the next reset
+//'\n', '\r' and "\r\n" end a row (outside quotes)
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class csv_tokenizer_t
+{
+public:
+  csv_tokenizer_t();
+  void reset(const char* data, size_t size);
+  void set_separator(char separator);
+  size_t next_row(std::vector<std::string_view>& fields);
+  size_t position() const;
+  void swap_unquoted(std::deque<std::string>& storage);
+
+private:
+  const char* m_data;
+  size_t m_size;
+  size_t m_pos; //start of the next row
+  char m_separator;
+  size_t m_block; //offset of the block in 'm_masks'
+  csv_masks_t m_masks;
+  uint64_t m_quoted_in; //all ones if the block starts inside quotes
+  uint64_t m_quoted_out; //same, for the next block
+  uint64_t m_ends; //field ends of the block not yet returned
+  std::deque<std::string> m_unquoted;
+  void load_block(size_t offset, uint64_t quoted_in);
+  std::string_view make_field(size_t start, size_t end, size_t nbr_quotes);
+};
+
+#endif
@@ -0,0 +1,385 @@
+#include "calendar.hh"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// DATAGEN
+// the generated dates end on the last day of LAST_YEAR; etl loads DimDate for the years of
+// CALENDAR (calendar.hh), so at most MAX_YEARS years of rows resolve to a DateKey
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace DATAGEN
+{
+  const int LAST_YEAR = CALENDAR::LAST_YEAR;
+  const int MAX_YEARS = CALENDAR::LAST_YEAR - CALENDAR::FIRST_YEAR + 1;
+
+  //output buffer of each CSV file
+  const size_t BUFFER_SIZE = 1 << 20;
+
+  const char* const SECTORS[11] = { "BASIC MATERIALS", "COMMUNICATION SERVICES", "CONSUMER CYCLICAL",
+    "CONSUMER DEFENSIVE", "ENERGY", "FINANCIAL SERVICES", "HEALTHCARE", "INDUSTRIALS", "REAL ESTATE",
+    "TECHNOLOGY", "UTILITIES" };
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// usage
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void usage(const char* program_name)
+{
+  std::cout << "Usage: " << program_name << " [OPTIONS]" << std::endl;
+  std::cout << std::endl;
+  std::cout << "Writes companies.csv, stock_data.csv and financials.csv with synthetic data" << std::endl;
+  std::cout << std::endl;
+  std::cout << "Options:" << std::endl;
+  std::cout << "  -t TICKERS    Number of companies (default: 500)" << std::endl;
+  std::cout << "  -y YEARS      Years of trading days, ending " << DATAGEN::LAST_YEAR << "-12-31 (1-"
+    << DATAGEN::MAX_YEARS << ", default: 1)" << std::endl;
+  std::cout << "  -o DIR        Output directory (default: current directory)" << std::endl;
+  std::cout << "  -s SEED       Random seed, same seed same files (default: 1)" << std::endl;
+  std::cout << "  -h, --help    Display this help message" << std::endl;
+  std::cout << std::endl;
+  std::cout << "Stock rows: TICKERS x 261 x YEARS, e.g. -t 6000 -y 7 writes about 11M rows" << std::endl;
+  std::cout << std::endl;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// company_t
+// per-ticker parameters of the random walk, drawn once
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct company_t
+{
+  std::string ticker;
+  std::string sector;
+  double price; //first open
+  double drift; //daily log return mean
+  double volatility; //daily log return standard deviation
+  double shares; //shares outstanding
+  double volume; //median daily volume
+  double revenue; //quarterly revenue in the first quarter
+  double net_margin;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// make_ticker
+// 0 -> AAAA, 1 -> AAAB, ...; unique for up to 26^4 companies
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::string make_ticker(size_t idx)
+{
+  std::string ticker(4, 'A');
+  for (int pos = 3; pos >= 0; pos--)
+  {
+    ticker[pos] = static_cast<char>('A' + idx % 26);
+    idx /= 26;
+  }
+  return ticker;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// cap_tier
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+const char* cap_tier(double market_cap)
+{
+  if (market_cap >= 200e9) return "Mega Cap";
+  if (market_cap >= 10e9) return "Large Cap";
+  if (market_cap >= 2e9) return "Mid Cap";
+  return "Small Cap";
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// open_csv
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+FILE* open_csv(const std::string& dir, const std::string& name, std::vector<char>& buffer)
+{
+  std::string path = dir.empty() ? name : dir + "/" + name;
+  FILE* file = fopen(path.c_str(), "w");
+  if (!file)
+  {
+    std::cout << "Error: cannot write " << path << std::endl;
+    return nullptr;
+  }
+  buffer.resize(DATAGEN::BUFFER_SIZE);
+  setvbuf(file, buffer.data(), _IOFBF, buffer.size());
+  return file;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// close_csv
+// closes a file opened by open_csv; a write error (e.g. disk full) found by ferror or by the final
+// flush in fclose fails the file
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int close_csv(FILE* file, const std::string& name)
+{
+  bool failed = ferror(file) != 0;
+  if (fclose(file) != 0)
+  {
+    failed = true;
+  }
+  if (failed)
+  {
+    std::cout << "Error: cannot write " << name << std::endl;
+    return -1;
+  }
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// trading_days
+// weekdays from January 1 of the first year to December 31 of LAST_YEAR, as YYYY-MM-DD
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::vector<std::string> trading_days(int years)
+{
+  std::vector<std::string> days;
+  char buf[32];
+  for (int year = DATAGEN::LAST_YEAR - years + 1; year <= DATAGEN::LAST_YEAR; year++)
+  {
+    for (int month = 1; month <= 12; month++)
+    {
+      for (int day = 1; day <= days_in_month(year, month); day++)
+      {
+        int wday = day_of_week(year, month, day);
+        if (wday == 0 || wday == 6)
+        {
+          continue;
+        }
+        snprintf(buf, sizeof(buf), "%04d-%02d-%02d", year, month, day);
+        days.push_back(buf);
+      }
+    }
+  }
+  return days;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// write_companies
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int write_companies(const std::string& dir, const std::vector<company_t>& companies, std::mt19937_64& rng)
+{
+  std::vector<char> buffer;
+  FILE* file = open_csv(dir, "companies.csv", buffer);
+  if (!file)
+  {
+    return -1;
+  }
+  std::uniform_int_distribution<int> founded(1850, 2015);
+  std::lognormal_distribution<double> employees(9.0, 1.5);
+
+  fprintf(file, "Ticker,CompanyName,Sector,Industry,CEO,Founded,Headquarters,Employees,MarketCapTier\n");
+  for (size_t idx = 0; idx < companies.size(); idx++)
+  {
+    const company_t& company = companies[idx];
+    fprintf(file, "%s,%s Corporation,%s,%s,Unknown,%d,USA,%lld,%s\n",
+      company.ticker.c_str(), company.ticker.c_str(), company.sector.c_str(), company.sector.c_str(),
+      founded(rng), static_cast<long long>(employees(rng)), cap_tier(company.price * company.shares));
+  }
+  if (close_csv(file, "companies.csv") < 0)
+  {
+    return -1;
+  }
+  std::cout << "Exported " << companies.size() << " companies" << std::endl;
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// write_stock_data
+// geometric random walk of the close, rows grouped by ticker in date order (the order the stock
+// loader expects); open gaps from the previous close, high and low extend past open and close,
+// volume rises with the size of the move
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int write_stock_data(const std::string& dir, const std::vector<company_t>& companies,
+  const std::vector<std::string>& days, std::mt19937_64& rng)
+{
+  std::vector<char> buffer;
+  FILE* file = open_csv(dir, "stock_data.csv", buffer);
+  if (!file)
+  {
+    return -1;
+  }
+  std::normal_distribution<double> normal(0.0, 1.0);
+  long long nbr_rows = 0;
+
+  fprintf(file, "Ticker,Date,OpenPrice,HighPrice,LowPrice,ClosePrice,Volume,MarketCap,DailyReturn\n");
+  for (size_t idx = 0; idx < companies.size(); idx++)
+  {
+    const company_t& company = companies[idx];
+    double sigma = company.volatility;
+    double prev_close = company.price;
+    for (size_t day = 0; day < days.size(); day++)
+    {
+      double open = prev_close * std::exp(0.3 * sigma * normal(rng));
+      double close = open * std::exp(company.drift - 0.5 * sigma * sigma + sigma * normal(rng));
+      close = std::min(std::max(close, 1.0), 1e6);
+      double high = std::max(open, close) * std::exp(0.5 * sigma * std::fabs(normal(rng)));
+      double low = std::min(open, close) * std::exp(-0.5 * sigma * std::fabs(normal(rng)));
+      double daily_return = day == 0 ? 0.0 : close / prev_close - 1.0;
+      double volume = company.volume * std::exp(0.4 * normal(rng)) * (1.0 + 20.0 * std::fabs(daily_return));
+
+      fprintf(file, "%s,%s,%.2f,%.2f,%.2f,%.2f,%lld,%.0f,%.6f\n",
+        company.ticker.c_str(), days[day].c_str(), open, high, low, close,
+        static_cast<long long>(volume), close * company.shares, daily_return);
+      prev_close = close;
+      nbr_rows++;
+    }
+  }
+  if (close_csv(file, "stock_data.csv") < 0)
+  {
+    return -1;
+  }
+  std::cout << "Exported " << nbr_rows << " stock quotes" << std::endl;
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// write_financials
+// one row per ticker and quarter end; revenue grows a few percent a quarter with noise, the
+// statement lines are ratios of revenue
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int write_financials(const std::string& dir, const std::vector<company_t>& companies, int years, std::mt19937_64& rng)
+{
+  std::vector<char> buffer;
+  FILE* file = open_csv(dir, "financials.csv", buffer);
+  if (!file)
+  {
+    return -1;
+  }
+  std::normal_distribution<double> normal(0.0, 1.0);
+  const int QUARTER_MONTH[4] = { 3, 6, 9, 12 };
+  long long nbr_rows = 0;
+
+  fprintf(file, "Ticker,QuarterEnd,Revenue,GrossProfit,OperatingIncome,NetIncome,EPS,EBITDA,TotalAssets,"
+    "TotalLiabilities,CashAndEquivalents,TotalDebt,FreeCashFlow,RnDExpense,GrossMargin,OperatingMargin,"
+    "NetMargin,ROE,ROA\n");
+  for (size_t idx = 0; idx < companies.size(); idx++)
+  {
+    const company_t& company = companies[idx];
+    double revenue = company.revenue;
+    for (int year = DATAGEN::LAST_YEAR - years + 1; year <= DATAGEN::LAST_YEAR; year++)
+    {
+      for (int quarter = 0; quarter < 4; quarter++)
+      {
+        revenue *= std::exp(0.01 + 0.05 * normal(rng));
+        double gross_margin = std::min(std::max(0.45 + 0.05 * normal(rng), 0.05), 0.95);
+        double operating_margin = gross_margin * 0.5;
+        double net_margin = std::min(std::max(company.net_margin + 0.02 * normal(rng), -0.5), 0.6);
+        double net_income = revenue * net_margin;
+        double assets = revenue * 4.0 * std::exp(0.1 * normal(rng));
+        double liabilities = assets * 0.6;
+        double equity = assets - liabilities;
+
+        fprintf(file, "%s,%04d-%02d-%02d,%.0f,%.0f,%.0f,%.0f,%.4f,%.0f,%.0f,%.0f,%.0f,%.0f,%.0f,%.0f,"
+          "%.4f,%.4f,%.4f,%.4f,%.4f\n",
+          company.ticker.c_str(), year, QUARTER_MONTH[quarter], days_in_month(year, QUARTER_MONTH[quarter]),
+          revenue, revenue * gross_margin, revenue * operating_margin, net_income,
+          net_income / company.shares, revenue * operating_margin * 1.2, assets, liabilities,
+          assets * 0.1, liabilities * 0.4, net_income * 0.9, revenue * 0.08,
+          gross_margin, operating_margin, net_margin, net_income * 4 / equity, net_income * 4 / assets);
+        nbr_rows++;
+      }
+    }
+  }
+  if (close_csv(file, "financials.csv") < 0)
+  {
+    return -1;
+  }
+  std::cout << "Exported " << nbr_rows << " financial statements" << std::endl;
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// main
+// writes the three CSV files of etl at a scale factor of TICKERS x YEARS
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char* argv[])
+{
+  size_t nbr_tickers = 500;
+  int years = 1;
+  std::string dir;
+  unsigned long long seed = 1;
+
+  for (int idx = 1; idx < argc; idx++)
+  {
+    std::string arg = argv[idx];
+    if (arg == "-h" || arg == "--help")
+    {
+      usage(argv[0]);
+      return 0;
+    }
+    else if (arg == "-t" && idx + 1 < argc)
+    {
+      nbr_tickers = static_cast<size_t>(atol(argv[++idx]));
+    }
+    else if (arg == "-y" && idx + 1 < argc)
+    {
+      years = atoi(argv[++idx]);
+    }
+    else if (arg == "-o" && idx + 1 < argc)
+    {
+      dir = argv[++idx];
+    }
+    else if (arg == "-s" && idx + 1 < argc)
+    {
+      seed = strtoull(argv[++idx], nullptr, 10);
+    }
+  }
+
+  if (nbr_tickers == 0 || nbr_tickers > 26 * 26 * 26 * 26 || years < 1 || years > DATAGEN::MAX_YEARS)
+  {
+    usage(argv[0]);
+    return 1;
+  }
+
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+  // per-ticker parameters: prices and sizes are log-normal, so a few companies are much larger
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+
+  std::mt19937_64 rng(seed);
+  std::lognormal_distribution<double> price(4.0, 1.0);
+  std::lognormal_distribution<double> shares(19.5, 1.2);
+  std::lognormal_distribution<double> volume(14.0, 1.0);
+  std::uniform_real_distribution<double> volatility(0.01, 0.03);
+  std::normal_distribution<double> drift(0.0003, 0.0004);
+  std::normal_distribution<double> net_margin(0.12, 0.08);
+  std::uniform_int_distribution<int> sector(0, 10);
+
+  std::vector<company_t> companies(nbr_tickers);
+  for (size_t idx = 0; idx < nbr_tickers; idx++)
+  {
+    company_t& company = companies[idx];
+    company.ticker = make_ticker(idx);
+    company.sector = DATAGEN::SECTORS[sector(rng)];
+    company.price = std::min(std::max(price(rng), 5.0), 2000.0);
+    company.drift = drift(rng);
+    company.volatility = volatility(rng);
+    company.shares = shares(rng);
+    company.volume = volume(rng);
+    company.revenue = company.price * company.shares * 0.05;
+    company.net_margin = net_margin(rng);
+  }
+
+  std::vector<std::string> days = trading_days(years);
+  std::cout << "Generating " << nbr_tickers << " companies x " << days.size() << " trading days" << std::endl;
+
+  if (write_companies(dir, companies, rng) < 0 ||
+    write_stock_data(dir, companies, days, rng) < 0 ||
+    write_financials(dir, companies, years, rng) < 0)
+  {
+    return 1;
+  }
+  return 0;
+}
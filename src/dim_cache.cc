@@ -0,0 +1,152 @@
+#include "dim_cache.hh"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//dim_cache_t::dim_cache_t
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+dim_cache_t::dim_cache_t() :
+  m_loaded(false)
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//dim_cache_t::load
+//replaces the cache contents with the current keys in the database
+//
+// SQL:
+//   SELECT Ticker, CompanyKey FROM DimCompany WHERE IsCurrent=1
+//   SELECT DateKey FROM DimDate
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int dim_cache_t::load(odbc_t& odbc)
+{
+  clear();
+
+  //both scans are read with a block cursor; restored at the end
+  size_t row_array_size = odbc.get_row_array_size();
+  odbc.set_row_array_size(ODBC::ROW_ARRAY_SIZE);
+
+  typed_table_t table;
+  if (odbc.fetch("SELECT Ticker, CompanyKey FROM DimCompany WHERE IsCurrent=1", table) < 0)
+  {
+    odbc.set_row_array_size(row_array_size);
+    return -1;
+  }
+
+  const typed_column_t& ticker = table.col("Ticker");
+  const typed_column_t& company_key = table.col("CompanyKey");
+  m_company_keys.reserve(table.nbr_rows);
+  for (size_t idx = 0; idx < table.nbr_rows; idx++)
+  {
+    m_company_keys[std::string(ticker.get_string(idx))] = static_cast<int>(company_key.get_int(idx));
+  }
+
+  if (odbc.fetch("SELECT DateKey FROM DimDate", table) < 0)
+  {
+    odbc.set_row_array_size(row_array_size);
+    m_company_keys.clear();
+    return -1;
+  }
+
+  const typed_column_t& date_key = table.col("DateKey");
+  m_date_keys.reserve(table.nbr_rows);
+  for (size_t idx = 0; idx < table.nbr_rows; idx++)
+  {
+    m_date_keys.insert(static_cast<int>(date_key.get_int(idx)));
+  }
+
+  odbc.set_row_array_size(row_array_size);
+  m_loaded = true;
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//dim_cache_t::clear
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void dim_cache_t::clear()
+{
+  m_company_keys.clear();
+  m_date_keys.clear();
+  m_loaded = false;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//dim_cache_t::is_loaded
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool dim_cache_t::is_loaded() const
+{
+  return m_loaded;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//dim_cache_t::get_company_key
+//current CompanyKey of 'ticker', -1 if not found
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int dim_cache_t::get_company_key(const std::string& ticker) const
+{
+  std::unordered_map<std::string, int>::const_iterator it = m_company_keys.find(ticker);
+  if (it == m_company_keys.end())
+  {
+    return -1;
+  }
+  return it->second;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//dim_cache_t::set_company_key
+//records the key of a DimCompany row inserted as the current row of 'ticker'
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void dim_cache_t::set_company_key(const std::string& ticker, int company_key)
+{
+  m_company_keys[ticker] = company_key;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//dim_cache_t::remove_company
+//forgets 'ticker' after its current row is expired (IsCurrent=0)
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void dim_cache_t::remove_company(const std::string& ticker)
+{
+  m_company_keys.erase(ticker);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//dim_cache_t::has_date_key
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool dim_cache_t::has_date_key(int date_key) const
+{
+  return m_date_keys.find(date_key) != m_date_keys.end();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//dim_cache_t::add_date_key
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void dim_cache_t::add_date_key(int date_key)
+{
+  m_date_keys.insert(date_key);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//dim_cache_t::nbr_companies
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t dim_cache_t::nbr_companies() const
+{
+  return m_company_keys.size();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//dim_cache_t::nbr_dates
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t dim_cache_t::nbr_dates() const
+{
+  return m_date_keys.size();
+}
@@ -0,0 +1,39 @@
+#ifndef DIM_CACHE_HH
+#define DIM_CACHE_HH 1
+
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include "odbc.hh"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//dim_cache_t
+//in-memory copy of the dimension keys used by the ETL lookups: ticker to current CompanyKey
+//(IsCurrent=1) and the set of DateKey values in DimDate
+//load() reads both with one query each; afterwards the cache is the authority for lookups and the
+//loaders keep it in sync as they insert or expire dimension rows, so a fact row is resolved in O(1)
+//without a round trip
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class dim_cache_t
+{
+public:
+  dim_cache_t();
+  int load(odbc_t& odbc);
+  void clear();
+  bool is_loaded() const;
+  int get_company_key(const std::string& ticker) const;
+  void set_company_key(const std::string& ticker, int company_key);
+  void remove_company(const std::string& ticker);
+  bool has_date_key(int date_key) const;
+  void add_date_key(int date_key);
+  size_t nbr_companies() const;
+  size_t nbr_dates() const;
+
+private:
+  std::unordered_map<std::string, int> m_company_keys;
+  std::unordered_set<int> m_date_keys;
+  bool m_loaded;
+};
+
+#endif
@@ -1,226 +1,37 @@
-#include "odbc.hh"
-#include "csv.hh"
+#include "etl.hh"
+#include "bcp.hh"
+#include "pipeline.hh"
+#include "calendar.hh"
+#include "log.hh"
 #include <iostream>
 #include <sstream>
 #include <iomanip>
 #include <ctime>
 #include <cstring>
 #include <cstdlib>
-
-/////////////////////////////////////////////////////////////////////////////////////////////////////
-// usage
-// same syntax as sqlcmd
-// -S localhost -d data_warehouse
-/////////////////////////////////////////////////////////////////////////////////////////////////////
-
-void usage(const char* program_name)
-{
-  std::cout << "Usage: " << program_name << " [OPTIONS]" << std::endl;
-  std::cout << std::endl;
-  std::cout << "Required options:" << std::endl;
-  std::cout << "  -S SERVER     SQL Server hostname or IP address" << std::endl;
-  std::cout << "  -d DATABASE   Database name" << std::endl;
-  std::cout << std::endl;
-  std::cout << "Optional options:" << std::endl;
-  std::cout << "  -U USER       SQL Server username (omit for trusted connection)" << std::endl;
-  std::cout << "  -P PASSWORD   SQL Server password" << std::endl;
-  std::cout << "  --delete  Delete all data from all tables" << std::endl;
-  std::cout << std::endl;
-}
-
-/////////////////////////////////////////////////////////////////////////////////////////////////////
-// etl_t
-// ETL for US Companies Data Warehouse using Kimball star schema
-// implements extract, transform, load operations for financial data
-/////////////////////////////////////////////////////////////////////////////////////////////////////
-
-class etl_t
-{
-public:
-  etl_t();
-  ~etl_t();
-  int connect(const std::string& server, const std::string& database,
-    const std::string& user = std::string(), const std::string& password = std::string());
-  int disconnect();
-  int create_schema();
-  int delete_data();
-  int load_date_dimension(int start_year, int end_year);
-  int load_companies_from_csv(const std::string& filename);
-  int load_stock_data_from_csv(const std::string& filename);
-  int load_financials_from_csv(const std::string& filename);
-  int update_company_scd2(const std::string& ticker, const std::string& field, const std::string& new_value);
-  int run_analytics();
-
-private:
-  odbc_t odbc;
-  int get_company_key(const std::string& ticker);
-  int get_date_key(const std::string& date_str);
-  std::string escape_sql(const std::string& str);
-};
-
-/////////////////////////////////////////////////////////////////////////////////////////////////////
-// main
-/////////////////////////////////////////////////////////////////////////////////////////////////////
-
-int main(int argc, char* argv[])
-{
-  std::string server;
-  std::string database;
-  std::string user;
-  std::string password;
-  bool delete_data = false;
-
-  /////////////////////////////////////////////////////////////////////////////////////////////////////
-  // parse command line
-  /////////////////////////////////////////////////////////////////////////////////////////////////////
-
-  for (int idx = 1; idx < argc; idx++)
-  {
-    std::string arg = argv[idx];
-    if (arg == "-h" || arg == "--help")
-    {
-      usage(argv[0]);
-      return 0;
-    }
-    else if (arg == "-S" && idx + 1 < argc)
-    {
-      server = argv[++idx];
-    }
-    else if (arg == "-d" && idx + 1 < argc)
-    {
-      database = argv[++idx];
-    }
-    else if (arg == "-U" && idx + 1 < argc)
-    {
-      user = argv[++idx];
-    }
-    else if (arg == "-P" && idx + 1 < argc)
-    {
-      password = argv[++idx];
-    }
-    else if (arg == "--delete")
-    {
-      delete_data = true;
-    }
-  }
-
-  /////////////////////////////////////////////////////////////////////////////////////////////////////
-  // validate required parameters
-  /////////////////////////////////////////////////////////////////////////////////////////////////////
-
-  if (server.empty())
-  {
-    usage(argv[0]);
-    return 1;
-  }
-
-  if (database.empty())
-  {
-    usage(argv[0]);
-    return 1;
-  }
-
-  /////////////////////////////////////////////////////////////////////////////////////////////////////
-  // display configuration
-  /////////////////////////////////////////////////////////////////////////////////////////////////////
-
-  std::cout << "ETL Configuration:" << std::endl;
-  std::cout << "  Server:   " << server << std::endl;
-  std::cout << "  Database: " << database << std::endl;
-  std::cout << "  User:     " << (user.empty() ? "(trusted connection)" : user) << std::endl;
-  std::cout << std::endl;
-
-  /////////////////////////////////////////////////////////////////////////////////////////////////////
-  // connect
-  /////////////////////////////////////////////////////////////////////////////////////////////////////
-
-  etl_t etl;
-
-  if (etl.connect(server, database, user, password) < 0)
-  {
-    return 1;
-  }
-
-  /////////////////////////////////////////////////////////////////////////////////////////////////////
-  // handle --delete
-  /////////////////////////////////////////////////////////////////////////////////////////////////////
-
-  if (delete_data)
-  {
-    if (etl.delete_data() < 0)
-    {
-      etl.disconnect();
-      return 1;
-    }
-    etl.disconnect();
-    return 0;
-  }
-
-  /////////////////////////////////////////////////////////////////////////////////////////////////////
-  // create schema
-  /////////////////////////////////////////////////////////////////////////////////////////////////////
-
-  if (etl.create_schema() < 0)
-  {
-    etl.disconnect();
-    return 1;
-  }
-
-  /////////////////////////////////////////////////////////////////////////////////////////////////////
-  // load date dimension
-  /////////////////////////////////////////////////////////////////////////////////////////////////////
-
-  if (etl.load_date_dimension(2020, 2026) < 0)
-  {
-    etl.disconnect();
-    return 1;
-  }
-
-  /////////////////////////////////////////////////////////////////////////////////////////////////////
-  // load from CSV files
-  /////////////////////////////////////////////////////////////////////////////////////////////////////
-
-  std::string companies_file = "companies.csv";
-  std::string stock_file = "stock_data.csv";
-  std::string financials_file = "financials.csv";
-
-  if (etl.load_companies_from_csv(companies_file) < 0)
-  {
-    etl.disconnect();
-    return 1;
-  }
-
-  if (etl.load_stock_data_from_csv(stock_file) < 0)
-  {
-    etl.disconnect();
-    return 1;
-  }
-
-  if (etl.load_financials_from_csv(financials_file) < 0)
-  {
-    etl.disconnect();
-    return 1;
-  }
-
-  /////////////////////////////////////////////////////////////////////////////////////////////////////
-  // run analytics
-  /////////////////////////////////////////////////////////////////////////////////////////////////////
-
-  if (etl.run_analytics() < 0)
-  {
-    etl.disconnect();
-    return 1;
-  }
-
-  etl.disconnect();
-  return 0;
-}
+#include <cmath>
+#include <algorithm>
+#include <thread>
+#include <functional>
+#include <fstream>
+#include <filesystem>
+#include <unordered_map>
+#include <unordered_set>
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////
 // etl_t::etl_t
 /////////////////////////////////////////////////////////////////////////////////////////////////////
 
-etl_t::etl_t()
+etl_t::etl_t() :
+  bulk_copy(false),
+  partition(0),
+  nbr_partitions(1),
+  incremental(true),
+  partition_switch(false),
+  parse_jobs(1),
+  input(nullptr),
+  nbr_errors(0),
+  close_history_loaded(false)
 {
 }
 
@@ -237,10 +48,11 @@ etl_t::~etl_t()
 /////////////////////////////////////////////////////////////////////////////////////////////////////
 
 int etl_t::connect(const std::string& server, const std::string& database,
-  const std::string& user, const std::string& password)
+  const std::string& user, const std::string& password, bool bulk_copy)
 {
-  std::string conn = make_conn(server, database, user, password);
-  return odbc.connect(conn);
+  this->conn = make_conn(server, database, user, password);
+  this->bulk_copy = bulk_copy;
+  return odbc.connect(conn, bulk_copy);
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -257,29 +69,49 @@ int etl_t::disconnect()
 // deletes all data from all tables (fact tables first due to foreign keys)
 // 
 // SQL operations:
-//   DELETE FROM FactFinancials  - clear financial statement facts
-//   DELETE FROM FactValuation   - clear valuation ratio facts
-//   DELETE FROM FactDailyStock  - clear daily stock price facts
+//   DELETE FROM EtlWatermark    - clear fact watermarks (if the table exists)
+//   DELETE FROM EtlLoadState    - clear source file fingerprints (if the table exists)
+//   DELETE FROM FactSectorDaily - clear sector/day aggregates (if the table exists)
+//   TRUNCATE TABLE FactFinancials - clear financial statement facts
+//   TRUNCATE TABLE FactValuation  - clear valuation ratio facts
+//   TRUNCATE TABLE FactDailyStock - clear daily stock price facts
 //   DELETE FROM DimCompany      - clear company dimension
 //   DELETE FROM DimSector       - clear sector dimension
 //   DELETE FROM DimDate         - clear date dimension
 //
-// note: fact tables must be deleted before dimensions due to foreign key constraints
+// note: fact tables must be deleted before dimensions due to foreign key constraints; no table
+// references the fact tables, so they are truncated (page deallocations, minimally logged, every
+// partition at once) instead of deleted row by row
 /////////////////////////////////////////////////////////////////////////////////////////////////////
 
 int etl_t::delete_data()
 {
-  if (odbc.exec_direct("DELETE FROM FactFinancials") < 0)
+  if (odbc.exec_direct("IF OBJECT_ID('EtlWatermark') IS NOT NULL DELETE FROM EtlWatermark") < 0)
+  {
+    assert(0);
+  }
+
+  if (odbc.exec_direct("IF OBJECT_ID('EtlLoadState') IS NOT NULL DELETE FROM EtlLoadState") < 0)
   {
     assert(0);
   }
 
-  if (odbc.exec_direct("DELETE FROM FactValuation") < 0)
+  if (odbc.exec_direct("IF OBJECT_ID('FactSectorDaily') IS NOT NULL DELETE FROM FactSectorDaily") < 0)
   {
     assert(0);
   }
 
-  if (odbc.exec_direct("DELETE FROM FactDailyStock") < 0)
+  if (odbc.exec_direct("TRUNCATE TABLE FactFinancials") < 0)
+  {
+    assert(0);
+  }
+
+  if (odbc.exec_direct("TRUNCATE TABLE FactValuation") < 0)
+  {
+    assert(0);
+  }
+
+  if (odbc.exec_direct("TRUNCATE TABLE FactDailyStock") < 0)
   {
     assert(0);
   }
@@ -299,811 +131,3151 @@ int etl_t::delete_data()
     assert(0);
   }
 
+  cache.clear();
   return 0;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////
-// etl_t::escape_sql
-// escapes single quotes in strings for SQL injection prevention
+// etl_t::number_param
+// converts a CSV numeric field to a statement parameter
+//
+// returns:
+//   DOUBLE parameter, NULL parameter if the field is empty or not a number (e.g., 'Unknown', 'NULL')
 /////////////////////////////////////////////////////////////////////////////////////////////////////
 
-std::string etl_t::escape_sql(const std::string& str)
+param_t etl_t::number_param(std::string_view value)
 {
-  std::string result;
-  for (size_t idx = 0; idx < str.size(); idx++)
+  //fields from map_csv_t are not NUL terminated; a number longer than the buffer is not a number
+  char buf[64];
+  if (value.empty() || value.size() >= sizeof(buf))
   {
-    if (str[idx] == '\'')
-    {
-      result += "''";
-    }
-    else
-    {
-      result += str[idx];
-    }
+    return param_t();
+  }
+  memcpy(buf, value.data(), value.size());
+  buf[value.size()] = '\0';
+
+  char* end = NULL;
+  double number = strtod(buf, &end);
+  if (end == buf || *end != '\0')
+  {
+    return param_t();
   }
-  return result;
+  return param_t(number);
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////
-// etl_t::get_company_key
-// retrieves surrogate key for a ticker symbol from DimCompany
-//
-// SQL query:
-//   SELECT CompanyKey FROM DimCompany WHERE Ticker='AAPL' AND IsCurrent=1
+// etl_t::flush_batch
+// executes the pending rows of a batched insert and clears 'rows' and 'labels'
 //
 // parameters:
-//   ticker - stock ticker symbol (e.g., 'AAPL', 'MSFT')
+//   labels - one description per row (e.g., 'AAPL 2025-12-30'), printed for rejected rows
+//   skipped - if not NULL, rows executed without effect are added to it, e.g. rows of
+//             'INSERT ... WHERE NOT EXISTS' already in the table
 //
 // returns:
-//   surrogate key (CompanyKey) if found, -1 if not found
-//
-// notes:
-//   - only returns current records (IsCurrent=1) for SCD Type 2 support
-//   - surrogate keys are used instead of natural keys for fact table joins
+//   number of rows inserted (row count of the statements), rejected rows are added to 'errors'
 /////////////////////////////////////////////////////////////////////////////////////////////////////
 
-int etl_t::get_company_key(const std::string& ticker)
+int etl_t::flush_batch(const std::string& sql, std::vector<std::vector<param_t>>& rows,
+  std::vector<std::string>& labels, int& errors, int* skipped)
 {
-  std::stringstream sql;
-  sql << "SELECT CompanyKey FROM DimCompany WHERE Ticker='" << ticker << "' AND IsCurrent=1";
+  if (rows.empty())
+  {
+    return 0;
+  }
 
-  table_t table;
-  if (odbc.fetch(sql.str(), table) < 0)
+  std::vector<SQLUSMALLINT> row_status;
+  long long nbr_affected = 0;
+  int count = odbc.execute_batch(sql, rows, row_status, &nbr_affected);
+  if (count < 0)
   {
-    return -1;
+    errors += static_cast<int>(rows.size());
+    count = 0;
+    nbr_affected = 0;
+  }
+  else
+  {
+    for (size_t idx = 0; idx < row_status.size(); idx++)
+    {
+      if (row_status[idx] == SQL_PARAM_ERROR)
+      {
+        LOG_WARN("etl", "Rejected " << labels[idx]);
+        errors++;
+      }
+    }
   }
 
-  if (table.rows.size() > 0)
+  LOG_DEBUG("etl", "Batch " << rows.size() << " rows, " << count << " executed, " << nbr_affected << " inserted");
+  if (skipped != NULL && count > nbr_affected)
   {
-    std::string key_str = table.get_row_col_value(0, "CompanyKey");
-    return atoi(key_str.c_str());
+    *skipped += count - static_cast<int>(nbr_affected);
   }
-  return -1;
+  rows.clear();
+  labels.clear();
+  return static_cast<int>(nbr_affected);
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////
-// etl_t::get_date_key
-// converts date string YYYY-MM-DD to date key YYYYMMDD
+// etl_t::merge_staged
+// runs the set-based MERGE of a staging table into its fact table, then drops the staging table
 //
-// parameters:
-//   date_str - date in ISO format (e.g., '2025-12-30')
+// 'merge_sql' is one batch that returns a single row:
+//   NbrInserted   - fact rows inserted
+//   NbrUnresolved - staged rows whose ticker has no current DimCompany row or whose date is not in DimDate
 //
 // returns:
-//   integer date key (e.g., 20251230) for DimDate lookup, -1 if parse fails
-//
-// notes:
-//   - date keys are integers for efficient joins and partitioning
-//   - format: YYYYMMDD allows natural sorting and range queries
+//   number of fact rows inserted, -1 on error; unresolved rows are added to 'errors'
 /////////////////////////////////////////////////////////////////////////////////////////////////////
 
-int etl_t::get_date_key(const std::string& date_str)
+int etl_t::merge_staged(const std::string& stage_table, const std::string& merge_sql, int& errors)
 {
-  int year = 0;
-  int month = 0;
-  int day = 0;
+  typed_table_t table;
+  int rc = odbc.fetch(merge_sql, table);
+  odbc.exec_direct("DROP TABLE " + stage_table);
+  if (rc < 0 || table.nbr_rows == 0)
+  {
+    return -1;
+  }
 
-  if (sscanf(date_str.c_str(), "%d-%d-%d", &year, &month, &day) == 3)
+  errors += static_cast<int>(table.col("NbrUnresolved").get_int(0));
+  return static_cast<int>(table.col("NbrInserted").get_int(0));
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// open_csv
+// opens a fact CSV file and skips its header row
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static int open_csv(map_csv_t& reader, const std::string& filename)
+{
+  if (reader.open(filename) < 0)
   {
-    return year * 10000 + month * 100 + day;
+    return -1;
   }
-  return -1;
+  std::vector<std::string_view> header;
+  if (reader.read_row(header) == 0)
+  {
+    reader.close();
+    return -1;
+  }
+  return 0;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////
-// etl_t::create_schema
-// creates all dimension and fact tables for the Kimball star schema
+// first_csv_month
+// returns the lowest month (YYYYMM) of the date column (second field) of a fact CSV file, 0 if the
+// file has no dated rows, -1 if it cannot be opened; the file is read with a reader of its own
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static int first_csv_month(const std::string& filename)
+{
+  map_csv_t reader;
+  if (open_csv(reader, filename) < 0)
+  {
+    return -1;
+  }
+
+  int first_month = 0;
+  std::vector<std::string_view> row;
+  while (reader.read_row(row) > 0)
+  {
+    int year = 0;
+    int month = 0;
+    if (row.size() > 1 && sscanf(std::string(row[1]).c_str(), "%d-%d", &year, &month) == 2)
+    {
+      int row_month = year * 100 + month;
+      if (first_month == 0 || row_month < first_month)
+      {
+        first_month = row_month;
+      }
+    }
+    row.clear();
+  }
+  reader.close();
+  return first_month;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// etl_t::run_pipeline
+// runs the rows of an open CSV file through three threads connected by bounded lock-free queues
 //
-// dimension tables:
-//   DimDate    - calendar dimension with fiscal year support (federal Oct-Sep)
-//   DimCompany - company dimension with SCD Type 2 for historical tracking
-//   DimSector  - industry sector classification
+//   read      - rows from 'input' if set (--jobs, see route_csv), else
+//               map_csv_t::read_row, rows grouped in chunks of PIPELINE::CHUNK_ROWS; the fields are
+//               views into the file mapping, the chunk holds no strings; with more than one parse job
+//               map_csv_t::read_parallel, one chunk per CSV_PARALLEL::RANGE_SIZE bytes, in file order
+//               (the indicators need the rows of a ticker in date order)
+//   transform - 'transform' (validation, key resolution, number conversion), then 'finish' once at the
+//               end of the file (may be empty) for rows the transform held back
+//   load      - 'load' (batched insert, bulk copy or staging insert), on the calling thread, which
+//               owns the connection
 //
-// fact tables:
-//   FactDailyStock - daily stock prices with foreign keys to DimDate and DimCompany
-//   FactFinancials - quarterly financial statements with revenue, margins, ratios
-//   FactValuation  - valuation ratios (P/E, P/S, EV/EBITDA, etc.)
+// 'transform' appends the fact rows it made to 'facts' (none, one, or rows held back from earlier calls)
+// and returns -1 to reject the row (added to 'errors')
+// 'load' returns -1 to stop the pipeline
 //
 // notes:
-//   - uses IF NOT EXISTS to allow idempotent schema creation
-//   - foreign keys enforce referential integrity between facts and dimensions
-//   - surrogate keys (IDENTITY) used for all dimension primary keys
+//   - a full queue blocks its producer, so at most PIPELINE::QUEUE_CHUNKS chunks wait between stages
+//   - the CSV is read and parsed while the database executes the previous batch
+//   - 'transform' must not use the connection; the key lookups read the dimension key cache only
+//   - the utilization of each stage is logged at the end; the stage near 100% is the bottleneck
+//
+// returns:
+//   0, -1 if 'load' failed
 /////////////////////////////////////////////////////////////////////////////////////////////////////
 
-int etl_t::create_schema()
+int etl_t::run_pipeline(map_csv_t& reader,
+  const std::function<int(const csv_row_t& row, std::vector<fact_row_t>& facts)>& transform,
+  const std::function<void(std::vector<fact_row_t>& facts)>& finish,
+  const std::function<int(fact_row_t& fact)>& load, int& errors)
 {
+  spsc_queue_t<csv_chunk_t> csv_queue(PIPELINE::QUEUE_CHUNKS);
+  spsc_queue_t<std::vector<fact_row_t>> fact_queue(PIPELINE::QUEUE_CHUNKS);
+  stage_stats_t read_stats("read");
+  stage_stats_t transform_stats("transform");
+  stage_stats_t load_stats("load");
+  int rejected = 0;
+
   /////////////////////////////////////////////////////////////////////////////////////////////////////
-  // DimDate
-  // calendar dimension table with fiscal year support
-  //
-  // SQL:
-  //   CREATE TABLE DimDate (
-  //     DateKey INT PRIMARY KEY,           -- integer key YYYYMMDD for efficient joins
-  //     FullDate DATE,                     -- actual date value
-  //     Year INT, Quarter INT, Month INT,  -- calendar attributes
-  //     MonthName VARCHAR(15),             -- 'January', 'February', etc.
-  //     Week INT, DayOfWeek VARCHAR(10),   -- week number and day name
-  //     IsWeekend BIT,                     -- 1 for Saturday/Sunday
-  //     FiscalYear INT, FiscalQuarter INT  -- federal fiscal year (Oct-Sep)
-  //   )
+  // read stage
   /////////////////////////////////////////////////////////////////////////////////////////////////////
 
-  std::string sql_dim_date =
-    "IF NOT EXISTS (SELECT * FROM sys.tables WHERE name='DimDate') "
-    "CREATE TABLE DimDate ("
-    "DateKey INT PRIMARY KEY, "
-    "FullDate DATE, Year INT, Quarter INT, Month INT, "
-    "MonthName VARCHAR(15), Week INT, DayOfWeek VARCHAR(10), "
-    "IsWeekend BIT, FiscalYear INT, FiscalQuarter INT)";
+  std::thread read_thread([&]()
+    {
+      long long start = now_us();
+      if (input != nullptr)
+      {
+        csv_chunk_t rows;
+        while (input->pop(rows, read_stats))
+        {
+          read_stats.items += static_cast<long long>(rows.size());
+          if (!csv_queue.push(std::move(rows), read_stats))
+          {
+            break;
+          }
+        }
+        input->cancel();
+        csv_queue.close();
+        read_stats.wall_us = now_us() - start;
+        return;
+      }
 
-  if (odbc.exec_direct(sql_dim_date) < 0)
-  {
-    return -1;
-  }
+      if (parse_jobs > 1)
+      {
+        reader.read_parallel(parse_jobs, true, [&](csv_chunk_t& chunk) -> int
+          {
+            read_stats.items += static_cast<long long>(chunk.size());
+            return csv_queue.push(std::move(chunk), read_stats) ? 0 : -1;
+          });
+        csv_queue.close();
+        read_stats.wall_us = now_us() - start;
+        return;
+      }
+
+      csv_chunk_t chunk;
+      chunk.ends.reserve(PIPELINE::CHUNK_ROWS);
+      bool cancelled = false;
+      while (reader.read_row(chunk.fields) > 0)
+      {
+        read_stats.items++;
+        chunk.ends.push_back(chunk.fields.size());
+        if (chunk.size() == PIPELINE::CHUNK_ROWS)
+        {
+          size_t nbr_fields = chunk.fields.size();
+          if (!csv_queue.push(std::move(chunk), read_stats))
+          {
+            cancelled = true;
+            break;
+          }
+          chunk.clear();
+          chunk.fields.reserve(nbr_fields);
+          chunk.ends.reserve(PIPELINE::CHUNK_ROWS);
+        }
+      }
+      if (!cancelled && !chunk.empty())
+      {
+        csv_queue.push(std::move(chunk), read_stats);
+      }
+      csv_queue.close();
+      read_stats.wall_us = now_us() - start;
+    });
+
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+  // transform stage
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+
+  std::thread transform_thread([&]()
+    {
+      long long start = now_us();
+      csv_chunk_t rows;
+      bool cancelled = false;
+      while (csv_queue.pop(rows, transform_stats))
+      {
+        std::vector<fact_row_t> facts;
+        facts.reserve(rows.size());
+        for (size_t idx = 0; idx < rows.size(); idx++)
+        {
+          if (transform(rows.row(idx), facts) < 0)
+          {
+            rejected++;
+          }
+        }
+        transform_stats.items += static_cast<long long>(facts.size());
+        if (!facts.empty() && !fact_queue.push(std::move(facts), transform_stats))
+        {
+          csv_queue.cancel();
+          cancelled = true;
+          break;
+        }
+      }
+      if (!cancelled && finish)
+      {
+        std::vector<fact_row_t> facts;
+        finish(facts);
+        transform_stats.items += static_cast<long long>(facts.size());
+        if (!facts.empty())
+        {
+          fact_queue.push(std::move(facts), transform_stats);
+        }
+      }
+      fact_queue.close();
+      transform_stats.wall_us = now_us() - start;
+    });
+
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+  // load stage
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+
+  long long start = now_us();
+  int rc = 0;
+  std::vector<fact_row_t> facts;
+  while (rc == 0 && fact_queue.pop(facts, load_stats))
+  {
+    for (size_t idx = 0; idx < facts.size(); idx++)
+    {
+      if (load(facts[idx]) < 0)
+      {
+        fact_queue.cancel();
+        rc = -1;
+        break;
+      }
+      load_stats.items++;
+    }
+  }
+  load_stats.wall_us = now_us() - start;
+
+  transform_thread.join();
+  read_thread.join();
+  errors += rejected;
+
+  log_stages("etl", { read_stats, transform_stats, load_stats });
+  return rc;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// etl_t::set_incremental
+// false (--full) reads every file and row; the load state is still written at the end
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void etl_t::set_incremental(bool incremental)
+{
+  this->incremental = incremental;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// etl_t::set_partition_switch
+// bulk loads (--switch) replace only the months present in the CSV files, see switch_months
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void etl_t::set_partition_switch(bool partition_switch)
+{
+  this->partition_switch = partition_switch;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// etl_t::set_parse_jobs
+// threads that parse each fact CSV file (--parse-jobs); 1 parses on the read stage thread
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void etl_t::set_parse_jobs(size_t parse_jobs)
+{
+  this->parse_jobs = parse_jobs > 0 ? parse_jobs : 1;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// file_fingerprint
+// size, modification time and FNV-1a 64-bit hash of the first and last FINGERPRINT::BLOCK_SIZE bytes
+// of a file, e.g. 'a3f1c2d4e5b60718-1f4a2c-17f0a3b2c4d5e6f7'
+// the cost does not grow with the file: a daily run checks gigabytes of unchanged CSV files by
+// reading 128 KB of each; an edit inside the file that keeps its size changes its modification time
+// returns an empty string if the file cannot be read
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static std::string file_fingerprint(const std::string& filename)
+{
+  std::error_code ec;
+  unsigned long long size = std::filesystem::file_size(filename, ec);
+  if (ec)
+  {
+    return std::string();
+  }
+  std::filesystem::file_time_type mtime = std::filesystem::last_write_time(filename, ec);
+  if (ec)
+  {
+    return std::string();
+  }
+
+  std::ifstream ifs(filename, std::ios::binary);
+  if (!ifs.is_open())
+  {
+    return std::string();
+  }
+
+  unsigned long long hash = 14695981039346656037ULL;
+  std::vector<char> buf(FINGERPRINT::BLOCK_SIZE);
+  unsigned long long offsets[2] = { 0, size > buf.size() ? size - buf.size() : 0 };
+  size_t nbr_blocks = size > buf.size() ? 2 : 1;
+  for (size_t idx_block = 0; idx_block < nbr_blocks; idx_block++)
+  {
+    ifs.seekg(static_cast<std::streamoff>(offsets[idx_block]));
+    ifs.read(buf.data(), buf.size());
+    std::streamsize len = ifs.gcount();
+    ifs.clear();
+    for (std::streamsize idx = 0; idx < len; idx++)
+    {
+      hash ^= static_cast<unsigned char>(buf[idx]);
+      hash *= 1099511628211ULL;
+    }
+  }
+
+  char fingerprint[64];
+  snprintf(fingerprint, sizeof(fingerprint), "%016llx-%llx-%llx", hash, size,
+    static_cast<unsigned long long>(mtime.time_since_epoch().count()));
+  return fingerprint;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// source_name
+// key of a file in EtlLoadState, its canonical path, so the same file run from another directory
+// or through another relative path has one fingerprint
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static std::string source_name(const std::string& filename)
+{
+  std::error_code ec;
+  std::filesystem::path path = std::filesystem::weakly_canonical(filename, ec);
+  if (ec)
+  {
+    return filename;
+  }
+  return path.string();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// etl_t::source_unchanged
+// computes the fingerprint of a CSV file and compares it with the one saved by the last clean load
+//
+// SQL:
+//   SELECT Fingerprint FROM EtlLoadState WHERE SourceName=?
+//
+// returns:
+//   1 if the file is unchanged (and incremental), 0 if it must be loaded, -1 if it cannot be read
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int etl_t::source_unchanged(const std::string& filename, std::string& fingerprint)
+{
+  fingerprint = file_fingerprint(filename);
+  if (fingerprint.empty())
+  {
+    LOG_ERROR("etl", "Cannot read " << filename);
+    return -1;
+  }
+  if (!incremental)
+  {
+    return 0;
+  }
+
+  table_t table;
+  if (odbc.fetch("SELECT Fingerprint FROM EtlLoadState WHERE SourceName=?", { source_name(filename) }, table) < 0)
+  {
+    return 0;
+  }
+  if (table.rows.size() > 0 && table.get_row_col_value(0, "Fingerprint") == fingerprint)
+  {
+    LOG_INFO("etl", "Skipped " << filename << " (unchanged since the last load)");
+    return 1;
+  }
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// etl_t::save_source
+// records the fingerprint of a file loaded without errors, keyed by its canonical path
+//
+// SQL:
+//   MERGE EtlLoadState AS t USING (SELECT ? AS SourceName, ? AS Fingerprint) AS s
+//   ON t.SourceName=s.SourceName
+//   WHEN MATCHED THEN UPDATE SET Fingerprint=s.Fingerprint, LoadedAt=GETDATE()
+//   WHEN NOT MATCHED THEN INSERT (SourceName, Fingerprint, LoadedAt) VALUES (s.SourceName, s.Fingerprint, GETDATE());
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int etl_t::save_source(const std::string& filename, const std::string& fingerprint)
+{
+  return odbc.execute(
+    "MERGE EtlLoadState AS t USING (SELECT ? AS SourceName, ? AS Fingerprint) AS s "
+    "ON t.SourceName=s.SourceName "
+    "WHEN MATCHED THEN UPDATE SET Fingerprint=s.Fingerprint, LoadedAt=GETDATE() "
+    "WHEN NOT MATCHED THEN INSERT (SourceName, Fingerprint, LoadedAt) VALUES (s.SourceName, s.Fingerprint, GETDATE());",
+    { source_name(filename), fingerprint });
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// etl_t::load_watermarks
+// reads the highest DateKey loaded per ticker into 'table'
+//
+// SQL:
+//   SELECT Ticker, MaxDateKey FROM EtlWatermark WHERE TableName=?
+//
+// notes:
+//   - watermarks are kept per Ticker, not per CompanyKey: an SCD Type 2 update creates a new CompanyKey
+//     for the same company and must not make its history look new
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int etl_t::load_watermarks(const std::string& table, std::unordered_map<std::string, int>& marks)
+{
+  marks.clear();
+  table_t result;
+  if (odbc.fetch("SELECT Ticker, MaxDateKey FROM EtlWatermark WHERE TableName=?", { table }, result) < 0)
+  {
+    return -1;
+  }
+  for (size_t idx = 0; idx < result.rows.size(); idx++)
+  {
+    marks[result.get_row_col_value(idx, "Ticker")] = atoi(result.get_row_col_value(idx, "MaxDateKey").c_str());
+  }
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// etl_t::save_watermarks
+// raises the watermark of each ticker in 'marks', in batches of ODBC::PARAMSET_SIZE
+//
+// SQL:
+//   MERGE EtlWatermark AS t USING (SELECT ? AS TableName, ? AS Ticker, ? AS MaxDateKey) AS s
+//   ON t.TableName=s.TableName AND t.Ticker=s.Ticker
+//   WHEN MATCHED AND s.MaxDateKey > t.MaxDateKey THEN UPDATE SET MaxDateKey=s.MaxDateKey
+//   WHEN NOT MATCHED THEN INSERT (TableName, Ticker, MaxDateKey) VALUES (...);
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int etl_t::save_watermarks(const std::string& table, const std::unordered_map<std::string, int>& marks)
+{
+  std::string sql =
+    "MERGE EtlWatermark AS t USING (SELECT ? AS TableName, ? AS Ticker, ? AS MaxDateKey) AS s "
+    "ON t.TableName=s.TableName AND t.Ticker=s.Ticker "
+    "WHEN MATCHED AND s.MaxDateKey > t.MaxDateKey THEN UPDATE SET MaxDateKey=s.MaxDateKey "
+    "WHEN NOT MATCHED THEN INSERT (TableName, Ticker, MaxDateKey) VALUES (s.TableName, s.Ticker, s.MaxDateKey);";
+
+  std::vector<std::vector<param_t>> rows;
+  std::vector<std::string> labels;
+  int errors = 0;
+  for (std::unordered_map<std::string, int>::const_iterator it = marks.begin(); it != marks.end(); ++it)
+  {
+    rows.push_back({ table, it->first, it->second });
+    labels.push_back(table + " " + it->first);
+    if (rows.size() == ODBC::PARAMSET_SIZE)
+    {
+      flush_batch(sql, rows, labels, errors);
+    }
+  }
+  flush_batch(sql, rows, labels, errors);
+  return errors > 0 ? -1 : 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// etl_t::rebuild_watermarks
+// sets the watermarks of 'table' after switch_months replaced months from 'first_month' (YYYYMM) on:
+// a ticker with rows in the table from that month on gets its highest DateKey, a ticker whose
+// watermark was in those months and has no rows there any more gets the end of the month before;
+// watermarks before 'first_month' are left alone, the months before it were not replaced
+// the tickers in 'dirty' (rows of the file not loaded) are set back to the end of the month before,
+// so the next incremental run loads their missing rows
+//
+// SQL:
+//   MERGE EtlWatermark AS t
+//   USING (SELECT c.Ticker, MAX(f.DateKey) AS MaxDateKey
+//          FROM FactDailyStock f JOIN DimCompany c ON c.CompanyKey=f.CompanyKey
+//          WHERE f.DateKey >= 20251200 GROUP BY c.Ticker) AS s
+//   ON t.TableName='FactDailyStock' AND t.Ticker=s.Ticker
+//   WHEN MATCHED THEN UPDATE SET MaxDateKey=s.MaxDateKey
+//   WHEN NOT MATCHED BY TARGET THEN INSERT (TableName, Ticker, MaxDateKey) VALUES ('FactDailyStock', s.Ticker, s.MaxDateKey)
+//   WHEN NOT MATCHED BY SOURCE AND t.TableName='FactDailyStock' AND t.MaxDateKey >= 20251200
+//     THEN UPDATE SET MaxDateKey=20251200;
+//
+//   UPDATE EtlWatermark SET MaxDateKey=? WHERE TableName=? AND Ticker=? AND MaxDateKey > ?
+//
+// notes:
+//   - the DateKey bound reads only the replaced months and the later ones (clustered index, DateKey
+//     leading), not the whole fact table
+//   - YYYYMM00 is below every day of the month, a row at or below it is not skipped
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int etl_t::rebuild_watermarks(const std::string& table, int first_month, const std::unordered_set<std::string>& dirty)
+{
+  std::string bound = std::to_string(first_month * 100);
+  std::string sql =
+    "MERGE EtlWatermark AS t "
+    "USING (SELECT c.Ticker, MAX(f.DateKey) AS MaxDateKey "
+    "FROM " + table + " f JOIN DimCompany c ON c.CompanyKey=f.CompanyKey "
+    "WHERE f.DateKey >= " + bound + " GROUP BY c.Ticker) AS s "
+    "ON t.TableName='" + table + "' AND t.Ticker=s.Ticker "
+    "WHEN MATCHED THEN UPDATE SET MaxDateKey=s.MaxDateKey "
+    "WHEN NOT MATCHED BY TARGET THEN INSERT (TableName, Ticker, MaxDateKey) VALUES ('" + table + "', s.Ticker, s.MaxDateKey) "
+    "WHEN NOT MATCHED BY SOURCE AND t.TableName='" + table + "' AND t.MaxDateKey >= " + bound + " "
+    "THEN UPDATE SET MaxDateKey=" + bound + ";";
+  if (odbc.exec_direct(sql) < 0)
+  {
+    return -1;
+  }
+
+  std::string sql_dirty = "UPDATE EtlWatermark SET MaxDateKey=? WHERE TableName=? AND Ticker=? AND MaxDateKey > ?";
+  std::vector<std::vector<param_t>> rows;
+  std::vector<std::string> labels;
+  int errors = 0;
+  for (std::unordered_set<std::string>::const_iterator it = dirty.begin(); it != dirty.end(); ++it)
+  {
+    rows.push_back({ first_month * 100, table, *it, first_month * 100 });
+    labels.push_back(table + " " + *it);
+    if (rows.size() == ODBC::PARAMSET_SIZE)
+    {
+      flush_batch(sql_dirty, rows, labels, errors);
+    }
+  }
+  flush_batch(sql_dirty, rows, labels, errors);
+  return errors > 0 ? -1 : 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// etl_t::fetch_close_history
+// reads the last INDICATORS::TAIL_ROWS closes of each ticker (rows of earlier CompanyKey versions
+// included) into 'close_history', with one query per run: load_facts_parallel calls it once and gives
+// each worker a copy
+//
+// parameters:
+//   marks  - the tickers to read, with their watermarks
+//   before - if not 0, a DateKey: the closes dated before it are read for every ticker, 'marks' is not
+//            used (--switch, the months from 'before' on are replaced)
+//
+// SQL:
+//   SELECT Ticker, DateKey, ClosePrice FROM (
+//     SELECT c.Ticker, s.DateKey, s.ClosePrice,
+//       ROW_NUMBER() OVER (PARTITION BY c.Ticker ORDER BY s.DateKey DESC) AS RowNbr
+//     FROM FactDailyStock s JOIN DimCompany c ON c.CompanyKey=s.CompanyKey
+//     WHERE s.DateKey >= 20230115 AND s.ClosePrice IS NOT NULL) r
+//   WHERE RowNbr <= 250 ORDER BY Ticker, DateKey
+//
+// notes:
+//   - the DateKey bound is two years (about 500 trading days) before the lowest watermark (or
+//     'before'), so the clustered index (DateKey leading) reads only the recent months instead of one
+//     fact scan per ticker; a ticker with no trades in those two years starts its indicators without
+//     history
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int etl_t::fetch_close_history(const std::unordered_map<std::string, int>& marks, int before)
+{
+  close_history.clear();
+  close_history_loaded = true;
+  if (marks.empty() && before == 0)
+  {
+    return 0;
+  }
+
+  std::string range;
+  if (before != 0)
+  {
+    range = "s.DateKey >= " + std::to_string(before - 20000) + " AND s.DateKey < " + std::to_string(before);
+  }
+  else
+  {
+    int min_mark = marks.begin()->second;
+    for (std::unordered_map<std::string, int>::const_iterator it = marks.begin(); it != marks.end(); ++it)
+    {
+      min_mark = std::min(min_mark, it->second);
+    }
+    range = "s.DateKey >= " + std::to_string(min_mark - 20000);
+  }
+
+  std::string sql =
+    "SELECT Ticker, DateKey, ClosePrice FROM ("
+    "SELECT c.Ticker, s.DateKey, s.ClosePrice, "
+    "ROW_NUMBER() OVER (PARTITION BY c.Ticker ORDER BY s.DateKey DESC) AS RowNbr "
+    "FROM FactDailyStock s JOIN DimCompany c ON c.CompanyKey=s.CompanyKey "
+    "WHERE " + range + " AND s.ClosePrice IS NOT NULL) r "
+    "WHERE RowNbr <= " + std::to_string(INDICATORS::TAIL_ROWS) + " ORDER BY Ticker, DateKey";
+
+  size_t row_array_size = odbc.get_row_array_size();
+  odbc.set_row_array_size(ODBC::ROW_ARRAY_SIZE);
+  typed_table_t table;
+  int rc = odbc.fetch(sql, table);
+  odbc.set_row_array_size(row_array_size);
+  if (rc < 0)
+  {
+    close_history_loaded = false;
+    return -1;
+  }
+
+  const typed_column_t& ticker = table.col("Ticker");
+  const typed_column_t& close = table.col("ClosePrice");
+  for (size_t idx = 0; idx < table.nbr_rows; idx++)
+  {
+    std::string symbol(ticker.get_string(idx));
+    if (before != 0 || marks.find(symbol) != marks.end())
+    {
+      close_history[symbol].push_back(close.get_double(idx));
+    }
+  }
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// etl_t::load_indicator_history
+// seeds the indicator engine with the closes of fetch_close_history for the tickers that have a
+// FactDailyStock watermark and belong to this partition; fetches them first if not done in this run
+// with 'before' (--switch), every ticker is seeded with its closes dated before that DateKey
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int etl_t::load_indicator_history(const std::unordered_map<std::string, int>& marks, indicator_engine_t& indicators,
+  int before)
+{
+  if ((!close_history_loaded || before != 0) && fetch_close_history(marks, before) < 0)
+  {
+    return -1;
+  }
+
+  for (std::unordered_map<std::string, std::vector<double>>::const_iterator it = close_history.begin();
+    it != close_history.end(); ++it)
+  {
+    if ((before != 0 || marks.find(it->first) != marks.end()) && in_partition(it->first))
+    {
+      for (size_t idx = 0; idx < it->second.size(); idx++)
+      {
+        indicators.add_history(it->first, it->second[idx]);
+      }
+    }
+  }
+
+  //the next load of this etl_t reads the closes it has just written
+  close_history.clear();
+  close_history_loaded = false;
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// etl_t::in_partition
+// true if the fact rows of 'ticker' are loaded by this etl_t (always true without --jobs)
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool etl_t::in_partition(const std::string& ticker) const
+{
+  return nbr_partitions <= 1 || std::hash<std::string>()(ticker) % nbr_partitions == partition;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// etl_t::load_facts_parallel
+// loads the stock and financials CSV files with 'jobs' worker threads
+//
+// notes:
+//   - each worker has its own etl_t and connection, and a copy of the dimension key cache; dimensions
+//     must be loaded before this call, workers only read them
+//   - worker N loads the tickers whose hash modulo 'jobs' is N, so two workers never insert the same
+//     (DateKey, CompanyKey) and the duplicate checks do not contend
+//   - each CSV file is read and parsed once, on the calling thread (with --parse-jobs threads), and its
+//     rows are sent to the input queue of the worker that loads their ticker (route_csv)
+//   - bulk mode truncates the fact tables once here; workers copy without TABLOCK, which would
+//     serialize them on the clustered primary key
+//   - the file fingerprints are checked here once; a file is marked loaded only if every worker loaded
+//     its partition without errors
+//   - the dates loaded by the workers are merged, refresh_sector_daily recomputes each one once
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int etl_t::load_facts_parallel(size_t jobs, const std::string& stock_file, const std::string& financials_file,
+  bool bulk, bool staging)
+{
+  std::string stock_fingerprint;
+  std::string financials_fingerprint;
+  int stock_unchanged = source_unchanged(stock_file, stock_fingerprint);
+  int financials_unchanged = source_unchanged(financials_file, financials_fingerprint);
+  if (stock_unchanged < 0 || financials_unchanged < 0)
+  {
+    return -1;
+  }
+  bool load_stock = stock_unchanged == 0;
+  bool load_financials = financials_unchanged == 0;
+
+  if (bulk)
+  {
+    if (load_stock && (odbc.exec_direct("TRUNCATE TABLE FactDailyStock") < 0 ||
+      odbc.exec_direct("TRUNCATE TABLE FactSectorDaily") < 0 ||
+      odbc.exec_direct("DELETE FROM EtlWatermark WHERE TableName='FactDailyStock'") < 0))
+    {
+      return -1;
+    }
+    if (load_financials && (odbc.exec_direct("TRUNCATE TABLE FactFinancials") < 0 ||
+      odbc.exec_direct("DELETE FROM EtlWatermark WHERE TableName='FactFinancials'") < 0))
+    {
+      return -1;
+    }
+  }
+
+  //the indicator history is read once here, not by every worker
+  if (load_stock && incremental && !bulk)
+  {
+    std::unordered_map<std::string, int> marks;
+    if (load_watermarks("FactDailyStock", marks) < 0 || fetch_close_history(marks) < 0)
+    {
+      return -1;
+    }
+  }
+
+  //one input queue per worker and file; the queues are filled by route_csv on this thread
+  std::deque<spsc_queue_t<csv_chunk_t>> stock_queues;
+  std::deque<spsc_queue_t<csv_chunk_t>> financials_queues;
+  for (size_t idx = 0; idx < jobs; idx++)
+  {
+    stock_queues.emplace_back(PIPELINE::QUEUE_CHUNKS);
+    financials_queues.emplace_back(PIPELINE::QUEUE_CHUNKS);
+  }
+
+  std::vector<int> results(jobs, 0);
+  std::vector<int> stock_errors(jobs, 0);
+  std::vector<int> financials_errors(jobs, 0);
+  std::vector<std::set<int>> dates(jobs);
+  std::vector<std::thread> workers;
+  for (size_t idx = 0; idx < jobs; idx++)
+  {
+    workers.emplace_back([this, idx, jobs, &results, &stock_errors, &financials_errors, &dates, &stock_file,
+      &financials_file, &stock_queues, &financials_queues, load_stock, load_financials, bulk, staging]()
+      {
+        etl_t worker;
+        worker.cache = cache;
+        worker.partition = idx;
+        worker.nbr_partitions = jobs;
+        worker.incremental = incremental;
+        worker.parse_jobs = parse_jobs;
+        worker.close_history = close_history;
+        worker.close_history_loaded = close_history_loaded;
+        worker.conn = conn;
+        worker.bulk_copy = bulk_copy;
+        if (worker.odbc.connect(conn, bulk_copy) < 0)
+        {
+          stock_queues[idx].cancel();
+          financials_queues[idx].cancel();
+          results[idx] = -1;
+          return;
+        }
+
+        if (load_stock)
+        {
+          worker.input = &stock_queues[idx];
+          if (worker.load_stock_data_from_csv(stock_file, bulk, staging) < 0)
+          {
+            results[idx] = -1;
+          }
+          stock_errors[idx] = worker.nbr_errors;
+          dates[idx].swap(worker.loaded_dates);
+        }
+        if (load_financials && results[idx] == 0)
+        {
+          worker.input = &financials_queues[idx];
+          if (worker.load_financials_from_csv(financials_file, bulk, staging) < 0)
+          {
+            results[idx] = -1;
+          }
+          financials_errors[idx] = worker.nbr_errors;
+        }
+
+        //rows not taken (a failed or skipped load) are dropped by route_csv instead of blocking it
+        stock_queues[idx].cancel();
+        financials_queues[idx].cancel();
+        worker.input = nullptr;
+        worker.disconnect();
+      });
+  }
+
+  //the mappings stay open until the workers are done, the routed fields point into them
+  map_csv_t stock_reader;
+  map_csv_t financials_reader;
+  std::deque<std::deque<std::string>> unquoted;
+  int rc = 0;
+  if (load_stock && route_csv(stock_reader, stock_file, stock_queues, unquoted) < 0)
+  {
+    rc = -1;
+  }
+  if (load_financials && route_csv(financials_reader, financials_file, financials_queues, unquoted) < 0)
+  {
+    rc = -1;
+  }
+
+  int nbr_stock_errors = 0;
+  int nbr_financials_errors = 0;
+  for (size_t idx = 0; idx < jobs; idx++)
+  {
+    workers[idx].join();
+    if (results[idx] < 0)
+    {
+      LOG_ERROR("etl", "Job " << idx << " failed");
+      rc = -1;
+    }
+    nbr_stock_errors += stock_errors[idx];
+    nbr_financials_errors += financials_errors[idx];
+    loaded_dates.insert(dates[idx].begin(), dates[idx].end());
+  }
+  close_history.clear();
+  close_history_loaded = false;
+
+  if (rc == 0 && load_stock && nbr_stock_errors == 0)
+  {
+    save_source(stock_file, stock_fingerprint);
+  }
+  if (rc == 0 && load_financials && nbr_financials_errors == 0)
+  {
+    save_source(financials_file, financials_fingerprint);
+  }
+  return rc;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// etl_t::route_csv
+// reads a fact CSV file once and sends each row to the input queue of the worker that loads its ticker
+// (hash of the first column modulo the number of queues, as in_partition), in chunks of
+// PIPELINE::CHUNK_ROWS; closes every queue at the end
+//
+// notes:
+//   - the rows of a worker keep their file order, so each ticker's rows still arrive grouped and in
+//     date order for the indicators
+//   - fields copied by a parallel parse (csv_chunk_t::unquoted) are moved to 'unquoted', which must
+//     outlive the workers like 'reader'
+//   - a queue cancelled by its worker is skipped; the other workers still get their rows
+//
+// returns:
+//   0, -1 if the file cannot be read
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int etl_t::route_csv(map_csv_t& reader, const std::string& filename, std::deque<spsc_queue_t<csv_chunk_t>>& queues,
+  std::deque<std::deque<std::string>>& unquoted)
+{
+  size_t nbr_queues = queues.size();
+  if (open_csv(reader, filename) < 0)
+  {
+    for (size_t idx = 0; idx < nbr_queues; idx++)
+    {
+      queues[idx].close();
+    }
+    return -1;
+  }
+
+  stage_stats_t route_stats("route");
+  long long start = now_us();
+  std::vector<csv_chunk_t> chunks(nbr_queues);
+  std::vector<bool> cancelled(nbr_queues, false);
+
+  auto send = [&](size_t idx)
+    {
+      if (!cancelled[idx] && !queues[idx].push(std::move(chunks[idx]), route_stats))
+      {
+        cancelled[idx] = true;
+      }
+      chunks[idx].clear();
+    };
+
+  auto route = [&](csv_chunk_t& rows) -> int
+    {
+      for (size_t row_idx = 0; row_idx < rows.size(); row_idx++)
+      {
+        csv_row_t row = rows.row(row_idx);
+        size_t idx = std::hash<std::string_view>()(row[0]) % nbr_queues;
+        csv_chunk_t& chunk = chunks[idx];
+        chunk.fields.insert(chunk.fields.end(), row.fields, row.fields + row.size());
+        chunk.ends.push_back(chunk.fields.size());
+        if (chunk.size() == PIPELINE::CHUNK_ROWS)
+        {
+          send(idx);
+        }
+      }
+      route_stats.items += static_cast<long long>(rows.size());
+      if (!rows.unquoted.empty())
+      {
+        unquoted.push_back(std::move(rows.unquoted));
+      }
+      return 0;
+    };
+
+  if (parse_jobs > 1)
+  {
+    reader.read_parallel(parse_jobs, true, route);
+  }
+  else
+  {
+    csv_chunk_t rows;
+    while (reader.read_row(rows.fields) > 0)
+    {
+      rows.ends.push_back(rows.fields.size());
+      if (rows.size() == PIPELINE::CHUNK_ROWS)
+      {
+        route(rows);
+        rows.clear();
+      }
+    }
+    route(rows);
+  }
+
+  for (size_t idx = 0; idx < nbr_queues; idx++)
+  {
+    if (!chunks[idx].empty())
+    {
+      send(idx);
+    }
+    queues[idx].close();
+  }
+  route_stats.wall_us = now_us() - start;
+  log_stages("etl", { route_stats });
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// etl_t::get_company_key
+// retrieves surrogate key for a ticker symbol from the dimension key cache
+//
+// SQL query before load_cache (prepared once, ticker bound as parameter):
+//   SELECT CompanyKey FROM DimCompany WHERE Ticker=? AND IsCurrent=1
+//
+// parameters:
+//   ticker - stock ticker symbol (e.g., 'AAPL', 'MSFT')
+//
+// returns:
+//   surrogate key (CompanyKey) if found, -1 if not found
+//
+// notes:
+//   - only returns current records (IsCurrent=1) for SCD Type 2 support
+//   - surrogate keys are used instead of natural keys for fact table joins
+//   - once the cache is loaded it holds every current key, a miss means the ticker is not in DimCompany
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int etl_t::get_company_key(const std::string& ticker)
+{
+  if (cache.is_loaded())
+  {
+    return cache.get_company_key(ticker);
+  }
+
+  table_t table;
+  if (odbc.fetch("SELECT CompanyKey FROM DimCompany WHERE Ticker=? AND IsCurrent=1", { ticker }, table) < 0)
+  {
+    return -1;
+  }
+
+  if (table.rows.size() > 0)
+  {
+    std::string key_str = table.get_row_col_value(0, "CompanyKey");
+    return atoi(key_str.c_str());
+  }
+  return -1;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// etl_t::get_date_key
+// converts date string YYYY-MM-DD to date key YYYYMMDD
+//
+// parameters:
+//   date_str - date in ISO format (e.g., '2025-12-30')
+//
+// returns:
+//   integer date key (e.g., 20251230) for DimDate lookup, -1 if parse fails or, once the cache is loaded,
+//   if the date is not in DimDate (the fact row would fail the foreign key)
+//
+// notes:
+//   - date keys are integers for efficient joins and partitioning
+//   - format: YYYYMMDD allows natural sorting and range queries
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int etl_t::get_date_key(const std::string& date_str)
+{
+  int year = 0;
+  int month = 0;
+  int day = 0;
+
+  if (sscanf(date_str.c_str(), "%d-%d-%d", &year, &month, &day) == 3)
+  {
+    int date_key = year * 10000 + month * 100 + day;
+    if (cache.is_loaded() && !cache.has_date_key(date_key))
+    {
+      return -1;
+    }
+    return date_key;
+  }
+  return -1;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// etl_t::load_cache
+// loads ticker to CompanyKey (current rows) and the DateKey set into the dimension key cache
+//
+// SQL:
+//   SELECT Ticker, CompanyKey FROM DimCompany WHERE IsCurrent=1
+//   SELECT DateKey FROM DimDate
+//
+// notes:
+//   - one scan per dimension at ETL start replaces one lookup query per fact row
+//   - load_date_dimension, load_companies_from_csv and update_company_scd2 keep the cache in sync
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int etl_t::load_cache()
+{
+  if (cache.load(odbc) < 0)
+  {
+    return -1;
+  }
+  LOG_INFO("etl", "Cached " << cache.nbr_companies() << " company keys, " << cache.nbr_dates() << " date keys");
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// etl_t::create_schema
+// creates all dimension and fact tables for the Kimball star schema
+//
+// dimension tables:
+//   DimDate    - calendar dimension with fiscal year support (federal Oct-Sep)
+//   DimCompany - company dimension with SCD Type 2 for historical tracking
+//   DimSector  - industry sector classification
+//
+// fact tables:
+//   FactDailyStock - daily stock prices with foreign keys to DimDate and DimCompany
+//   FactFinancials - quarterly financial statements with revenue, margins, ratios
+//   FactValuation  - valuation ratios (P/E, P/S, EV/EBITDA, etc.)
+//
+// load state tables (incremental loads):
+//   EtlLoadState   - fingerprint of each CSV file loaded without errors
+//   EtlWatermark   - highest DateKey loaded per fact table and ticker
+//
+// notes:
+//   - uses IF NOT EXISTS to allow idempotent schema creation
+//   - FactDailyStock and FactFinancials are created partitioned by month on DateKey (ps_DateKey);
+//     tables created by an earlier version are left as they are, switch_months and purge_month
+//     fall back to row operations on them
+//   - foreign keys enforce referential integrity between facts and dimensions
+//   - surrogate keys (IDENTITY) used for all dimension primary keys
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int etl_t::create_schema()
+{
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+  // DimDate
+  // calendar dimension table with fiscal year support
+  //
+  // SQL:
+  //   CREATE TABLE DimDate (
+  //     DateKey INT PRIMARY KEY,           -- integer key YYYYMMDD for efficient joins
+  //     FullDate DATE,                     -- actual date value
+  //     Year INT, Quarter INT, Month INT,  -- calendar attributes
+  //     MonthName VARCHAR(15),             -- 'January', 'February', etc.
+  //     Week INT, DayOfWeek VARCHAR(10),   -- week number and day name
+  //     IsWeekend BIT,                     -- 1 for Saturday/Sunday
+  //     FiscalYear INT, FiscalQuarter INT  -- federal fiscal year (Oct-Sep)
+  //   )
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+
+  std::string sql_dim_date =
+    "IF NOT EXISTS (SELECT * FROM sys.tables WHERE name='DimDate') "
+    "CREATE TABLE DimDate ("
+    "DateKey INT PRIMARY KEY, "
+    "FullDate DATE, Year INT, Quarter INT, Month INT, "
+    "MonthName VARCHAR(15), Week INT, DayOfWeek VARCHAR(10), "
+    "IsWeekend BIT, FiscalYear INT, FiscalQuarter INT)";
+
+  if (odbc.exec_direct(sql_dim_date) < 0)
+  {
+    return -1;
+  }
 
   /////////////////////////////////////////////////////////////////////////////////////////////////////
   // DimCompany (SCD Type 2)
   // company dimension with slowly changing dimension Type 2 support
   //
   // SQL:
-  //   CREATE TABLE DimCompany (
-  //     CompanyKey INT PRIMARY KEY IDENTITY(1,1),  -- surrogate key (auto-increment)
-  //     Ticker VARCHAR(10),                        -- natural key (stock symbol)
-  //     CompanyName VARCHAR(100),                  -- full company name
-  //     Sector VARCHAR(50), Industry VARCHAR(100), -- industry classification
-  //     CEO VARCHAR(100),                          -- current CEO (tracked via SCD2)
-  //     Founded INT, Headquarters VARCHAR(100),    -- company info
-  //     Employees INT, MarketCapTier VARCHAR(20),  -- size classification
-  //     EffectiveDate DATE,                        -- SCD2: when record became active
-  //     ExpiryDate DATE,                           -- SCD2: when record was superseded
-  //     IsCurrent BIT DEFAULT 1                    -- SCD2: 1 for current record
+  //   CREATE TABLE DimCompany (
+  //     CompanyKey INT PRIMARY KEY IDENTITY(1,1),  -- surrogate key (auto-increment)
+  //     Ticker VARCHAR(10),                        -- natural key (stock symbol)
+  //     CompanyName VARCHAR(100),                  -- full company name
+  //     Sector VARCHAR(50), Industry VARCHAR(100), -- industry classification
+  //     CEO VARCHAR(100),                          -- current CEO (tracked via SCD2)
+  //     Founded INT, Headquarters VARCHAR(100),    -- company info
+  //     Employees INT, MarketCapTier VARCHAR(20),  -- size classification
+  //     EffectiveDate DATE,                        -- SCD2: when record became active
+  //     ExpiryDate DATE,                           -- SCD2: when record was superseded
+  //     IsCurrent BIT DEFAULT 1                    -- SCD2: 1 for current record
+  //   )
+  //
+  // SCD Type 2 notes:
+  //   - historical changes create new records with updated EffectiveDate
+  //   - old records are expired by setting ExpiryDate and IsCurrent=0
+  //   - enables point-in-time reporting (who was CEO on date X?)
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+
+  std::string sql_dim_company =
+    "IF NOT EXISTS (SELECT * FROM sys.tables WHERE name='DimCompany') "
+    "CREATE TABLE DimCompany ("
+    "CompanyKey INT PRIMARY KEY IDENTITY(1,1), "
+    "Ticker VARCHAR(10), CompanyName VARCHAR(100), "
+    "Sector VARCHAR(50), Industry VARCHAR(100), "
+    "CEO VARCHAR(100), Founded INT, Headquarters VARCHAR(100), "
+    "Employees INT, MarketCapTier VARCHAR(20), "
+    "EffectiveDate DATE, ExpiryDate DATE, IsCurrent BIT DEFAULT 1)";
+
+  if (odbc.exec_direct(sql_dim_company) < 0)
+  {
+    return -1;
+  }
+
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+  // DimSector
+  // sector dimension for industry classification
+  //
+  // SQL:
+  //   CREATE TABLE DimSector (
+  //     SectorKey INT PRIMARY KEY IDENTITY(1,1),
+  //     SectorName VARCHAR(50),
+  //     SectorDescription VARCHAR(200)
+  //   )
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+
+  std::string sql_dim_sector =
+    "IF NOT EXISTS (SELECT * FROM sys.tables WHERE name='DimSector') "
+    "CREATE TABLE DimSector ("
+    "SectorKey INT PRIMARY KEY IDENTITY(1,1), "
+    "SectorName VARCHAR(50), SectorDescription VARCHAR(200))";
+
+  if (odbc.exec_direct(sql_dim_sector) < 0)
+  {
+    return -1;
+  }
+
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+  // pf_DateKey, ps_DateKey
+  // monthly partitions of the fact tables
+  //
+  // SQL:
+  //   CREATE PARTITION FUNCTION pf_DateKey (INT)
+  //   AS RANGE RIGHT FOR VALUES (20200101, 20200201, ..., 20261201, 20270101)
+  //   CREATE PARTITION SCHEME ps_DateKey AS PARTITION pf_DateKey ALL TO ([PRIMARY])
+  //
+  // partition of a month: $PARTITION.pf_DateKey(YYYYMM01); RANGE RIGHT puts each first day of month
+  // in the partition it starts; a function created for fewer years is extended by extend_partitions
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+
+  std::string boundaries;
+  for (int year = PARTITION::FIRST_YEAR; year <= PARTITION::LAST_YEAR + 1; year++)
+  {
+    for (int month = 1; month <= 12 && (year <= PARTITION::LAST_YEAR || month == 1); month++)
+    {
+      boundaries += (boundaries.empty() ? "" : ", ") + std::to_string(year * 10000 + month * 100 + 1);
+    }
+  }
+
+  std::string sql_partition_function =
+    "IF NOT EXISTS (SELECT * FROM sys.partition_functions WHERE name='pf_DateKey') "
+    "CREATE PARTITION FUNCTION pf_DateKey (INT) AS RANGE RIGHT FOR VALUES (" + boundaries + ")";
+
+  if (odbc.exec_direct(sql_partition_function) < 0)
+  {
+    return -1;
+  }
+
+  std::string sql_partition_scheme =
+    "IF NOT EXISTS (SELECT * FROM sys.partition_schemes WHERE name='ps_DateKey') "
+    "CREATE PARTITION SCHEME ps_DateKey AS PARTITION pf_DateKey ALL TO ([PRIMARY])";
+
+  if (odbc.exec_direct(sql_partition_scheme) < 0)
+  {
+    return -1;
+  }
+
+  if (extend_partitions() < 0)
+  {
+    return -1;
+  }
+
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+  // FactDailyStock
+  // daily stock price fact table
+  //
+  // SQL:
+  //   CREATE TABLE FactDailyStock (
+  //     StockFactKey BIGINT IDENTITY(1,1) NOT NULL,     -- surrogate fact key
+  //     DateKey INT NOT NULL,                           -- FK to DimDate, partitioning column
+  //     CompanyKey INT,                                 -- FK to DimCompany
+  //     OpenPrice DECIMAL(12,2),                        -- opening price
+  //     HighPrice DECIMAL(12,2),                        -- daily high
+  //     LowPrice DECIMAL(12,2),                         -- daily low
+  //     ClosePrice DECIMAL(12,2),                       -- closing price
+  //     Volume BIGINT,                                  -- trading volume
+  //     MarketCap DECIMAL(18,2),                        -- market capitalization
+  //     DailyReturn DECIMAL(8,6),                       -- daily return percentage
+  //     MovingAvg50 DECIMAL(12,2),                      -- 50-day moving average
+  //     MovingAvg200 DECIMAL(12,2),                     -- 200-day moving average
+  //     RSI DECIMAL(6,2),                               -- relative strength index
+  //     CONSTRAINT PK_FactDailyStock PRIMARY KEY (DateKey, StockFactKey),
+  //     FOREIGN KEY (DateKey) REFERENCES DimDate(DateKey),
+  //     FOREIGN KEY (CompanyKey) REFERENCES DimCompany(CompanyKey)
+  //   ) ON ps_DateKey(DateKey)
+  //
+  // grain: one row per company per trading day
+  // the clustered key starts with the partitioning column, as partition switching requires
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+
+  std::string sql_fact_stock =
+    "IF NOT EXISTS (SELECT * FROM sys.tables WHERE name='FactDailyStock') "
+    "CREATE TABLE FactDailyStock ("
+    "StockFactKey BIGINT IDENTITY(1,1) NOT NULL, "
+    "DateKey INT NOT NULL, CompanyKey INT, "
+    "OpenPrice DECIMAL(12,2), HighPrice DECIMAL(12,2), "
+    "LowPrice DECIMAL(12,2), ClosePrice DECIMAL(12,2), "
+    "Volume BIGINT, MarketCap DECIMAL(18,2), "
+    "DailyReturn DECIMAL(8,6), MovingAvg50 DECIMAL(12,2), "
+    "MovingAvg200 DECIMAL(12,2), RSI DECIMAL(6,2), "
+    "CONSTRAINT PK_FactDailyStock PRIMARY KEY (DateKey, StockFactKey), "
+    "FOREIGN KEY (DateKey) REFERENCES DimDate(DateKey), "
+    "FOREIGN KEY (CompanyKey) REFERENCES DimCompany(CompanyKey)) "
+    "ON ps_DateKey(DateKey)";
+
+  if (odbc.exec_direct(sql_fact_stock) < 0)
+  {
+    return -1;
+  }
+
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+  // FactFinancials
+  // quarterly financial statement fact table
+  //
+  // SQL:
+  //   CREATE TABLE FactFinancials (
+  //     FinancialKey BIGINT IDENTITY(1,1) NOT NULL,
+  //     DateKey INT NOT NULL, CompanyKey INT,           -- dimension foreign keys
+  //     Revenue DECIMAL(18,2),                          -- total revenue
+  //     GrossProfit DECIMAL(18,2),                      -- gross profit
+  //     OperatingIncome DECIMAL(18,2),                  -- operating income
+  //     NetIncome DECIMAL(18,2),                        -- net income
+  //     EPS DECIMAL(10,4),                              -- earnings per share
+  //     EBITDA DECIMAL(18,2),                           -- EBITDA
+  //     TotalAssets DECIMAL(18,2),                      -- total assets
+  //     TotalLiabilities DECIMAL(18,2),                 -- total liabilities
+  //     CashAndEquivalents DECIMAL(18,2),               -- cash and equivalents
+  //     TotalDebt DECIMAL(18,2),                        -- total debt
+  //     FreeCashFlow DECIMAL(18,2),                     -- free cash flow
+  //     RnDExpense DECIMAL(18,2),                       -- R&D expense
+  //     GrossMargin DECIMAL(8,4),                       -- gross margin ratio
+  //     OperatingMargin DECIMAL(8,4),                   -- operating margin ratio
+  //     NetMargin DECIMAL(8,4),                         -- net margin ratio
+  //     ROE DECIMAL(8,4),                               -- return on equity
+  //     ROA DECIMAL(8,4),                               -- return on assets
+  //     CONSTRAINT PK_FactFinancials PRIMARY KEY (DateKey, FinancialKey),
+  //     FOREIGN KEY (DateKey) REFERENCES DimDate(DateKey),
+  //     FOREIGN KEY (CompanyKey) REFERENCES DimCompany(CompanyKey)
+  //   ) ON ps_DateKey(DateKey)
+  //
+  // grain: one row per company per fiscal quarter
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+
+  std::string sql_fact_fin =
+    "IF NOT EXISTS (SELECT * FROM sys.tables WHERE name='FactFinancials') "
+    "CREATE TABLE FactFinancials ("
+    "FinancialKey BIGINT IDENTITY(1,1) NOT NULL, "
+    "DateKey INT NOT NULL, CompanyKey INT, "
+    "Revenue DECIMAL(18,2), GrossProfit DECIMAL(18,2), "
+    "OperatingIncome DECIMAL(18,2), NetIncome DECIMAL(18,2), "
+    "EPS DECIMAL(10,4), EBITDA DECIMAL(18,2), "
+    "TotalAssets DECIMAL(18,2), TotalLiabilities DECIMAL(18,2), "
+    "CashAndEquivalents DECIMAL(18,2), TotalDebt DECIMAL(18,2), "
+    "FreeCashFlow DECIMAL(18,2), RnDExpense DECIMAL(18,2), "
+    "GrossMargin DECIMAL(8,4), OperatingMargin DECIMAL(8,4), "
+    "NetMargin DECIMAL(8,4), ROE DECIMAL(8,4), ROA DECIMAL(8,4), "
+    "CONSTRAINT PK_FactFinancials PRIMARY KEY (DateKey, FinancialKey), "
+    "FOREIGN KEY (DateKey) REFERENCES DimDate(DateKey), "
+    "FOREIGN KEY (CompanyKey) REFERENCES DimCompany(CompanyKey)) "
+    "ON ps_DateKey(DateKey)";
+
+  if (odbc.exec_direct(sql_fact_fin) < 0)
+  {
+    return -1;
+  }
+
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+  // FactValuation
+  // valuation ratios fact table
+  //
+  // SQL:
+  //   CREATE TABLE FactValuation (
+  //     ValuationKey BIGINT PRIMARY KEY IDENTITY(1,1),
+  //     DateKey INT, CompanyKey INT,
+  //     PERatio DECIMAL(10,2),                          -- price-to-earnings
+  //     ForwardPE DECIMAL(10,2),                        -- forward P/E
+  //     PEGRatio DECIMAL(10,4),                         -- PEG ratio
+  //     PriceToSales DECIMAL(10,2),                     -- price-to-sales
+  //     PriceToBook DECIMAL(10,2),                      -- price-to-book
+  //     EVToEBITDA DECIMAL(10,2),                       -- EV/EBITDA
+  //     EVToRevenue DECIMAL(10,2),                      -- EV/Revenue
+  //     DividendYield DECIMAL(8,4),                     -- dividend yield
+  //     Beta DECIMAL(6,4),                              -- stock beta
+  //     ShortRatio DECIMAL(8,2),                        -- short interest ratio
+  //     FOREIGN KEY (DateKey) REFERENCES DimDate(DateKey),
+  //     FOREIGN KEY (CompanyKey) REFERENCES DimCompany(CompanyKey)
+  //   )
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+
+  std::string sql_fact_val =
+    "IF NOT EXISTS (SELECT * FROM sys.tables WHERE name='FactValuation') "
+    "CREATE TABLE FactValuation ("
+    "ValuationKey BIGINT PRIMARY KEY IDENTITY(1,1), "
+    "DateKey INT, CompanyKey INT, "
+    "PERatio DECIMAL(10,2), ForwardPE DECIMAL(10,2), "
+    "PEGRatio DECIMAL(10,4), PriceToSales DECIMAL(10,2), "
+    "PriceToBook DECIMAL(10,2), EVToEBITDA DECIMAL(10,2), "
+    "EVToRevenue DECIMAL(10,2), DividendYield DECIMAL(8,4), "
+    "Beta DECIMAL(6,4), ShortRatio DECIMAL(8,2), "
+    "FOREIGN KEY (DateKey) REFERENCES DimDate(DateKey), "
+    "FOREIGN KEY (CompanyKey) REFERENCES DimCompany(CompanyKey))";
+
+  if (odbc.exec_direct(sql_fact_val) < 0)
+  {
+    return -1;
+  }
+
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+  // FactSectorDaily
+  // aggregate of FactDailyStock by sector and trading day, maintained by refresh_sector_daily
+  //
+  // SQL:
+  //   CREATE TABLE FactSectorDaily (
+  //     DateKey INT NOT NULL,
+  //     Sector VARCHAR(50) NOT NULL,
+  //     Companies INT,                                  -- distinct tickers with a row that day
+  //     TotalMarketCap DECIMAL(20,2),
+  //     TotalVolume BIGINT,
+  //     AvgReturn DECIMAL(10,6),                        -- average DailyReturn of the companies
+  //     PRIMARY KEY (DateKey, Sector),
+  //     FOREIGN KEY (DateKey) REFERENCES DimDate(DateKey)
   //   )
   //
-  // SCD Type 2 notes:
-  //   - historical changes create new records with updated EffectiveDate
-  //   - old records are expired by setting ExpiryDate and IsCurrent=0
-  //   - enables point-in-time reporting (who was CEO on date X?)
+  //   CREATE INDEX IX_FactDailyStock_DateKey ON FactDailyStock (DateKey)
+  //     INCLUDE (CompanyKey, Volume, MarketCap, DailyReturn)
+  //
+  // grain: one row per sector per trading day; the index lets a refresh read only the rows of the
+  // dates it recomputes, it is created only on an unpartitioned FactDailyStock (the partitioned table
+  // is clustered on DateKey already)
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+
+  std::string sql_fact_sector =
+    "IF NOT EXISTS (SELECT * FROM sys.tables WHERE name='FactSectorDaily') "
+    "CREATE TABLE FactSectorDaily ("
+    "DateKey INT NOT NULL, Sector VARCHAR(50) NOT NULL, "
+    "Companies INT, TotalMarketCap DECIMAL(20,2), TotalVolume BIGINT, AvgReturn DECIMAL(10,6), "
+    "PRIMARY KEY (DateKey, Sector), "
+    "FOREIGN KEY (DateKey) REFERENCES DimDate(DateKey))";
+
+  if (odbc.exec_direct(sql_fact_sector) < 0)
+  {
+    return -1;
+  }
+
+  std::string sql_stock_date_index =
+    "IF NOT EXISTS (SELECT * FROM sys.indexes WHERE name='IX_FactDailyStock_DateKey') "
+    "AND NOT EXISTS (SELECT * FROM sys.indexes i JOIN sys.partition_schemes ps ON ps.data_space_id=i.data_space_id "
+    "WHERE i.object_id=OBJECT_ID('FactDailyStock') AND i.index_id<=1) "
+    "CREATE INDEX IX_FactDailyStock_DateKey ON FactDailyStock (DateKey) "
+    "INCLUDE (CompanyKey, Volume, MarketCap, DailyReturn)";
+
+  if (odbc.exec_direct(sql_stock_date_index) < 0)
+  {
+    return -1;
+  }
+
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+  // EtlLoadState
+  // fingerprint of each CSV file as of its last load without errors
+  //
+  // SQL:
+  //   CREATE TABLE EtlLoadState (
+  //     SourceName VARCHAR(260) PRIMARY KEY,            -- canonical path of the CSV file
+  //     Fingerprint VARCHAR(64) NOT NULL,               -- size, modification time, hash of head and tail
+  //     LoadedAt DATETIME NOT NULL
+  //   )
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+
+  std::string sql_load_state =
+    "IF NOT EXISTS (SELECT * FROM sys.tables WHERE name='EtlLoadState') "
+    "CREATE TABLE EtlLoadState ("
+    "SourceName VARCHAR(260) PRIMARY KEY, "
+    "Fingerprint VARCHAR(64) NOT NULL, "
+    "LoadedAt DATETIME NOT NULL)";
+
+  if (odbc.exec_direct(sql_load_state) < 0)
+  {
+    return -1;
+  }
+
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+  // EtlWatermark
+  // highest DateKey loaded per fact table and ticker
+  //
+  // SQL:
+  //   CREATE TABLE EtlWatermark (
+  //     TableName VARCHAR(50) NOT NULL,                 -- FactDailyStock, FactFinancials
+  //     Ticker VARCHAR(10) NOT NULL,
+  //     MaxDateKey INT NOT NULL,
+  //     PRIMARY KEY (TableName, Ticker)
+  //   )
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+
+  std::string sql_watermark =
+    "IF NOT EXISTS (SELECT * FROM sys.tables WHERE name='EtlWatermark') "
+    "CREATE TABLE EtlWatermark ("
+    "TableName VARCHAR(50) NOT NULL, "
+    "Ticker VARCHAR(10) NOT NULL, "
+    "MaxDateKey INT NOT NULL, "
+    "PRIMARY KEY (TableName, Ticker))";
+
+  if (odbc.exec_direct(sql_watermark) < 0)
+  {
+    return -1;
+  }
+
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// etl_t::load_date_dimension
+// populates DimDate with calendar data for specified year range
+//
+// SQL (array-bound batches of ODBC::PARAMSET_SIZE rows, only dates not in the key cache):
+//   INSERT INTO DimDate (DateKey, FullDate, Year, Quarter, Month, MonthName,
+//                        Week, DayOfWeek, IsWeekend, FiscalYear, FiscalQuarter)
+//   SELECT ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?
+//   WHERE NOT EXISTS (SELECT 1 FROM DimDate WHERE DateKey=?)
+//
+// fiscal year calculation:
+//   - federal fiscal year runs October through September
+//   - FY2026 = Oct 2025 - Sep 2026
+//   - months >= 10 (Oct-Dec) belong to next fiscal year
+//
+// notes:
+//   - date attributes come from make_calendar_day (calendar.hh), no mktime call per day
+//   - with the key cache loaded, a run where every date exists sends no statement at all
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int etl_t::load_date_dimension(int start_year, int end_year)
+{
+  std::string sql =
+    "INSERT INTO DimDate (DateKey, FullDate, Year, Quarter, Month, MonthName, Week, DayOfWeek, IsWeekend, FiscalYear, FiscalQuarter) "
+    "SELECT ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ? "
+    "WHERE NOT EXISTS (SELECT 1 FROM DimDate WHERE DateKey=?)";
+
+  std::vector<std::vector<param_t>> rows;
+  std::vector<std::string> labels;
+  std::vector<int> keys;
+  int count = 0;
+  int errors = 0;
+
+  for (int y = start_year; y <= end_year; y++)
+  {
+    for (int m = 1; m <= 12; m++)
+    {
+      for (int d = 1; d <= days_in_month(y, m); d++)
+      {
+        calendar_day_t day = make_calendar_day(y, m, d);
+        if (cache.has_date_key(day.date_key))
+        {
+          continue;
+        }
+
+        char full_date[16];
+        snprintf(full_date, sizeof(full_date), "%04d-%02d-%02d", y, m, d);
+
+        rows.push_back({ day.date_key, std::string(full_date), day.year, day.quarter, day.month,
+          CALENDAR::MONTH_NAME[m], day.week, CALENDAR::DAY_NAME[day.day_of_week], day.is_weekend,
+          day.fiscal_year, day.fiscal_quarter, day.date_key });
+        labels.push_back(full_date);
+        keys.push_back(day.date_key);
+
+        if (rows.size() == ODBC::PARAMSET_SIZE)
+        {
+          count += flush_batch(sql, rows, labels, errors);
+        }
+      }
+    }
+  }
+  count += flush_batch(sql, rows, labels, errors);
+
+  //a rejected row is not in DimDate; reload the keys so the cache does not claim it
+  if (errors > 0)
+  {
+    if (cache.is_loaded())
+    {
+      cache.load(odbc);
+    }
+    return -1;
+  }
+  for (size_t idx = 0; idx < keys.size(); idx++)
+  {
+    cache.add_date_key(keys[idx]);
+  }
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// company_row_t
+// one company of companies.csv: the DimCompany attributes tracked by SCD Type 2 as statement
+// parameters, and their hash
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct company_row_t
+{
+  std::string ticker;
+  std::vector<param_t> params; //Ticker, CompanyName, Sector, Industry, CEO, Founded, Headquarters, Employees, MarketCapTier
+  unsigned long long hash;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// attribute_hash
+// FNV-1a 64-bit hash of the tracked attributes of a company, each value followed by a separator so
+// ('AB', 'C') and ('A', 'BC') differ; numbers are hashed as text, an unknown Founded as ''
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static unsigned long long attribute_hash(const std::vector<std::string>& values)
+{
+  unsigned long long hash = 14695981039346656037ULL;
+  for (size_t idx = 0; idx < values.size(); idx++)
+  {
+    for (size_t pos = 0; pos < values[idx].size(); pos++)
+    {
+      hash ^= static_cast<unsigned char>(values[idx][pos]);
+      hash *= 1099511628211ULL;
+    }
+    hash ^= 0x1f;
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// etl_t::load_companies_from_csv
+// loads company data from CSV into DimCompany dimension table, as a batch SCD Type 2 update
+//
+// current rows SQL (one query, block cursor):
+//   SELECT Ticker, CompanyName, Sector, Industry, CEO, Founded, Headquarters, Employees, MarketCapTier
+//   FROM DimCompany WHERE IsCurrent=1
+//
+// staging SQL (array-bound batches of ODBC::PARAMSET_SIZE rows, new and changed companies only):
+//   CREATE TABLE #StageCompany (Ticker VARCHAR(10), CompanyName VARCHAR(100), ...)
+//   INSERT INTO #StageCompany (Ticker, CompanyName, Sector, Industry, CEO,
+//                              Founded, Headquarters, Employees, MarketCapTier)
+//   VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?)
+//
+//   e.g. 'AAPL', 'Apple Inc.', 'Technology', 'Consumer Electronics',
+//        'Tim Cook', 1976, 'Cupertino, CA', 164000, 'Mega Cap'
+//
+// apply SQL (one batch, one transaction):
+//   SET NOCOUNT ON; SET XACT_ABORT ON;
+//   DECLARE @keys TABLE (CompanyKey INT, Ticker VARCHAR(10));
+//   BEGIN TRANSACTION;
+//   UPDATE d SET ExpiryDate=CAST(GETDATE() AS DATE), IsCurrent=0
+//   FROM DimCompany d JOIN #StageCompany s ON s.Ticker=d.Ticker WHERE d.IsCurrent=1;
+//   INSERT INTO DimCompany (Ticker, CompanyName, ..., EffectiveDate, IsCurrent)
+//   OUTPUT INSERTED.CompanyKey, INSERTED.Ticker INTO @keys
+//   SELECT Ticker, CompanyName, ..., GETDATE(), 1 FROM #StageCompany;
+//   COMMIT TRANSACTION;
+//   SELECT CompanyKey, Ticker FROM @keys
+//
+// notes:
+//   - the tracked attributes of each CSV row and of each current DimCompany row are hashed
+//     (attribute_hash) and compared in memory; unchanged companies send nothing
+//   - a new ticker gets its first row, a changed one has its current row expired and a new version
+//     inserted, all in the same transaction, so no reader sees a ticker with zero or two current rows
+//   - a ticker repeated in the CSV is applied once, with its last row
+//   - an unknown Employees is stored as 0 and an unknown Founded as NULL, both sides are hashed that way
+//   - the generated CompanyKeys replace the cached keys of their tickers
+//   - if any row is rejected by the staging insert nothing is applied and -1 is returned
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int etl_t::load_companies_from_csv(const std::string& filename)
+{
+  std::string fingerprint;
+  int unchanged = source_unchanged(filename, fingerprint);
+  if (unchanged != 0)
+  {
+    return unchanged < 0 ? -1 : 0;
+  }
+
+  read_csv_t reader;
+
+  if (reader.open(filename) < 0)
+  {
+    return -1;
+  }
+
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+  // skip header row
   /////////////////////////////////////////////////////////////////////////////////////////////////////
 
-  std::string sql_dim_company =
-    "IF NOT EXISTS (SELECT * FROM sys.tables WHERE name='DimCompany') "
-    "CREATE TABLE DimCompany ("
-    "CompanyKey INT PRIMARY KEY IDENTITY(1,1), "
-    "Ticker VARCHAR(10), CompanyName VARCHAR(100), "
-    "Sector VARCHAR(50), Industry VARCHAR(100), "
-    "CEO VARCHAR(100), Founded INT, Headquarters VARCHAR(100), "
-    "Employees INT, MarketCapTier VARCHAR(20), "
-    "EffectiveDate DATE, ExpiryDate DATE, IsCurrent BIT DEFAULT 1)";
+  std::vector<std::string> row = reader.read_row_by_comma();
+  if (row.empty())
+  {
+    reader.close();
+    return -1;
+  }
+
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+  // read every company and hash its tracked attributes
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+
+  std::vector<company_row_t> companies;
+  std::unordered_map<std::string, size_t> index;
+
+  while (true)
+  {
+    row = reader.read_row_by_comma();
+    if (row.empty())
+    {
+      break;
+    }
+
+    if (row.size() < 9)
+    {
+      continue;
+    }
+
+    const std::string& ticker = row[0];
+    const std::string& company_name = row[1];
+    const std::string& sector = row[2];
+    const std::string& industry = row[3];
+    const std::string& ceo = row[4];
+    const std::string& founded = row[5];
+    const std::string& headquarters = row[6];
+    const std::string& employees = row[7];
+    const std::string& market_cap_tier = row[8];
+
+    std::string founded_value;
+    param_t founded_param;
+    if (!founded.empty() && founded != "Unknown")
+    {
+      founded_param = param_t(atoi(founded.c_str()));
+      founded_value = std::to_string(atoi(founded.c_str()));
+    }
+
+    std::string employees_value = "0";
+    param_t employees_param(0);
+    if (!employees.empty() && employees != "Unknown")
+    {
+      employees_param = param_t(atoi(employees.c_str()));
+      employees_value = std::to_string(atoi(employees.c_str()));
+    }
+
+    company_row_t company;
+    company.ticker = ticker;
+    company.params = { ticker, company_name, sector, industry, ceo, founded_param,
+      headquarters, employees_param, market_cap_tier };
+    company.hash = attribute_hash({ company_name, sector, industry, ceo, founded_value,
+      headquarters, employees_value, market_cap_tier });
+
+    std::unordered_map<std::string, size_t>::const_iterator it = index.find(ticker);
+    if (it == index.end())
+    {
+      index[ticker] = companies.size();
+      companies.push_back(std::move(company));
+    }
+    else
+    {
+      companies[it->second] = std::move(company);
+    }
+  }
+
+  reader.close();
+
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+  // hashes of the current DimCompany rows
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+
+  std::string sql_current =
+    "SELECT Ticker, CompanyName, Sector, Industry, CEO, Founded, Headquarters, Employees, MarketCapTier "
+    "FROM DimCompany WHERE IsCurrent=1";
+
+  size_t row_array_size = odbc.get_row_array_size();
+  odbc.set_row_array_size(ODBC::ROW_ARRAY_SIZE);
+  typed_table_t current;
+  int rc = odbc.fetch(sql_current, current);
+  odbc.set_row_array_size(row_array_size);
+  if (rc < 0)
+  {
+    return -1;
+  }
+
+  std::unordered_map<std::string, unsigned long long> current_hashes;
+  const typed_column_t& current_ticker = current.col("Ticker");
+  const typed_column_t& current_name = current.col("CompanyName");
+  const typed_column_t& current_sector = current.col("Sector");
+  const typed_column_t& current_industry = current.col("Industry");
+  const typed_column_t& current_ceo = current.col("CEO");
+  const typed_column_t& current_founded = current.col("Founded");
+  const typed_column_t& current_headquarters = current.col("Headquarters");
+  const typed_column_t& current_employees = current.col("Employees");
+  const typed_column_t& current_tier = current.col("MarketCapTier");
+  for (size_t idx = 0; idx < current.nbr_rows; idx++)
+  {
+    //a NULL text value reads as '', the value an empty CSV field is stored as
+    std::string founded_value = current_founded.is_null(idx) ? std::string() : std::to_string(current_founded.get_int(idx));
+    std::string employees_value = current_employees.is_null(idx) ? std::string("0") : std::to_string(current_employees.get_int(idx));
+    current_hashes[std::string(current_ticker.get_string(idx))] = attribute_hash({
+      std::string(current_name.get_string(idx)), std::string(current_sector.get_string(idx)),
+      std::string(current_industry.get_string(idx)), std::string(current_ceo.get_string(idx)), founded_value,
+      std::string(current_headquarters.get_string(idx)), employees_value, std::string(current_tier.get_string(idx)) });
+  }
+
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+  // new and changed companies
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+
+  std::vector<std::vector<param_t>> rows;
+  std::vector<std::string> labels;
+  int nbr_new = 0;
+  int nbr_changed = 0;
+  for (size_t idx = 0; idx < companies.size(); idx++)
+  {
+    company_row_t& company = companies[idx];
+    std::unordered_map<std::string, unsigned long long>::const_iterator it = current_hashes.find(company.ticker);
+    if (it == current_hashes.end())
+    {
+      nbr_new++;
+    }
+    else if (it->second != company.hash)
+    {
+      nbr_changed++;
+    }
+    else
+    {
+      continue;
+    }
+    rows.push_back(std::move(company.params));
+    labels.push_back(company.ticker);
+  }
+
+  int count = 0;
+  int errors = 0;
+  if (!rows.empty())
+  {
+    if (odbc.exec_direct(
+      "IF OBJECT_ID('tempdb..#StageCompany') IS NOT NULL DROP TABLE #StageCompany; "
+      "CREATE TABLE #StageCompany (Ticker VARCHAR(10), CompanyName VARCHAR(100), Sector VARCHAR(50), "
+      "Industry VARCHAR(100), CEO VARCHAR(100), Founded INT, Headquarters VARCHAR(100), Employees INT, "
+      "MarketCapTier VARCHAR(20))") < 0)
+    {
+      return -1;
+    }
+
+    std::string sql_stage =
+      "INSERT INTO #StageCompany (Ticker, CompanyName, Sector, Industry, CEO, Founded, Headquarters, Employees, MarketCapTier) "
+      "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?)";
+
+    std::vector<std::vector<param_t>> batch;
+    std::vector<std::string> batch_labels;
+    for (size_t idx = 0; idx < rows.size(); idx++)
+    {
+      batch.push_back(std::move(rows[idx]));
+      batch_labels.push_back(labels[idx]);
+      if (batch.size() == ODBC::PARAMSET_SIZE || idx + 1 == rows.size())
+      {
+        flush_batch(sql_stage, batch, batch_labels, errors);
+      }
+    }
+
+    //a company missing from the staging table would keep its old version, or get no key at all,
+    //while the file is recorded as loaded; nothing is applied and the next run stages the file again
+    if (errors > 0)
+    {
+      odbc.exec_direct("DROP TABLE #StageCompany");
+      LOG_ERROR("etl", "Companies not applied, " << errors << " rows rejected by #StageCompany");
+      return -1;
+    }
+
+    std::string sql_apply =
+      "SET NOCOUNT ON; SET XACT_ABORT ON; "
+      "DECLARE @keys TABLE (CompanyKey INT, Ticker VARCHAR(10)); "
+      "BEGIN TRANSACTION; "
+      "UPDATE d SET ExpiryDate=CAST(GETDATE() AS DATE), IsCurrent=0 "
+      "FROM DimCompany d JOIN #StageCompany s ON s.Ticker=d.Ticker WHERE d.IsCurrent=1; "
+      "INSERT INTO DimCompany (Ticker, CompanyName, Sector, Industry, CEO, Founded, Headquarters, Employees, MarketCapTier, EffectiveDate, IsCurrent) "
+      "OUTPUT INSERTED.CompanyKey, INSERTED.Ticker INTO @keys "
+      "SELECT Ticker, CompanyName, Sector, Industry, CEO, Founded, Headquarters, Employees, MarketCapTier, GETDATE(), 1 "
+      "FROM #StageCompany; "
+      "COMMIT TRANSACTION; "
+      "SELECT CompanyKey, Ticker FROM @keys";
+
+    typed_table_t inserted;
+    rc = odbc.fetch(sql_apply, inserted);
+    odbc.exec_direct("DROP TABLE #StageCompany");
+    if (rc < 0)
+    {
+      return -1;
+    }
+
+    const typed_column_t& company_key = inserted.col("CompanyKey");
+    const typed_column_t& ticker = inserted.col("Ticker");
+    for (size_t idx = 0; idx < inserted.nbr_rows; idx++)
+    {
+      cache.set_company_key(std::string(ticker.get_string(idx)), static_cast<int>(company_key.get_int(idx)));
+    }
+    count = static_cast<int>(inserted.nbr_rows);
+  }
+
+  int nbr_unchanged = static_cast<int>(companies.size()) - nbr_new - nbr_changed;
+  LOG_INFO("etl", "Loaded " << count << " companies (" << nbr_new << " new, " << nbr_changed << " changed, "
+    << nbr_unchanged << " unchanged)");
+  save_source(filename, fingerprint);
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// etl_t::load_stock_data_from_csv
+// loads daily stock price data from CSV into FactDailyStock fact table
+//
+// insert SQL (duplicate check in the same statement):
+//   INSERT INTO FactDailyStock (DateKey, CompanyKey, OpenPrice, HighPrice,
+//                               LowPrice, ClosePrice, Volume, MarketCap, DailyReturn,
+//                               MovingAvg50, MovingAvg200, RSI)
+//   SELECT ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?
+//   WHERE NOT EXISTS (SELECT 1 FROM FactDailyStock WHERE DateKey=? AND CompanyKey=?)
+//
+//   e.g. 20251230, 1, 254.12, 257.89, 253.45, 256.78, 45678900, 3890000000000, 0.0082
+//
+// notes:
+//   - uses get_company_key() to resolve ticker to surrogate key
+//   - uses get_date_key() to convert date string to integer key
+//   - skips duplicates (same DateKey + CompanyKey); the row counts of the batch tell inserted rows from
+//     skipped ones, which are logged as 'already loaded'
+//   - rows are sent in batches of ODBC::PARAMSET_SIZE with odbc_t::execute_batch
+//   - reading, transform and load run on separate threads (run_pipeline) in every mode
+//   - MovingAvg50, MovingAvg200 and RSI are computed in the transform stage (indicators.hh), per
+//     ticker in date order; the CSV is expected grouped by ticker (as written by fetch); on an
+//     incremental run the last INDICATORS::TAIL_ROWS closes per ticker are read first
+//     (load_indicator_history), so only the new rows are computed and no existing row is updated
+//   - the DateKeys of the rows sent are added to 'loaded_dates' for refresh_sector_daily
+//
+// bulk mode:
+//   TRUNCATE TABLE FactDailyStock, then rows are streamed with bcp_t (bulk copy, TABLOCK),
+//   committed every BCP::BATCH_SIZE rows; the connection must be opened with bulk copy enabled
+//
+// partition switch mode (bulk mode with --switch):
+//   rows are copied to FactDailyStock_Load instead, then switch_months replaces each month of the
+//   file in FactDailyStock; months not in the file are kept
+//   the indicators start from the closes dated before the first month of the file (first_csv_month,
+//   load_indicator_history), and the watermarks are read back from the table (rebuild_watermarks)
+//
+// staging mode:
+//   CSV rows are sent unchanged (ticker and date, no key lookups) in batches to #StageDailyStock,
+//   then one MERGE resolves both surrogate keys on the server and inserts the rows not yet loaded:
+//
+//   MERGE FactDailyStock WITH (HOLDLOCK) AS t
+//   USING (SELECT d.DateKey, c.CompanyKey, s.OpenPrice, ...
+//          FROM #StageDailyStock s
+//          JOIN DimCompany c ON c.Ticker=s.Ticker AND c.IsCurrent=1
+//          JOIN DimDate d ON d.FullDate=s.TradeDate) AS src
+//   ON t.DateKey=src.DateKey AND t.CompanyKey=src.CompanyKey
+//   WHEN NOT MATCHED BY TARGET THEN INSERT (...) VALUES (...)
+//
+//   the MERGE is one atomic statement; HOLDLOCK keeps a concurrent loader from inserting the same
+//   keys between the match and the insert; a ticker/date repeated in the CSV is inserted once
+//   with --jobs the hint is left out: the workers insert disjoint tickers, so they cannot insert the
+//   same keys, and the serializable key ranges of HOLDLOCK on the DateKey-leading clustered index
+//   would span every ticker, serializing the workers or deadlocking them (error 1205)
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int etl_t::load_stock_data_from_csv(const std::string& filename, bool bulk, bool staging)
+{
+  //an unchanged file is skipped; with --jobs, load_facts_parallel checks the file once for all workers
+  std::string fingerprint;
+  nbr_errors = 0;
+  if (nbr_partitions == 1)
+  {
+    int unchanged = source_unchanged(filename, fingerprint);
+    if (unchanged != 0)
+    {
+      return unchanged < 0 ? -1 : 0;
+    }
+  }
+
+  //with --jobs the rows come from the input queue, load_facts_parallel reads the file once
+  map_csv_t reader;
+  if (input == nullptr && open_csv(reader, filename) < 0)
+  {
+    return -1;
+  }
+
+  int count = 0;
+  int errors = 0;
+
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+  // the transform stage reads keys from the cache only; the connection belongs to the load stage
+  // rows at or below the watermark of their ticker were loaded by a previous run and are skipped;
+  // bulk mode replaces the table and loads every row
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+
+  if (!cache.is_loaded() && load_cache() < 0)
+  {
+    reader.close();
+    return -1;
+  }
+
+  std::unordered_map<std::string, int> marks;
+  std::unordered_map<std::string, int> new_marks;
+  std::unordered_set<std::string> dirty;
+  int mark = -1;
+  int nbr_unresolved = 0;
+  int nbr_skipped = 0;
+  int nbr_duplicates = 0; //rows already in the fact table, skipped by the insert or the MERGE
+  int nbr_staged = 0;
+  std::vector<int> months; //replaced by --switch, YYYYMM
+  if (incremental && !bulk && load_watermarks("FactDailyStock", marks) < 0)
+  {
+    reader.close();
+    return -1;
+  }
+
+  //--switch keeps the months before the first one of the file, their closes are the history
+  int first_month = 0;
+  if (bulk && partition_switch)
+  {
+    first_month = first_csv_month(filename);
+    if (first_month < 0)
+    {
+      reader.close();
+      return -1;
+    }
+  }
+
+  //indicators of new rows continue from the last closes of their ticker already in the table
+  indicator_engine_t indicators;
+  if ((!marks.empty() || first_month > 0) && load_indicator_history(marks, indicators, first_month * 100) < 0)
+  {
+    reader.close();
+    return -1;
+  }
+
+  std::string sql =
+    "INSERT INTO FactDailyStock (DateKey, CompanyKey, OpenPrice, HighPrice, LowPrice, ClosePrice, Volume, MarketCap, DailyReturn, "
+    "MovingAvg50, MovingAvg200, RSI) "
+    "SELECT ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ? "
+    "WHERE NOT EXISTS (SELECT 1 FROM FactDailyStock WHERE DateKey=? AND CompanyKey=?)";
+
+  std::vector<std::vector<param_t>> rows;
+  std::vector<std::string> labels;
+  std::string last_ticker;
+  int company_key = -1;
+
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+  // staging mode: session temporary table with the CSV columns, RowNbr keeps the file order
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+
+  std::string sql_stage =
+    "INSERT INTO #StageDailyStock (Ticker, TradeDate, OpenPrice, HighPrice, LowPrice, ClosePrice, Volume, MarketCap, DailyReturn, "
+    "MovingAvg50, MovingAvg200, RSI) "
+    "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)";
+
+  //no HOLDLOCK between --jobs workers, see the notes of load_stock_data_from_csv
+  std::string merge_hint = nbr_partitions == 1 ? " WITH (HOLDLOCK)" : "";
+  std::string sql_merge =
+    "SET NOCOUNT ON; "
+    "DECLARE @unresolved INT = (SELECT COUNT(*) FROM #StageDailyStock s "
+    "WHERE NOT EXISTS (SELECT 1 FROM DimCompany c WHERE c.Ticker=s.Ticker AND c.IsCurrent=1) "
+    "OR NOT EXISTS (SELECT 1 FROM DimDate d WHERE d.FullDate=s.TradeDate)); "
+    "MERGE FactDailyStock" + merge_hint + " AS t "
+    "USING (SELECT * FROM ("
+    "SELECT d.DateKey, c.CompanyKey, s.OpenPrice, s.HighPrice, s.LowPrice, s.ClosePrice, s.Volume, s.MarketCap, s.DailyReturn, "
+    "s.MovingAvg50, s.MovingAvg200, s.RSI, "
+    "ROW_NUMBER() OVER (PARTITION BY d.DateKey, c.CompanyKey ORDER BY s.RowNbr) AS RowRank "
+    "FROM #StageDailyStock s "
+    "JOIN DimCompany c ON c.Ticker=s.Ticker AND c.IsCurrent=1 "
+    "JOIN DimDate d ON d.FullDate=s.TradeDate) r WHERE r.RowRank=1) AS src "
+    "ON t.DateKey=src.DateKey AND t.CompanyKey=src.CompanyKey "
+    "WHEN NOT MATCHED BY TARGET THEN "
+    "INSERT (DateKey, CompanyKey, OpenPrice, HighPrice, LowPrice, ClosePrice, Volume, MarketCap, DailyReturn, "
+    "MovingAvg50, MovingAvg200, RSI) "
+    "VALUES (src.DateKey, src.CompanyKey, src.OpenPrice, src.HighPrice, src.LowPrice, src.ClosePrice, src.Volume, src.MarketCap, src.DailyReturn, "
+    "src.MovingAvg50, src.MovingAvg200, src.RSI); "
+    "DECLARE @inserted INT = @@ROWCOUNT; "
+    "SELECT @inserted AS NbrInserted, @unresolved AS NbrUnresolved";
+
+  if (staging)
+  {
+    if (odbc.exec_direct(
+      "IF OBJECT_ID('tempdb..#StageDailyStock') IS NOT NULL DROP TABLE #StageDailyStock; "
+      "CREATE TABLE #StageDailyStock (RowNbr INT IDENTITY(1,1), Ticker VARCHAR(10), TradeDate DATE, "
+      "OpenPrice DECIMAL(12,2), HighPrice DECIMAL(12,2), LowPrice DECIMAL(12,2), ClosePrice DECIMAL(12,2), "
+      "Volume BIGINT, MarketCap DECIMAL(18,2), DailyReturn DECIMAL(8,6), "
+      "MovingAvg50 DECIMAL(12,2), MovingAvg200 DECIMAL(12,2), RSI DECIMAL(6,2))") < 0)
+    {
+      reader.close();
+      return -1;
+    }
+  }
+
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+  // bulk mode: the columns of the row insert, bound by name (bcp_t::init); StockFactKey is an
+  // identity column generated by the server, columns of schema.sql not loaded here stay NULL
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+
+  bcp_t bcp(odbc);
+  if (bulk)
+  {
+    if (partition_switch)
+    {
+      if (create_load_table("FactDailyStock") < 0)
+      {
+        reader.close();
+        return -1;
+      }
+    }
+    else if (nbr_partitions == 1 && (odbc.exec_direct("TRUNCATE TABLE FactDailyStock") < 0 ||
+      odbc.exec_direct("TRUNCATE TABLE FactSectorDaily") < 0 ||
+      odbc.exec_direct("DELETE FROM EtlWatermark WHERE TableName='FactDailyStock'") < 0))
+    {
+      reader.close();
+      return -1;
+    }
+
+    std::vector<std::string> columns = { "DateKey", "CompanyKey", "OpenPrice", "HighPrice", "LowPrice", "ClosePrice",
+      "Volume", "MarketCap", "DailyReturn", "MovingAvg50", "MovingAvg200", "RSI" };
+    std::vector<SQLSMALLINT> ctypes = { SQL_C_LONG, SQL_C_LONG,
+      SQL_C_DOUBLE, SQL_C_DOUBLE, SQL_C_DOUBLE, SQL_C_DOUBLE, SQL_C_SBIGINT, SQL_C_DOUBLE, SQL_C_DOUBLE,
+      SQL_C_DOUBLE, SQL_C_DOUBLE, SQL_C_DOUBLE };
+    if (bcp.init(partition_switch ? "FactDailyStock_Load" : "FactDailyStock", columns, ctypes, BCP::BATCH_SIZE,
+      nbr_partitions == 1) < 0)
+    {
+      reader.close();
+      return -1;
+    }
+  }
+
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+  // transform stage: CSV fields to the parameters of the load mode
+  // the rows of a ticker are held back until the ticker changes, then sorted by date and given
+  // MovingAvg50, MovingAvg200 and RSI from the indicator engine; parameters without indicators have
+  // ClosePrice at 'close_pos' and get the three indicators inserted at 'indicator_pos'
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+
+  std::vector<fact_row_t> group;
+  std::vector<int> group_dates;
+  std::string group_ticker;
+  size_t close_pos = 5;
+  size_t indicator_pos = 9;
+
+  auto flush_group = [&](std::vector<fact_row_t>& facts)
+    {
+      std::vector<size_t> order(group.size());
+      for (size_t idx = 0; idx < order.size(); idx++)
+      {
+        order[idx] = idx;
+      }
+      std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b)
+        {
+          return group_dates[a] < group_dates[b];
+        });
+
+      //rows with a close and a valid date form the price series, in date order
+      std::vector<double> closes;
+      std::vector<size_t> in_series;
+      for (size_t idx = 0; idx < order.size(); idx++)
+      {
+        const param_t& close = group[order[idx]].params[close_pos];
+        if (group_dates[order[idx]] >= 0 && close.ind != SQL_NULL_DATA)
+        {
+          closes.push_back(close.dbl);
+          in_series.push_back(order[idx]);
+        }
+      }
+      std::vector<indicator_t> result;
+      indicators.compute(group_ticker, closes, result);
+
+      std::vector<param_t> values(group.size() * 3);
+      for (size_t idx = 0; idx < in_series.size(); idx++)
+      {
+        const indicator_t& value = result[idx];
+        param_t* dst = &values[in_series[idx] * 3];
+        dst[0] = std::isnan(value.ma_short) ? param_t() : param_t(value.ma_short);
+        dst[1] = std::isnan(value.ma_long) ? param_t() : param_t(value.ma_long);
+        dst[2] = std::isnan(value.rsi) ? param_t() : param_t(value.rsi);
+      }
+
+      for (size_t idx = 0; idx < order.size(); idx++)
+      {
+        fact_row_t& fact = group[order[idx]];
+        fact.params.insert(fact.params.begin() + indicator_pos,
+          values.begin() + order[idx] * 3, values.begin() + order[idx] * 3 + 3);
+        facts.push_back(std::move(fact));
+      }
+      group.clear();
+      group_dates.clear();
+    };
+
+  auto transform = [&](const csv_row_t& row, std::vector<fact_row_t>& facts) -> int
+    {
+      if (row.size() < 9)
+      {
+        return 0;
+      }
+
+      //ticker and date are short enough for the string small buffer, no allocation
+      std::string ticker(row[0]);
+      std::string date_str(row[1]);
+      std::string_view open_price = row[2];
+      std::string_view high_price = row[3];
+      std::string_view low_price = row[4];
+      std::string_view close_price = row[5];
+      std::string_view volume = row[6];
+      std::string_view market_cap = row[7];
+      std::string_view daily_return = row[8];
+
+      if (!in_partition(ticker))
+      {
+        return 0;
+      }
+
+      //CSV rows are grouped by ticker, look up the key and watermark only when the ticker changes
+      if (ticker != last_ticker)
+      {
+        flush_group(facts);
+        group_ticker = ticker;
+        company_key = get_company_key(ticker);
+        std::unordered_map<std::string, int>::const_iterator it = marks.find(ticker);
+        mark = it == marks.end() ? -1 : it->second;
+        last_ticker = ticker;
+      }
+
+      int date_key = get_date_key(date_str);
+      if (date_key >= 0 && date_key <= mark)
+      {
+        nbr_skipped++;
+        return 0;
+      }
+
+      //an unresolved row keeps the watermark of its ticker from moving past it
+      if (company_key < 0 || date_key < 0)
+      {
+        dirty.insert(ticker);
+        nbr_unresolved++;
+      }
+      else if (date_key > new_marks[ticker])
+      {
+        new_marks[ticker] = date_key;
+      }
+
+      //staging rows are sent as they are, the MERGE counts the unresolved ones
+      if (!staging && (company_key < 0 || date_key < 0))
+      {
+        return -1;
+      }
+
+      //sector/day aggregates recomputed after the load
+      if (company_key >= 0 && date_key >= 0)
+      {
+        loaded_dates.insert(date_key);
+      }
+
+      group.push_back(fact_row_t());
+      group_dates.push_back(date_key);
+      fact_row_t& fact = group.back();
+      fact.label = ticker + " " + date_str;
+      if (staging)
+      {
+        fact.params = { ticker, date_str, number_param(open_price), number_param(high_price),
+          number_param(low_price), number_param(close_price), number_param(volume), number_param(market_cap),
+          number_param(daily_return) };
+      }
+      else if (bulk)
+      {
+        fact.params = { date_key, company_key, number_param(open_price), number_param(high_price),
+          number_param(low_price), number_param(close_price), number_param(volume), number_param(market_cap),
+          number_param(daily_return) };
+      }
+      else
+      {
+        fact.params = { date_key, company_key, number_param(open_price), number_param(high_price),
+          number_param(low_price), number_param(close_price), number_param(volume), number_param(market_cap),
+          number_param(daily_return), date_key, company_key };
+      }
+      return 0;
+    };
+
+  auto finish = [&](std::vector<fact_row_t>& facts)
+    {
+      flush_group(facts);
+    };
+
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+  // load stage: add row to batch, send when full
+  // SQL: INSERT INTO FactDailyStock (...) SELECT ... WHERE NOT EXISTS (...)
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+
+  auto load = [&](fact_row_t& fact) -> int
+    {
+      if (bulk)
+      {
+        if (bcp.send_row(fact.params) < 0)
+        {
+          LOG_WARN("etl", "Rejected " << fact.label);
+          return -1;
+        }
+        return 0;
+      }
+
+      rows.push_back(std::move(fact.params));
+      labels.push_back(std::move(fact.label));
+      if (rows.size() == ODBC::PARAMSET_SIZE)
+      {
+        int nbr_rows = flush_batch(staging ? sql_stage : sql, rows, labels, errors, &nbr_duplicates);
+        if (staging)
+        {
+          nbr_staged += nbr_rows;
+        }
+        else
+        {
+          count += nbr_rows;
+        }
+      }
+      return 0;
+    };
 
-  if (odbc.exec_direct(sql_dim_company) < 0)
+  if (run_pipeline(reader, transform, finish, load, errors) < 0)
   {
+    if (bulk)
+    {
+      bcp.done();
+    }
+    reader.close();
     return -1;
   }
 
-  /////////////////////////////////////////////////////////////////////////////////////////////////////
-  // DimSector
-  // sector dimension for industry classification
-  //
-  // SQL:
-  //   CREATE TABLE DimSector (
-  //     SectorKey INT PRIMARY KEY IDENTITY(1,1),
-  //     SectorName VARCHAR(50),
-  //     SectorDescription VARCHAR(200)
-  //   )
-  /////////////////////////////////////////////////////////////////////////////////////////////////////
+  if (bulk)
+  {
+    long long nbr_rows = bcp.done();
+    if (nbr_rows < 0)
+    {
+      reader.close();
+      return -1;
+    }
+    count = static_cast<int>(nbr_rows);
 
-  std::string sql_dim_sector =
-    "IF NOT EXISTS (SELECT * FROM sys.tables WHERE name='DimSector') "
-    "CREATE TABLE DimSector ("
-    "SectorKey INT PRIMARY KEY IDENTITY(1,1), "
-    "SectorName VARCHAR(50), SectorDescription VARCHAR(200))";
+    //the sector aggregates of a replaced month are recomputed from the dates of the file
+    if (partition_switch && switch_months("FactDailyStock", "StockFactKey", "DateKey, CompanyKey, OpenPrice, "
+      "HighPrice, LowPrice, ClosePrice, Volume, MarketCap, DailyReturn, MovingAvg50, MovingAvg200, RSI", months) < 0)
+    {
+      reader.close();
+      return -1;
+    }
+    for (size_t idx = 0; idx < months.size(); idx++)
+    {
+      if (odbc.exec_direct("DELETE FROM FactSectorDaily WHERE DateKey >= " + std::to_string(months[idx] * 100) +
+        " AND DateKey < " + std::to_string(months[idx] * 100 + 100)) < 0)
+      {
+        reader.close();
+        return -1;
+      }
+    }
+  }
+  else if (staging)
+  {
+    nbr_staged += flush_batch(sql_stage, rows, labels, errors);
+    int nbr_errors_staged = errors;
+    count = merge_staged("#StageDailyStock", sql_merge, errors);
+    if (count < 0)
+    {
+      reader.close();
+      return -1;
+    }
+    nbr_duplicates = std::max(0, nbr_staged - count - (errors - nbr_errors_staged));
+  }
+  else
+  {
+    count += flush_batch(sql, rows, labels, errors, &nbr_duplicates);
+  }
 
-  if (odbc.exec_direct(sql_dim_sector) < 0)
+  reader.close();
+  LOG_INFO("etl", "Loaded " << count << " stock records (" << nbr_duplicates << " already loaded, " <<
+    errors << " errors, " << nbr_skipped << " below watermark)");
+  nbr_errors = errors;
+
+  //watermarks move only if every rejected row was found by the transform stage, whose ticker is
+  //'dirty'; a row rejected by the server could belong to any ticker
+  //--switch reads them back from the replaced months, the watermarks of the kept months stay
+  if (!months.empty())
   {
-    return -1;
+    if (rebuild_watermarks("FactDailyStock", *std::min_element(months.begin(), months.end()), dirty) < 0)
+    {
+      return -1;
+    }
+  }
+  else if (errors == nbr_unresolved)
+  {
+    for (std::unordered_set<std::string>::const_iterator it = dirty.begin(); it != dirty.end(); ++it)
+    {
+      new_marks.erase(*it);
+    }
+    if (save_watermarks("FactDailyStock", new_marks) < 0)
+    {
+      return -1;
+    }
   }
 
-  /////////////////////////////////////////////////////////////////////////////////////////////////////
-  // FactDailyStock
-  // daily stock price fact table
-  //
-  // SQL:
-  //   CREATE TABLE FactDailyStock (
-  //     StockFactKey BIGINT PRIMARY KEY IDENTITY(1,1),  -- surrogate fact key
-  //     DateKey INT,                                    -- FK to DimDate
-  //     CompanyKey INT,                                 -- FK to DimCompany
-  //     OpenPrice DECIMAL(12,2),                        -- opening price
-  //     HighPrice DECIMAL(12,2),                        -- daily high
-  //     LowPrice DECIMAL(12,2),                         -- daily low
-  //     ClosePrice DECIMAL(12,2),                       -- closing price
-  //     Volume BIGINT,                                  -- trading volume
-  //     MarketCap DECIMAL(18,2),                        -- market capitalization
-  //     DailyReturn DECIMAL(8,6),                       -- daily return percentage
-  //     MovingAvg50 DECIMAL(12,2),                      -- 50-day moving average
-  //     MovingAvg200 DECIMAL(12,2),                     -- 200-day moving average
-  //     RSI DECIMAL(6,2),                               -- relative strength index
-  //     FOREIGN KEY (DateKey) REFERENCES DimDate(DateKey),
-  //     FOREIGN KEY (CompanyKey) REFERENCES DimCompany(CompanyKey)
-  //   )
-  //
-  // grain: one row per company per trading day
-  /////////////////////////////////////////////////////////////////////////////////////////////////////
+  if (nbr_partitions == 1 && errors == 0)
+  {
+    save_source(filename, fingerprint);
+  }
+  return 0;
+}
 
-  std::string sql_fact_stock =
-    "IF NOT EXISTS (SELECT * FROM sys.tables WHERE name='FactDailyStock') "
-    "CREATE TABLE FactDailyStock ("
-    "StockFactKey BIGINT PRIMARY KEY IDENTITY(1,1), "
-    "DateKey INT, CompanyKey INT, "
-    "OpenPrice DECIMAL(12,2), HighPrice DECIMAL(12,2), "
-    "LowPrice DECIMAL(12,2), ClosePrice DECIMAL(12,2), "
-    "Volume BIGINT, MarketCap DECIMAL(18,2), "
-    "DailyReturn DECIMAL(8,6), MovingAvg50 DECIMAL(12,2), "
-    "MovingAvg200 DECIMAL(12,2), RSI DECIMAL(6,2), "
-    "FOREIGN KEY (DateKey) REFERENCES DimDate(DateKey), "
-    "FOREIGN KEY (CompanyKey) REFERENCES DimCompany(CompanyKey))";
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// etl_t::load_financials_from_csv
+// loads quarterly financial statement data from CSV into FactFinancials fact table
+//
+// insert SQL (duplicate check in the same statement):
+//   INSERT INTO FactFinancials (DateKey, CompanyKey, Revenue, GrossProfit,
+//                               OperatingIncome, NetIncome, EPS, EBITDA,
+//                               TotalAssets, TotalLiabilities, CashAndEquivalents,
+//                               TotalDebt, FreeCashFlow, RnDExpense,
+//                               GrossMargin, OperatingMargin, NetMargin, ROE, ROA)
+//   SELECT ?, ?, ?, ...
+//   WHERE NOT EXISTS (SELECT 1 FROM FactFinancials WHERE DateKey=? AND CompanyKey=?)
+//
+//   e.g. 20250930, 1, 94930000000, 43900000000, ...
+//
+// notes:
+//   - DateKey corresponds to fiscal quarter end date
+//   - financial ratios (margins, ROE, ROA) are pre-calculated in CSV
+//   - duplicates are skipped and logged as 'already loaded', as in load_stock_data_from_csv
+//   - rows are sent in batches of ODBC::PARAMSET_SIZE with odbc_t::execute_batch
+//   - reading, transform and load run on separate threads (run_pipeline) in every mode
+//
+// bulk mode:
+//   TRUNCATE TABLE FactFinancials, then rows are streamed with bcp_t (bulk copy, TABLOCK); with
+//   --switch they go to FactFinancials_Load and replace their months with switch_months, then the
+//   watermarks are read back from the table (rebuild_watermarks)
+//
+// staging mode:
+//   rows are sent to #StageFinancials and merged into FactFinancials with one MERGE, the quarter end
+//   date resolved to DateKey through DimDate.FullDate (see load_stock_data_from_csv)
+/////////////////////////////////////////////////////////////////////////////////////////////////////
 
-  if (odbc.exec_direct(sql_fact_stock) < 0)
+int etl_t::load_financials_from_csv(const std::string& filename, bool bulk, bool staging)
+{
+  //an unchanged file is skipped; with --jobs, load_facts_parallel checks the file once for all workers
+  std::string fingerprint;
+  nbr_errors = 0;
+  if (nbr_partitions == 1)
+  {
+    int unchanged = source_unchanged(filename, fingerprint);
+    if (unchanged != 0)
+    {
+      return unchanged < 0 ? -1 : 0;
+    }
+  }
+
+  //with --jobs the rows come from the input queue, load_facts_parallel reads the file once
+  map_csv_t reader;
+  if (input == nullptr && open_csv(reader, filename) < 0)
   {
     return -1;
   }
 
+  int count = 0;
+  int errors = 0;
+
   /////////////////////////////////////////////////////////////////////////////////////////////////////
-  // FactFinancials
-  // quarterly financial statement fact table
-  //
-  // SQL:
-  //   CREATE TABLE FactFinancials (
-  //     FinancialKey BIGINT PRIMARY KEY IDENTITY(1,1),
-  //     DateKey INT, CompanyKey INT,                    -- dimension foreign keys
-  //     Revenue DECIMAL(18,2),                          -- total revenue
-  //     GrossProfit DECIMAL(18,2),                      -- gross profit
-  //     OperatingIncome DECIMAL(18,2),                  -- operating income
-  //     NetIncome DECIMAL(18,2),                        -- net income
-  //     EPS DECIMAL(10,4),                              -- earnings per share
-  //     EBITDA DECIMAL(18,2),                           -- EBITDA
-  //     TotalAssets DECIMAL(18,2),                      -- total assets
-  //     TotalLiabilities DECIMAL(18,2),                 -- total liabilities
-  //     CashAndEquivalents DECIMAL(18,2),               -- cash and equivalents
-  //     TotalDebt DECIMAL(18,2),                        -- total debt
-  //     FreeCashFlow DECIMAL(18,2),                     -- free cash flow
-  //     RnDExpense DECIMAL(18,2),                       -- R&D expense
-  //     GrossMargin DECIMAL(8,4),                       -- gross margin ratio
-  //     OperatingMargin DECIMAL(8,4),                   -- operating margin ratio
-  //     NetMargin DECIMAL(8,4),                         -- net margin ratio
-  //     ROE DECIMAL(8,4),                               -- return on equity
-  //     ROA DECIMAL(8,4),                               -- return on assets
-  //     FOREIGN KEY (DateKey) REFERENCES DimDate(DateKey),
-  //     FOREIGN KEY (CompanyKey) REFERENCES DimCompany(CompanyKey)
-  //   )
-  //
-  // grain: one row per company per fiscal quarter
+  // the transform stage reads keys from the cache only; the connection belongs to the load stage
+  // rows at or below the watermark of their ticker were loaded by a previous run and are skipped;
+  // bulk mode replaces the table and loads every row
   /////////////////////////////////////////////////////////////////////////////////////////////////////
 
-  std::string sql_fact_fin =
-    "IF NOT EXISTS (SELECT * FROM sys.tables WHERE name='FactFinancials') "
-    "CREATE TABLE FactFinancials ("
-    "FinancialKey BIGINT PRIMARY KEY IDENTITY(1,1), "
-    "DateKey INT, CompanyKey INT, "
-    "Revenue DECIMAL(18,2), GrossProfit DECIMAL(18,2), "
-    "OperatingIncome DECIMAL(18,2), NetIncome DECIMAL(18,2), "
-    "EPS DECIMAL(10,4), EBITDA DECIMAL(18,2), "
-    "TotalAssets DECIMAL(18,2), TotalLiabilities DECIMAL(18,2), "
-    "CashAndEquivalents DECIMAL(18,2), TotalDebt DECIMAL(18,2), "
-    "FreeCashFlow DECIMAL(18,2), RnDExpense DECIMAL(18,2), "
-    "GrossMargin DECIMAL(8,4), OperatingMargin DECIMAL(8,4), "
-    "NetMargin DECIMAL(8,4), ROE DECIMAL(8,4), ROA DECIMAL(8,4), "
-    "FOREIGN KEY (DateKey) REFERENCES DimDate(DateKey), "
-    "FOREIGN KEY (CompanyKey) REFERENCES DimCompany(CompanyKey))";
+  if (!cache.is_loaded() && load_cache() < 0)
+  {
+    reader.close();
+    return -1;
+  }
 
-  if (odbc.exec_direct(sql_fact_fin) < 0)
+  std::unordered_map<std::string, int> marks;
+  std::unordered_map<std::string, int> new_marks;
+  std::unordered_set<std::string> dirty;
+  int mark = -1;
+  int nbr_unresolved = 0;
+  int nbr_skipped = 0;
+  int nbr_duplicates = 0; //rows already in the fact table, skipped by the insert or the MERGE
+  int nbr_staged = 0;
+  std::vector<int> months; //replaced by --switch, YYYYMM
+  if (incremental && !bulk && load_watermarks("FactFinancials", marks) < 0)
   {
+    reader.close();
     return -1;
   }
 
+  std::string sql =
+    "INSERT INTO FactFinancials (DateKey, CompanyKey, Revenue, GrossProfit, OperatingIncome, NetIncome, "
+    "EPS, EBITDA, TotalAssets, TotalLiabilities, CashAndEquivalents, TotalDebt, FreeCashFlow, RnDExpense, "
+    "GrossMargin, OperatingMargin, NetMargin, ROE, ROA) "
+    "SELECT ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ? "
+    "WHERE NOT EXISTS (SELECT 1 FROM FactFinancials WHERE DateKey=? AND CompanyKey=?)";
+
+  std::vector<std::vector<param_t>> rows;
+  std::vector<std::string> labels;
+  std::string last_ticker;
+  int company_key = -1;
+
   /////////////////////////////////////////////////////////////////////////////////////////////////////
-  // FactValuation
-  // valuation ratios fact table
-  //
-  // SQL:
-  //   CREATE TABLE FactValuation (
-  //     ValuationKey BIGINT PRIMARY KEY IDENTITY(1,1),
-  //     DateKey INT, CompanyKey INT,
-  //     PERatio DECIMAL(10,2),                          -- price-to-earnings
-  //     ForwardPE DECIMAL(10,2),                        -- forward P/E
-  //     PEGRatio DECIMAL(10,4),                         -- PEG ratio
-  //     PriceToSales DECIMAL(10,2),                     -- price-to-sales
-  //     PriceToBook DECIMAL(10,2),                      -- price-to-book
-  //     EVToEBITDA DECIMAL(10,2),                       -- EV/EBITDA
-  //     EVToRevenue DECIMAL(10,2),                      -- EV/Revenue
-  //     DividendYield DECIMAL(8,4),                     -- dividend yield
-  //     Beta DECIMAL(6,4),                              -- stock beta
-  //     ShortRatio DECIMAL(8,2),                        -- short interest ratio
-  //     FOREIGN KEY (DateKey) REFERENCES DimDate(DateKey),
-  //     FOREIGN KEY (CompanyKey) REFERENCES DimCompany(CompanyKey)
-  //   )
+  // staging mode: session temporary table with the CSV columns
   /////////////////////////////////////////////////////////////////////////////////////////////////////
 
-  std::string sql_fact_val =
-    "IF NOT EXISTS (SELECT * FROM sys.tables WHERE name='FactValuation') "
-    "CREATE TABLE FactValuation ("
-    "ValuationKey BIGINT PRIMARY KEY IDENTITY(1,1), "
-    "DateKey INT, CompanyKey INT, "
-    "PERatio DECIMAL(10,2), ForwardPE DECIMAL(10,2), "
-    "PEGRatio DECIMAL(10,4), PriceToSales DECIMAL(10,2), "
-    "PriceToBook DECIMAL(10,2), EVToEBITDA DECIMAL(10,2), "
-    "EVToRevenue DECIMAL(10,2), DividendYield DECIMAL(8,4), "
-    "Beta DECIMAL(6,4), ShortRatio DECIMAL(8,2), "
-    "FOREIGN KEY (DateKey) REFERENCES DimDate(DateKey), "
-    "FOREIGN KEY (CompanyKey) REFERENCES DimCompany(CompanyKey))";
+  std::string measures =
+    "Revenue, GrossProfit, OperatingIncome, NetIncome, EPS, EBITDA, TotalAssets, TotalLiabilities, "
+    "CashAndEquivalents, TotalDebt, FreeCashFlow, RnDExpense, GrossMargin, OperatingMargin, NetMargin, ROE, ROA";
+
+  std::string sql_stage =
+    "INSERT INTO #StageFinancials (Ticker, QuarterEnd, " + measures + ") "
+    "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)";
+
+  //no HOLDLOCK between --jobs workers, see the notes of load_stock_data_from_csv
+  std::string merge_hint = nbr_partitions == 1 ? " WITH (HOLDLOCK)" : "";
+  std::string sql_merge =
+    "SET NOCOUNT ON; "
+    "DECLARE @unresolved INT = (SELECT COUNT(*) FROM #StageFinancials s "
+    "WHERE NOT EXISTS (SELECT 1 FROM DimCompany c WHERE c.Ticker=s.Ticker AND c.IsCurrent=1) "
+    "OR NOT EXISTS (SELECT 1 FROM DimDate d WHERE d.FullDate=s.QuarterEnd)); "
+    "MERGE FactFinancials" + merge_hint + " AS t "
+    "USING (SELECT * FROM ("
+    "SELECT d.DateKey, c.CompanyKey, s.Revenue, s.GrossProfit, s.OperatingIncome, s.NetIncome, s.EPS, s.EBITDA, "
+    "s.TotalAssets, s.TotalLiabilities, s.CashAndEquivalents, s.TotalDebt, s.FreeCashFlow, s.RnDExpense, "
+    "s.GrossMargin, s.OperatingMargin, s.NetMargin, s.ROE, s.ROA, "
+    "ROW_NUMBER() OVER (PARTITION BY d.DateKey, c.CompanyKey ORDER BY s.RowNbr) AS RowRank "
+    "FROM #StageFinancials s "
+    "JOIN DimCompany c ON c.Ticker=s.Ticker AND c.IsCurrent=1 "
+    "JOIN DimDate d ON d.FullDate=s.QuarterEnd) r WHERE r.RowRank=1) AS src "
+    "ON t.DateKey=src.DateKey AND t.CompanyKey=src.CompanyKey "
+    "WHEN NOT MATCHED BY TARGET THEN "
+    "INSERT (DateKey, CompanyKey, " + measures + ") "
+    "VALUES (src.DateKey, src.CompanyKey, src.Revenue, src.GrossProfit, src.OperatingIncome, src.NetIncome, "
+    "src.EPS, src.EBITDA, src.TotalAssets, src.TotalLiabilities, src.CashAndEquivalents, src.TotalDebt, "
+    "src.FreeCashFlow, src.RnDExpense, src.GrossMargin, src.OperatingMargin, src.NetMargin, src.ROE, src.ROA); "
+    "DECLARE @inserted INT = @@ROWCOUNT; "
+    "SELECT @inserted AS NbrInserted, @unresolved AS NbrUnresolved";
+
+  if (staging)
+  {
+    if (odbc.exec_direct(
+      "IF OBJECT_ID('tempdb..#StageFinancials') IS NOT NULL DROP TABLE #StageFinancials; "
+      "CREATE TABLE #StageFinancials (RowNbr INT IDENTITY(1,1), Ticker VARCHAR(10), QuarterEnd DATE, "
+      "Revenue DECIMAL(18,2), GrossProfit DECIMAL(18,2), OperatingIncome DECIMAL(18,2), NetIncome DECIMAL(18,2), "
+      "EPS DECIMAL(10,4), EBITDA DECIMAL(18,2), TotalAssets DECIMAL(18,2), TotalLiabilities DECIMAL(18,2), "
+      "CashAndEquivalents DECIMAL(18,2), TotalDebt DECIMAL(18,2), FreeCashFlow DECIMAL(18,2), RnDExpense DECIMAL(18,2), "
+      "GrossMargin DECIMAL(8,4), OperatingMargin DECIMAL(8,4), NetMargin DECIMAL(8,4), ROE DECIMAL(8,4), ROA DECIMAL(8,4))") < 0)
+    {
+      reader.close();
+      return -1;
+    }
+  }
 
-  if (odbc.exec_direct(sql_fact_val) < 0)
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+  // bulk mode: DateKey, CompanyKey and 17 measures, bound by name (bcp_t::init); FinancialKey is generated
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+
+  bcp_t bcp(odbc);
+  if (bulk)
   {
-    return -1;
+    if (partition_switch)
+    {
+      if (create_load_table("FactFinancials") < 0)
+      {
+        reader.close();
+        return -1;
+      }
+    }
+    else if (nbr_partitions == 1 && (odbc.exec_direct("TRUNCATE TABLE FactFinancials") < 0 ||
+      odbc.exec_direct("DELETE FROM EtlWatermark WHERE TableName='FactFinancials'") < 0))
+    {
+      reader.close();
+      return -1;
+    }
+
+    std::vector<std::string> columns = { "DateKey", "CompanyKey", "Revenue", "GrossProfit", "OperatingIncome",
+      "NetIncome", "EPS", "EBITDA", "TotalAssets", "TotalLiabilities", "CashAndEquivalents", "TotalDebt",
+      "FreeCashFlow", "RnDExpense", "GrossMargin", "OperatingMargin", "NetMargin", "ROE", "ROA" };
+    std::vector<SQLSMALLINT> ctypes = { SQL_C_LONG, SQL_C_LONG };
+    ctypes.resize(2 + 17, SQL_C_DOUBLE);
+    if (bcp.init(partition_switch ? "FactFinancials_Load" : "FactFinancials", columns, ctypes, BCP::BATCH_SIZE,
+      nbr_partitions == 1) < 0)
+    {
+      reader.close();
+      return -1;
+    }
   }
 
-  return 0;
-}
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+  // transform stage: CSV fields to the parameters of the load mode (see load_stock_data_from_csv)
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
 
-/////////////////////////////////////////////////////////////////////////////////////////////////////
-// etl_t::load_date_dimension
-// populates DimDate with calendar data for specified year range
-//
-// SQL (for each date):
-//   IF NOT EXISTS (SELECT 1 FROM DimDate WHERE DateKey=20251230)
-//   INSERT INTO DimDate (DateKey, FullDate, Year, Quarter, Month, MonthName,
-//                        Week, DayOfWeek, IsWeekend, FiscalYear, FiscalQuarter)
-//   VALUES (20251230, '2025-12-30', 2025, 4, 12, 'December', 52, 'Tuesday', 0, 2026, 1)
-//
-// fiscal year calculation:
-//   - federal fiscal year runs October through September
-//   - FY2026 = Oct 2025 - Sep 2026
-//   - months >= 10 (Oct-Dec) belong to next fiscal year
-/////////////////////////////////////////////////////////////////////////////////////////////////////
+  auto transform = [&](const csv_row_t& row, std::vector<fact_row_t>& facts) -> int
+    {
+      if (row.size() < 19)
+      {
+        return 0;
+      }
+
+      std::string ticker(row[0]);
+      std::string quarter_end(row[1]);
+
+      if (!in_partition(ticker))
+      {
+        return 0;
+      }
+
+      //CSV rows are grouped by ticker, look up the key and watermark only when the ticker changes
+      if (ticker != last_ticker)
+      {
+        company_key = get_company_key(ticker);
+        std::unordered_map<std::string, int>::const_iterator it = marks.find(ticker);
+        mark = it == marks.end() ? -1 : it->second;
+        last_ticker = ticker;
+      }
+
+      int date_key = get_date_key(quarter_end);
+      if (date_key >= 0 && date_key <= mark)
+      {
+        nbr_skipped++;
+        return 0;
+      }
+
+      //an unresolved row keeps the watermark of its ticker from moving past it
+      if (company_key < 0 || date_key < 0)
+      {
+        dirty.insert(ticker);
+        nbr_unresolved++;
+      }
+      else if (date_key > new_marks[ticker])
+      {
+        new_marks[ticker] = date_key;
+      }
+
+      //staging rows are sent as they are, the MERGE counts the unresolved ones
+      if (!staging && (company_key < 0 || date_key < 0))
+      {
+        return -1;
+      }
+
+      //17 measures: Revenue ... ROA, in CSV and table order
+      std::vector<param_t> values;
+      values.reserve(17);
+      for (size_t idx = 2; idx < 19; idx++)
+      {
+        values.push_back(number_param(row[idx]));
+      }
+
+      facts.push_back(fact_row_t());
+      fact_row_t& fact = facts.back();
+      fact.label = ticker + " " + quarter_end;
+      if (staging)
+      {
+        fact.params = { ticker, quarter_end };
+        fact.params.insert(fact.params.end(), values.begin(), values.end());
+        return 0;
+      }
 
-int etl_t::load_date_dimension(int start_year, int end_year)
-{
-  const char* months[] = { "", "January", "February", "March", "April", "May", "June",
-                           "July", "August", "September", "October", "November", "December" };
-  const char* days[] = { "Sunday", "Monday", "Tuesday", "Wednesday", "Thursday", "Friday", "Saturday" };
+      if (bulk)
+      {
+        fact.params = { date_key, company_key };
+        fact.params.insert(fact.params.end(), values.begin(), values.end());
+      }
+      else
+      {
+        fact.params = { date_key, company_key };
+        fact.params.insert(fact.params.end(), values.begin(), values.end());
+        fact.params.push_back(date_key);
+        fact.params.push_back(company_key);
+      }
+      return 0;
+    };
 
-  int count = 0;
-  for (int y = start_year; y <= end_year; y++)
-  {
-    for (int m = 1; m <= 12; m++)
+  std::function<void(std::vector<fact_row_t>&)> finish;
+
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+  // load stage: add row to batch, send when full
+  // SQL: INSERT INTO FactFinancials (...) SELECT ... WHERE NOT EXISTS (...)
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+
+  auto load = [&](fact_row_t& fact) -> int
     {
-      int days_in_month = (m == 2) ? ((y % 4 == 0 && (y % 100 != 0 || y % 400 == 0)) ? 29 : 28) :
-        ((m == 4 || m == 6 || m == 9 || m == 11) ? 30 : 31);
+      if (bulk)
+      {
+        if (bcp.send_row(fact.params) < 0)
+        {
+          LOG_WARN("etl", "Rejected " << fact.label);
+          return -1;
+        }
+        return 0;
+      }
 
-      for (int d = 1; d <= days_in_month; d++)
+      rows.push_back(std::move(fact.params));
+      labels.push_back(std::move(fact.label));
+      if (rows.size() == ODBC::PARAMSET_SIZE)
       {
-        int date_key = y * 10000 + m * 100 + d;
-
-        struct tm t;
-        memset(&t, 0, sizeof(t));
-        t.tm_mday = d;
-        t.tm_mon = m - 1;
-        t.tm_year = y - 1900;
-        mktime(&t);
-        int dow = t.tm_wday;
-        int week = (t.tm_yday / 7) + 1;
-        int quarter = (m - 1) / 3 + 1;
-        int fiscal_q = ((m + 5) / 3) % 4 + 1;
-        int fiscal_y = (m >= 10) ? y + 1 : y;
-        int is_weekend = (dow == 0 || dow == 6) ? 1 : 0;
-
-        std::stringstream sql;
-        sql << "IF NOT EXISTS (SELECT 1 FROM DimDate WHERE DateKey=" << date_key << ") "
-          << "INSERT INTO DimDate (DateKey, FullDate, Year, Quarter, Month, MonthName, Week, DayOfWeek, IsWeekend, FiscalYear, FiscalQuarter) "
-          << "VALUES (" << date_key << ", '"
-          << std::setfill('0') << std::setw(4) << y << "-"
-          << std::setw(2) << m << "-"
-          << std::setw(2) << d << "', "
-          << y << ", " << quarter << ", " << m << ", '" << months[m] << "', "
-          << week << ", '" << days[dow] << "', " << is_weekend << ", "
-          << fiscal_y << ", " << fiscal_q << ")";
-
-        if (odbc.exec_direct(sql.str()) < 0)
+        int nbr_rows = flush_batch(staging ? sql_stage : sql, rows, labels, errors, &nbr_duplicates);
+        if (staging)
         {
-          assert(0);
+          nbr_staged += nbr_rows;
         }
         else
         {
-          count++;
+          count += nbr_rows;
         }
       }
-    }
-  }
-
-  return 0;
-}
-
-/////////////////////////////////////////////////////////////////////////////////////////////////////
-// etl_t::load_companies_from_csv
-// loads company data from CSV into DimCompany dimension table
-//
-// duplicate check SQL:
-//   SELECT CompanyKey FROM DimCompany WHERE Ticker='AAPL' AND IsCurrent=1
-//
-// insert SQL:
-//   INSERT INTO DimCompany (Ticker, CompanyName, Sector, Industry, CEO,
-//                           Founded, Headquarters, Employees, MarketCapTier,
-//                           EffectiveDate, IsCurrent)
-//   VALUES ('AAPL', 'Apple Inc.', 'Technology', 'Consumer Electronics',
-//           'Tim Cook', 1976, 'Cupertino, CA', 164000, 'Mega Cap', GETDATE(), 1)
-//
-// notes:
-//   - skips existing companies (based on Ticker + IsCurrent=1)
-//   - sets EffectiveDate to current date for SCD Type 2 tracking
-//   - IsCurrent=1 indicates this is the active record
-/////////////////////////////////////////////////////////////////////////////////////////////////////
-
-int etl_t::load_companies_from_csv(const std::string& filename)
-{
-  read_csv_t reader;
-
-  if (reader.open(filename) < 0)
-  {
-    return -1;
-  }
-
-  /////////////////////////////////////////////////////////////////////////////////////////////////////
-  // skip header row
-  /////////////////////////////////////////////////////////////////////////////////////////////////////
+      return 0;
+    };
 
-  std::vector<std::string> row = reader.read_row_by_comma();
-  if (row.empty())
+  if (run_pipeline(reader, transform, finish, load, errors) < 0)
   {
+    if (bulk)
+    {
+      bcp.done();
+    }
     reader.close();
     return -1;
   }
 
-  int count = 0;
-  int errors = 0;
-
-  while (true)
+  if (bulk)
   {
-    row = reader.read_row_by_comma();
-    if (row.empty())
+    long long nbr_rows = bcp.done();
+    if (nbr_rows < 0)
     {
-      break;
+      reader.close();
+      return -1;
     }
+    count = static_cast<int>(nbr_rows);
 
-    if (row.size() < 9)
+    if (partition_switch && switch_months("FactFinancials", "FinancialKey", "DateKey, CompanyKey, " + measures,
+      months) < 0)
     {
-      continue;
+      reader.close();
+      return -1;
     }
-
-    std::string ticker = row[0];
-    std::string company_name = escape_sql(row[1]);
-    std::string sector = escape_sql(row[2]);
-    std::string industry = escape_sql(row[3]);
-    std::string ceo = escape_sql(row[4]);
-    std::string founded = row[5];
-    std::string headquarters = escape_sql(row[6]);
-    std::string employees = row[7];
-    std::string market_cap_tier = row[8];
-
-    /////////////////////////////////////////////////////////////////////////////////////////////////////
-    // check if company already exists
-    // SQL: SELECT CompanyKey FROM DimCompany WHERE Ticker='AAPL' AND IsCurrent=1
-    /////////////////////////////////////////////////////////////////////////////////////////////////////
-
-    std::stringstream check_sql;
-    check_sql << "SELECT CompanyKey FROM DimCompany WHERE Ticker='" << ticker << "' AND IsCurrent=1";
-
-    table_t table;
-    if (odbc.fetch(check_sql.str(), table) < 0)
+  }
+  else if (staging)
+  {
+    nbr_staged += flush_batch(sql_stage, rows, labels, errors);
+    int nbr_errors_staged = errors;
+    count = merge_staged("#StageFinancials", sql_merge, errors);
+    if (count < 0)
     {
-      assert(0);
+      reader.close();
+      return -1;
     }
+    nbr_duplicates = std::max(0, nbr_staged - count - (errors - nbr_errors_staged));
+  }
+  else
+  {
+    count += flush_batch(sql, rows, labels, errors, &nbr_duplicates);
+  }
 
-    if (table.rows.size() > 0)
+  reader.close();
+  LOG_INFO("etl", "Loaded " << count << " financial records (" << nbr_duplicates << " already loaded, " <<
+    errors << " errors, " << nbr_skipped << " below watermark)");
+  nbr_errors = errors;
+
+  //watermarks move only if every rejected row was found by the transform stage, whose ticker is
+  //'dirty'; a row rejected by the server could belong to any ticker
+  //--switch reads them back from the replaced months, the watermarks of the kept months stay
+  if (!months.empty())
+  {
+    if (rebuild_watermarks("FactFinancials", *std::min_element(months.begin(), months.end()), dirty) < 0)
     {
-      continue;
+      return -1;
     }
-
-    /////////////////////////////////////////////////////////////////////////////////////////////////////
-    // insert new company
-    // SQL: INSERT INTO DimCompany (...) VALUES (...)
-    /////////////////////////////////////////////////////////////////////////////////////////////////////
-
-    std::string founded_sql = "NULL";
-    if (!founded.empty() && founded != "Unknown")
+  }
+  else if (errors == nbr_unresolved)
+  {
+    for (std::unordered_set<std::string>::const_iterator it = dirty.begin(); it != dirty.end(); ++it)
     {
-      founded_sql = founded;
+      new_marks.erase(*it);
     }
-
-    std::string employees_sql = "0";
-    if (!employees.empty() && employees != "Unknown")
+    if (save_watermarks("FactFinancials", new_marks) < 0)
     {
-      employees_sql = employees;
+      return -1;
     }
+  }
 
-    std::stringstream sql;
-    sql << "INSERT INTO DimCompany (Ticker, CompanyName, Sector, Industry, CEO, Founded, Headquarters, Employees, MarketCapTier, EffectiveDate, IsCurrent) "
-      << "VALUES ('" << ticker << "', '" << company_name << "', '" << sector << "', '" << industry << "', '"
-      << ceo << "', " << founded_sql << ", '" << headquarters << "', " << employees_sql << ", '" << market_cap_tier << "', GETDATE(), 1)";
+  if (nbr_partitions == 1 && errors == 0)
+  {
+    save_source(filename, fingerprint);
+  }
+  return 0;
+}
 
-    std::cout << sql.str() << std::endl;
-    
-    if (odbc.exec_direct(sql.str()) < 0)
-    {
-      assert(0);
-    }
-    else
-    {
-      count++;
-    }
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// etl_t::is_partitioned
+// returns 1 if the clustered index (or heap) of 'table' is on a partition scheme, 0 if not, -1 on error
+//
+// SQL:
+//   SELECT COUNT(*) AS Partitioned FROM sys.indexes i
+//   JOIN sys.partition_schemes ps ON ps.data_space_id=i.data_space_id
+//   WHERE i.object_id=OBJECT_ID('FactDailyStock') AND i.index_id<=1
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int etl_t::is_partitioned(const std::string& table)
+{
+  std::string sql =
+    "SELECT COUNT(*) AS Partitioned FROM sys.indexes i "
+    "JOIN sys.partition_schemes ps ON ps.data_space_id=i.data_space_id "
+    "WHERE i.object_id=OBJECT_ID(?) AND i.index_id<=1";
+
+  typed_table_t table_partitioned;
+  if (odbc.fetch(sql, { table }, table_partitioned) < 0 || table_partitioned.nbr_rows == 0)
+  {
+    return -1;
   }
+  return table_partitioned.col("Partitioned").get_int(0) > 0 ? 1 : 0;
+}
 
-  reader.close();
-  std::cout << "Loaded " << count << " companies (" << errors << " errors)" << std::endl;
-  return 0;
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// etl_t::create_load_table
+// creates '<table>_Load', an empty heap with the columns of 'table', the bulk copy target of --switch
+//
+// SQL:
+//   IF OBJECT_ID('FactDailyStock_Load') IS NOT NULL DROP TABLE FactDailyStock_Load;
+//   SELECT TOP (0) * INTO FactDailyStock_Load FROM FactDailyStock
+//
+// a heap without indexes loaded with TABLOCK is minimally logged; the identity property is copied,
+// the keys it generates are not used (switch_months inserts without the key column)
+// the load table has the layout of 'table', whichever script created it (create_schema or schema.sql);
+// bcp_t binds the loaded columns by name and switch_months copies them by name, so extra columns in
+// 'table' stay NULL instead of shifting the values
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int etl_t::create_load_table(const std::string& table)
+{
+  std::string load = table + "_Load";
+  return odbc.exec_direct(
+    "IF OBJECT_ID('" + load + "') IS NOT NULL DROP TABLE " + load + "; "
+    "SELECT TOP (0) * INTO " + load + " FROM " + table);
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////
-// etl_t::load_stock_data_from_csv
-// loads daily stock price data from CSV into FactDailyStock fact table
+// etl_t::switch_months
+// replaces each month present in '<table>_Load' with the rows of that month, then drops the load table
+//
+// parameters:
+//   key     - identity column of 'table' (StockFactKey, FinancialKey)
+//   columns - the loaded columns other than the key, in any order; columns of 'table' not listed are NULL
+//   months  - returns the months replaced, YYYYMM
 //
-// duplicate check SQL:
-//   SELECT StockFactKey FROM FactDailyStock WHERE DateKey=20251230 AND CompanyKey=1
+// SQL, month with a partition of its own (PARTITION::FIRST_YEAR to PARTITION::LAST_YEAR):
+//   SELECT DISTINCT DateKey / 100 AS Month, $PARTITION.pf_DateKey(DateKey / 100 * 100 + 1) AS PartitionNbr
+//   FROM FactDailyStock_Load
 //
-// insert SQL:
-//   INSERT INTO FactDailyStock (DateKey, CompanyKey, OpenPrice, HighPrice,
-//                               LowPrice, ClosePrice, Volume, MarketCap, DailyReturn)
-//   VALUES (20251230, 1, 254.12, 257.89, 253.45, 256.78, 45678900, 3890000000000, 0.0082)
+//   SET XACT_ABORT ON;
+//   SELECT TOP (0) * INTO FactDailyStock_Switch FROM FactDailyStock;
+//   ALTER TABLE FactDailyStock_Switch ADD PRIMARY KEY (DateKey, StockFactKey),
+//     CHECK (DateKey >= 20251201 AND DateKey < 20251301),
+//     FOREIGN KEY (DateKey) REFERENCES DimDate(DateKey),
+//     FOREIGN KEY (CompanyKey) REFERENCES DimCompany(CompanyKey);
+//   DECLARE @seed BIGINT = IDENT_CURRENT('FactDailyStock');
+//   DBCC CHECKIDENT('FactDailyStock_Switch', RESEED, @seed) WITH NO_INFOMSGS;
+//   INSERT INTO FactDailyStock_Switch WITH (TABLOCK) (DateKey, ...)
+//   SELECT DateKey, ... FROM FactDailyStock_Load WHERE DateKey >= 20251201 AND DateKey < 20251301;
+//   BEGIN TRANSACTION;
+//   TRUNCATE TABLE FactDailyStock WITH (PARTITIONS (73));
+//   ALTER TABLE FactDailyStock_Switch SWITCH TO FactDailyStock PARTITION 73;
+//   COMMIT TRANSACTION;
+//   DROP TABLE FactDailyStock_Switch;
+//   DBCC CHECKIDENT('FactDailyStock', RESEED) WITH NO_INFOMSGS
+//
+// other months, and every month of a table that is not partitioned (created before partitioning):
+//   BEGIN TRANSACTION;
+//   DELETE FROM FactDailyStock WHERE DateKey >= 20251201 AND DateKey < 20251301;
+//   INSERT INTO FactDailyStock (DateKey, ...) SELECT DateKey, ... FROM FactDailyStock_Load WHERE ...;
+//   COMMIT TRANSACTION
 //
 // notes:
-//   - uses get_company_key() to resolve ticker to surrogate key
-//   - uses get_date_key() to convert date string to integer key
-//   - skips duplicates (same DateKey + CompanyKey)
+//   - the month is written (minimally logged, TABLOCK into an empty table) to a table with the
+//     structure, constraints and filegroup of its partition; the truncate and the switch are metadata
+//     changes, so readers see the old month until the commit and the new one after it
+//   - the switch table takes identity values after the current ones of 'table', and 'table' is
+//     reseeded past them afterwards, so fact keys stay unique
+//   - requires SQL Server 2016 or later (TRUNCATE TABLE ... WITH PARTITIONS)
 /////////////////////////////////////////////////////////////////////////////////////////////////////
 
-int etl_t::load_stock_data_from_csv(const std::string& filename)
+int etl_t::switch_months(const std::string& table, const std::string& key, const std::string& columns,
+  std::vector<int>& months)
 {
-  read_csv_t reader;
+  std::string load = table + "_Load";
+  std::string stage = table + "_Switch";
+  months.clear();
 
-  if (reader.open(filename) < 0)
+  int partitioned = is_partitioned(table);
+  if (partitioned < 0)
   {
     return -1;
   }
 
-  /////////////////////////////////////////////////////////////////////////////////////////////////////
-  // skip header row
-  /////////////////////////////////////////////////////////////////////////////////////////////////////
-
-  std::vector<std::string> row = reader.read_row_by_comma();
-  if (row.empty())
+  typed_table_t table_months;
+  std::string sql_months = partitioned ?
+    "SELECT DISTINCT DateKey / 100 AS Month, $PARTITION.pf_DateKey(DateKey / 100 * 100 + 1) AS PartitionNbr "
+    "FROM " + load + " ORDER BY Month" :
+    "SELECT DISTINCT DateKey / 100 AS Month, 0 AS PartitionNbr FROM " + load + " ORDER BY Month";
+  if (odbc.fetch(sql_months, table_months) < 0)
   {
-    reader.close();
     return -1;
   }
 
-  int count = 0;
-  int errors = 0;
-
-  while (true)
+  const typed_column_t& col_month = table_months.col("Month");
+  const typed_column_t& col_partition = table_months.col("PartitionNbr");
+  int nbr_switched = 0;
+  for (size_t idx = 0; idx < table_months.nbr_rows; idx++)
   {
-    row = reader.read_row_by_comma();
-    if (row.empty())
-    {
-      break;
-    }
-
-    if (row.size() < 9)
-    {
-      continue;
-    }
-
-    std::string ticker = row[0];
-    std::string date_str = row[1];
-    std::string open_price = row[2];
-    std::string high_price = row[3];
-    std::string low_price = row[4];
-    std::string close_price = row[5];
-    std::string volume = row[6];
-    std::string market_cap = row[7];
-    std::string daily_return = row[8];
-
-    int company_key = get_company_key(ticker);
-    if (company_key < 0)
-    {
-      errors++;
-      continue;
-    }
-
-    int date_key = get_date_key(date_str);
-    if (date_key < 0)
+    int month = static_cast<int>(col_month.get_int(idx));
+    int year = month / 100;
+    std::string range = "DateKey >= " + std::to_string(month * 100) + " AND DateKey < " + std::to_string(month * 100 + 100);
+    std::string sql;
+    if (partitioned && year >= PARTITION::FIRST_YEAR && year <= PARTITION::LAST_YEAR)
     {
-      errors++;
-      continue;
-    }
-
-    /////////////////////////////////////////////////////////////////////////////////////////////////////
-    // check for duplicate
-    // SQL: SELECT StockFactKey FROM FactDailyStock WHERE DateKey=X AND CompanyKey=Y
-    /////////////////////////////////////////////////////////////////////////////////////////////////////
-
-    std::stringstream check_sql;
-    check_sql << "SELECT StockFactKey FROM FactDailyStock WHERE DateKey=" << date_key << " AND CompanyKey=" << company_key;
-
-    table_t table;
-    if (odbc.fetch(check_sql.str(), table) < 0)
-    {
-      errors++;
-      continue;
+      std::string partition = std::to_string(col_partition.get_int(idx));
+      sql =
+        "SET XACT_ABORT ON; "
+        "IF OBJECT_ID('" + stage + "') IS NOT NULL DROP TABLE " + stage + "; "
+        "SELECT TOP (0) * INTO " + stage + " FROM " + table + "; "
+        "ALTER TABLE " + stage + " ADD PRIMARY KEY (DateKey, " + key + "), CHECK (" + range + "), "
+        "FOREIGN KEY (DateKey) REFERENCES DimDate(DateKey), "
+        "FOREIGN KEY (CompanyKey) REFERENCES DimCompany(CompanyKey); "
+        "DECLARE @seed BIGINT = IDENT_CURRENT('" + table + "'); "
+        "DBCC CHECKIDENT('" + stage + "', RESEED, @seed) WITH NO_INFOMSGS; "
+        "INSERT INTO " + stage + " WITH (TABLOCK) (" + columns + ") "
+        "SELECT " + columns + " FROM " + load + " WHERE " + range + "; "
+        "BEGIN TRANSACTION; "
+        "TRUNCATE TABLE " + table + " WITH (PARTITIONS (" + partition + ")); "
+        "ALTER TABLE " + stage + " SWITCH TO " + table + " PARTITION " + partition + "; "
+        "COMMIT TRANSACTION; "
+        "DROP TABLE " + stage + "; "
+        "DBCC CHECKIDENT('" + table + "', RESEED) WITH NO_INFOMSGS";
+      nbr_switched++;
     }
-
-    if (table.rows.size() > 0)
+    else
     {
-      continue;
+      sql =
+        "SET XACT_ABORT ON; "
+        "BEGIN TRANSACTION; "
+        "DELETE FROM " + table + " WHERE " + range + "; "
+        "INSERT INTO " + table + " (" + columns + ") SELECT " + columns + " FROM " + load + " WHERE " + range + "; "
+        "COMMIT TRANSACTION";
     }
 
-    /////////////////////////////////////////////////////////////////////////////////////////////////////
-    // insert stock data
-    // SQL: INSERT INTO FactDailyStock (...) VALUES (...)
-    /////////////////////////////////////////////////////////////////////////////////////////////////////
-
-    std::stringstream sql;
-    sql << "INSERT INTO FactDailyStock (DateKey, CompanyKey, OpenPrice, HighPrice, LowPrice, ClosePrice, Volume, MarketCap, DailyReturn) "
-      << "VALUES (" << date_key << ", " << company_key << ", " << open_price << ", " << high_price << ", "
-      << low_price << ", " << close_price << ", " << volume << ", " << market_cap << ", " << daily_return << ")";
-
-    std::cout << sql.str() << std::endl;
-
-    if (odbc.exec_direct(sql.str()) < 0)
-    {
-      assert(0);
-    }
-    else
+    if (odbc.exec_direct(sql) < 0)
     {
-      count++;
+      return -1;
     }
+    months.push_back(month);
   }
 
-  reader.close();
-  std::cout << "Loaded " << count << " stock records (" << errors << " errors)" << std::endl;
+  odbc.exec_direct("DROP TABLE " + load);
+  LOG_INFO("etl", "Replaced " << months.size() << " months of " << table << " (" << nbr_switched <<
+    " by partition switch)");
   return 0;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////
-// etl_t::load_financials_from_csv
-// loads quarterly financial statement data from CSV into FactFinancials fact table
-//
-// duplicate check SQL:
-//   SELECT FinancialKey FROM FactFinancials WHERE DateKey=20250930 AND CompanyKey=1
+// etl_t::extend_partitions
+// adds the months of PARTITION::FIRST_YEAR to PARTITION::LAST_YEAR missing from pf_DateKey, so raising
+// CALENDAR::LAST_YEAR gives the new months a partition of their own in an existing database
 //
-// insert SQL:
-//   INSERT INTO FactFinancials (DateKey, CompanyKey, Revenue, GrossProfit,
-//                               OperatingIncome, NetIncome, EPS, EBITDA,
-//                               TotalAssets, TotalLiabilities, CashAndEquivalents,
-//                               TotalDebt, FreeCashFlow, RnDExpense,
-//                               GrossMargin, OperatingMargin, NetMargin, ROE, ROA)
-//   VALUES (20250930, 1, 94930000000, 43900000000, ...)
+// SQL:
+//   SELECT CAST(v.value AS INT) AS Boundary FROM sys.partition_range_values v
+//   JOIN sys.partition_functions f ON f.function_id=v.function_id WHERE f.name='pf_DateKey'
+// per missing boundary, e.g. 20270201:
+//   ALTER PARTITION SCHEME ps_DateKey NEXT USED [PRIMARY];
+//   ALTER PARTITION FUNCTION pf_DateKey() SPLIT RANGE (20270201)
 //
 // notes:
-//   - DateKey corresponds to fiscal quarter end date
-//   - financial ratios (margins, ROE, ROA) are pre-calculated in CSV
+//   - a split moves the rows at or after the new boundary out of the edge partition; rows beyond the
+//     old range are rare, since DimDate had no DateKey for them
 /////////////////////////////////////////////////////////////////////////////////////////////////////
 
-int etl_t::load_financials_from_csv(const std::string& filename)
+int etl_t::extend_partitions()
 {
-  read_csv_t reader;
-
-  if (reader.open(filename) < 0)
+  typed_table_t table;
+  if (odbc.fetch("SELECT CAST(v.value AS INT) AS Boundary FROM sys.partition_range_values v "
+    "JOIN sys.partition_functions f ON f.function_id=v.function_id WHERE f.name='pf_DateKey'", table) < 0)
   {
     return -1;
   }
 
-  /////////////////////////////////////////////////////////////////////////////////////////////////////
-  // skip header row
-  /////////////////////////////////////////////////////////////////////////////////////////////////////
-
-  std::vector<std::string> row = reader.read_row_by_comma();
-  if (row.empty())
+  std::set<int> boundaries;
+  const typed_column_t& boundary = table.col("Boundary");
+  for (size_t idx = 0; idx < table.nbr_rows; idx++)
   {
-    reader.close();
-    return -1;
+    boundaries.insert(static_cast<int>(boundary.get_int(idx)));
   }
 
-  int count = 0;
-  int errors = 0;
-
-  while (true)
+  int nbr_added = 0;
+  for (int year = PARTITION::FIRST_YEAR; year <= PARTITION::LAST_YEAR + 1; year++)
   {
-    row = reader.read_row_by_comma();
-    if (row.empty())
+    for (int month = 1; month <= 12 && (year <= PARTITION::LAST_YEAR || month == 1); month++)
     {
-      break;
+      int date_key = year * 10000 + month * 100 + 1;
+      if (boundaries.count(date_key) > 0)
+      {
+        continue;
+      }
+      if (odbc.exec_direct("ALTER PARTITION SCHEME ps_DateKey NEXT USED [PRIMARY]; "
+        "ALTER PARTITION FUNCTION pf_DateKey() SPLIT RANGE (" + std::to_string(date_key) + ")") < 0)
+      {
+        return -1;
+      }
+      nbr_added++;
     }
+  }
 
-    if (row.size() < 19)
-    {
-      continue;
-    }
+  if (nbr_added > 0)
+  {
+    LOG_INFO("etl", "Added " << nbr_added << " monthly partitions to pf_DateKey");
+  }
+  return 0;
+}
 
-    std::string ticker = row[0];
-    std::string quarter_end = row[1];
-    std::string revenue = row[2];
-    std::string gross_profit = row[3];
-    std::string operating_income = row[4];
-    std::string net_income = row[5];
-    std::string eps = row[6];
-    std::string ebitda = row[7];
-    std::string total_assets = row[8];
-    std::string total_liabilities = row[9];
-    std::string cash_equiv = row[10];
-    std::string total_debt = row[11];
-    std::string free_cash_flow = row[12];
-    std::string rnd_expense = row[13];
-    std::string gross_margin = row[14];
-    std::string operating_margin = row[15];
-    std::string net_margin = row[16];
-    std::string roe = row[17];
-    std::string roa = row[18];
-
-    int company_key = get_company_key(ticker);
-    if (company_key < 0)
-    {
-      errors++;
-      continue;
-    }
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// etl_t::purge_month
+// removes one month (YYYYMM) of FactDailyStock and FactFinancials rows and of FactSectorDaily
+//
+// SQL (per fact table, partition of the month from $PARTITION.pf_DateKey(YYYYMM01)):
+//   TRUNCATE TABLE FactDailyStock WITH (PARTITIONS (73))
+// or, for a month without its own partition or a table that is not partitioned:
+//   DELETE FROM FactDailyStock WHERE DateKey >= 20251201 AND DateKey < 20251301
+//
+// the load state (EtlWatermark, EtlLoadState) is kept: the month stays purged on the next incremental
+// run, and --full loads it again from the CSV files. FactSectorDaily is skipped when it does not exist
+// yet, --purge runs before create_schema
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int etl_t::purge_month(int month)
+{
+  const char* tables[] = { "FactDailyStock", "FactFinancials" };
+  std::string first_day = std::to_string(month * 100 + 1);
+  std::string range = "DateKey >= " + std::to_string(month * 100) + " AND DateKey < " + std::to_string(month * 100 + 100);
+  int year = month / 100;
 
-    int date_key = get_date_key(quarter_end);
-    if (date_key < 0)
+  for (size_t idx = 0; idx < 2; idx++)
+  {
+    std::string table = tables[idx];
+    int partitioned = is_partitioned(table);
+    if (partitioned < 0)
     {
-      errors++;
-      continue;
+      return -1;
     }
 
-    /////////////////////////////////////////////////////////////////////////////////////////////////////
-    // check for duplicate
-    // SQL: SELECT FinancialKey FROM FactFinancials WHERE DateKey=X AND CompanyKey=Y
-    /////////////////////////////////////////////////////////////////////////////////////////////////////
-
-    std::stringstream check_sql;
-    check_sql << "SELECT FinancialKey FROM FactFinancials WHERE DateKey=" << date_key << " AND CompanyKey=" << company_key;
-
-    table_t table;
-    if (odbc.fetch(check_sql.str(), table) < 0)
+    std::string sql = "DELETE FROM " + table + " WHERE " + range;
+    if (partitioned && year >= PARTITION::FIRST_YEAR && year <= PARTITION::LAST_YEAR)
     {
-      errors++;
-      continue;
+      typed_table_t table_partition;
+      if (odbc.fetch("SELECT $PARTITION.pf_DateKey(" + first_day + ") AS PartitionNbr", table_partition) < 0 ||
+        table_partition.nbr_rows == 0)
+      {
+        return -1;
+      }
+      sql = "TRUNCATE TABLE " + table + " WITH (PARTITIONS (" +
+        std::to_string(table_partition.col("PartitionNbr").get_int(0)) + "))";
     }
 
-    if (table.rows.size() > 0)
+    if (odbc.exec_direct(sql) < 0)
     {
-      continue;
+      return -1;
     }
+  }
+
+  if (odbc.exec_direct("IF OBJECT_ID('FactSectorDaily') IS NOT NULL DELETE FROM FactSectorDaily WHERE " + range) < 0)
+  {
+    return -1;
+  }
 
-    /////////////////////////////////////////////////////////////////////////////////////////////////////
-    // insert financials
-    // SQL: INSERT INTO FactFinancials (...) VALUES (...)
-    /////////////////////////////////////////////////////////////////////////////////////////////////////
+  LOG_INFO("etl", "Purged " << month);
+  return 0;
+}
 
-    std::stringstream sql;
-    sql << "INSERT INTO FactFinancials (DateKey, CompanyKey, Revenue, GrossProfit, OperatingIncome, NetIncome, "
-      << "EPS, EBITDA, TotalAssets, TotalLiabilities, CashAndEquivalents, TotalDebt, FreeCashFlow, RnDExpense, "
-      << "GrossMargin, OperatingMargin, NetMargin, ROE, ROA) "
-      << "VALUES (" << date_key << ", " << company_key << ", "
-      << revenue << ", " << gross_profit << ", " << operating_income << ", " << net_income << ", "
-      << eps << ", " << ebitda << ", " << total_assets << ", " << total_liabilities << ", "
-      << cash_equiv << ", " << total_debt << ", " << free_cash_flow << ", " << rnd_expense << ", "
-      << gross_margin << ", " << operating_margin << ", " << net_margin << ", " << roe << ", " << roa << ")";
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// etl_t::refresh_sector_daily
+// recomputes the FactSectorDaily rows of the dates in 'loaded_dates', then clears it
+//
+// SQL (one statement per batch of up to 500 dates, in one transaction):
+//   DELETE FROM FactSectorDaily WHERE DateKey IN (...)
+//   INSERT INTO FactSectorDaily (DateKey, Sector, Companies, TotalMarketCap, TotalVolume, AvgReturn)
+//   SELECT f.DateKey, COALESCE(c.Sector, 'Unknown'), COUNT(DISTINCT c.Ticker), SUM(f.MarketCap), SUM(f.Volume),
+//     AVG(f.DailyReturn)
+//   FROM FactDailyStock f
+//   JOIN DimCompany c ON c.CompanyKey = f.CompanyKey
+//   WHERE f.DateKey IN (...)
+//   GROUP BY f.DateKey, COALESCE(c.Sector, 'Unknown')
+//
+// notes:
+//   - a date is recomputed from all its fact rows, not only the new ones, so a row skipped as a
+//     duplicate or a partial earlier load cannot leave a wrong total
+//   - the sector is the one of the company version (CompanyKey) the row was loaded with
+//   - companies without a sector (DimCompany.Sector is nullable, FactSectorDaily.Sector is not) are
+//     counted in the sector 'Unknown', so the sector totals add up to the market totals
+//   - an empty FactSectorDaily with stock rows (database loaded before the table existed) is rebuilt
+//     for every date first
+//   - the DateKeys are integers from the date dimension and are written into the statement
+/////////////////////////////////////////////////////////////////////////////////////////////////////
 
-    std::cout << sql.str() << std::endl;
+int etl_t::refresh_sector_daily()
+{
+  std::string sql_select =
+    "SELECT f.DateKey, COALESCE(c.Sector, 'Unknown'), COUNT(DISTINCT c.Ticker), SUM(f.MarketCap), SUM(f.Volume), "
+    "AVG(f.DailyReturn) "
+    "FROM FactDailyStock f "
+    "JOIN DimCompany c ON c.CompanyKey = f.CompanyKey ";
+  std::string sql_insert =
+    "INSERT INTO FactSectorDaily (DateKey, Sector, Companies, TotalMarketCap, TotalVolume, AvgReturn) ";
+
+  std::string sql_rebuild =
+    "IF NOT EXISTS (SELECT 1 FROM FactSectorDaily) AND EXISTS (SELECT 1 FROM FactDailyStock) " +
+    sql_insert + sql_select + "GROUP BY f.DateKey, COALESCE(c.Sector, 'Unknown')";
+  if (odbc.exec_direct(sql_rebuild) < 0)
+  {
+    return -1;
+  }
 
-    if (odbc.exec_direct(sql.str()) < 0)
+  const size_t batch_size = 500;
+  size_t nbr_dates = loaded_dates.size();
+  std::set<int>::const_iterator it = loaded_dates.begin();
+  while (it != loaded_dates.end())
+  {
+    std::string keys;
+    for (size_t idx = 0; idx < batch_size && it != loaded_dates.end(); idx++, ++it)
     {
-      assert(0);
+      if (!keys.empty())
+      {
+        keys += ",";
+      }
+      keys += std::to_string(*it);
     }
-    else
+
+    std::string sql =
+      "SET XACT_ABORT ON; BEGIN TRANSACTION; "
+      "DELETE FROM FactSectorDaily WHERE DateKey IN (" + keys + "); " +
+      sql_insert + sql_select + "WHERE f.DateKey IN (" + keys + ") GROUP BY f.DateKey, COALESCE(c.Sector, 'Unknown'); "
+      "COMMIT TRANSACTION";
+    if (odbc.exec_direct(sql) < 0)
     {
-      count++;
+      return -1;
     }
   }
 
-  reader.close();
-  std::cout << "Loaded " << count << " financial records (" << errors << " errors)" << std::endl;
+  loaded_dates.clear();
+  LOG_INFO("etl", "Refreshed sector aggregates of " << nbr_dates << " dates");
   return 0;
 }
 
@@ -1121,6 +3293,7 @@ int etl_t::load_financials_from_csv(const std::string& filename)
 //
 // step 2 - insert new record with updated field:
 //   INSERT INTO DimCompany (Ticker, CompanyName, Sector, Industry, CEO, ...)
+//   OUTPUT INSERTED.CompanyKey
 //   SELECT Ticker, CompanyName, Sector, Industry,
 //     CASE WHEN 'CEO'='CEO' THEN 'New CEO Name' ELSE CEO END, ...
 //   FROM DimCompany WHERE Ticker='MSFT' AND ExpiryDate=CAST(GETDATE() AS DATE)
@@ -1129,6 +3302,8 @@ int etl_t::load_financials_from_csv(const std::string& filename)
 //   CompanyKey | Ticker | CEO           | EffectiveDate | ExpiryDate | IsCurrent
 //   1          | MSFT   | Satya Nadella | 2020-01-01    | 2025-06-01 | 0
 //   2          | MSFT   | New CEO       | 2025-06-01    | NULL       | 1
+//
+// the key cache maps the ticker to the new CompanyKey
 /////////////////////////////////////////////////////////////////////////////////////////////////////
 
 int etl_t::update_company_scd2(const std::string& ticker, const std::string& field, const std::string& new_value)
@@ -1139,31 +3314,46 @@ int etl_t::update_company_scd2(const std::string& ticker, const std::string& fie
   //      WHERE Ticker='MSFT' AND IsCurrent=1
   /////////////////////////////////////////////////////////////////////////////////////////////////////
 
-  std::stringstream sql_expire;
-  sql_expire << "UPDATE DimCompany SET ExpiryDate=GETDATE(), IsCurrent=0 "
-    << "WHERE Ticker='" << ticker << "' AND IsCurrent=1";
+  std::string sql_expire =
+    "UPDATE DimCompany SET ExpiryDate=GETDATE(), IsCurrent=0 "
+    "WHERE Ticker=? AND IsCurrent=1";
 
-  if (odbc.exec_direct(sql_expire.str()) < 0)
+  if (odbc.execute(sql_expire, { ticker }) < 0)
   {
     assert(0);
   }
+  cache.remove_company(ticker);
 
   /////////////////////////////////////////////////////////////////////////////////////////////////////
   // insert new record with updated field
   // SQL: INSERT INTO DimCompany (...) SELECT ... CASE WHEN ... FROM DimCompany WHERE ...
   /////////////////////////////////////////////////////////////////////////////////////////////////////
 
-  std::stringstream sql_insert;
-  sql_insert << "INSERT INTO DimCompany (Ticker, CompanyName, Sector, Industry, CEO, Founded, Headquarters, Employees, MarketCapTier, EffectiveDate) "
-    << "SELECT Ticker, CompanyName, Sector, Industry, "
-    << "CASE WHEN '" << field << "'='CEO' THEN '" << new_value << "' ELSE CEO END, "
-    << "Founded, Headquarters, Employees, MarketCapTier, GETDATE() "
-    << "FROM DimCompany WHERE Ticker='" << ticker << "' AND ExpiryDate=CAST(GETDATE() AS DATE)";
+  std::string sql_insert =
+    "INSERT INTO DimCompany (Ticker, CompanyName, Sector, Industry, CEO, Founded, Headquarters, Employees, MarketCapTier, EffectiveDate) "
+    "OUTPUT INSERTED.CompanyKey "
+    "SELECT Ticker, CompanyName, Sector, Industry, "
+    "CASE WHEN ?='CEO' THEN ? ELSE CEO END, "
+    "Founded, Headquarters, Employees, MarketCapTier, GETDATE() "
+    "FROM DimCompany WHERE Ticker=? AND ExpiryDate=CAST(GETDATE() AS DATE)";
 
-  if (odbc.exec_direct(sql_insert.str()) < 0)
+  typed_table_t inserted;
+  if (odbc.fetch(sql_insert, { field, new_value, ticker }, inserted) < 0)
   {
     assert(0);
   }
+  else
+  {
+    //rows expired earlier the same day are copied too, the current row has the highest key
+    const typed_column_t& company_key = inserted.col("CompanyKey");
+    for (size_t idx = 0; idx < inserted.nbr_rows; idx++)
+    {
+      if (company_key.get_int(idx) > cache.get_company_key(ticker))
+      {
+        cache.set_company_key(ticker, static_cast<int>(company_key.get_int(idx)));
+      }
+    }
+  }
 
   return 0;
 }
@@ -1190,6 +3380,10 @@ int etl_t::run_analytics()
 {
   table_t table;
 
+  //analytics scan the fact tables, fetch with a block cursor; restored at the end
+  size_t row_array_size = odbc.get_row_array_size();
+  odbc.set_row_array_size(ODBC::ROW_ARRAY_SIZE);
+
   /////////////////////////////////////////////////////////////////////////////////////////////////////
   // market cap rankings
   //
@@ -1219,6 +3413,7 @@ int etl_t::run_analytics()
 
   if (odbc.fetch(sql_rank, table) < 0)
   {
+    odbc.set_row_array_size(row_array_size);
     return -1;
   }
 
@@ -1250,31 +3445,25 @@ int etl_t::run_analytics()
   // sector breakdown
   //
   // SQL:
-  //   SELECT c.Sector, COUNT(DISTINCT c.Ticker) AS Companies,
-  //     SUM(f.MarketCap)/1e12 AS TotalMarketCapT
-  //   FROM FactDailyStock f
-  //   JOIN DimCompany c ON f.CompanyKey = c.CompanyKey
-  //   WHERE c.IsCurrent = 1
-  //     AND f.DateKey = (SELECT MAX(DateKey) FROM FactDailyStock)
-  //   GROUP BY c.Sector
+  //   SELECT Sector, Companies, TotalMarketCap/1e12 AS TotalMarketCapT
+  //   FROM FactSectorDaily
+  //   WHERE DateKey = (SELECT MAX(DateKey) FROM FactSectorDaily)
   //   ORDER BY TotalMarketCapT DESC
   //
   // notes:
-  //   - COUNT(DISTINCT) ensures each company counted once
-  //   - GROUP BY aggregates at sector level
+  //   - reads the sector/day aggregate kept by refresh_sector_daily, one row per sector
+  //   - MAX(DateKey) is the first key of the primary key, a seek instead of a fact table scan
   /////////////////////////////////////////////////////////////////////////////////////////////////////
 
   std::string sql_sector =
-    "SELECT c.Sector, COUNT(DISTINCT c.Ticker) AS Companies, SUM(f.MarketCap)/1e12 AS TotalMarketCapT "
-    "FROM FactDailyStock f "
-    "JOIN DimCompany c ON f.CompanyKey = c.CompanyKey "
-    "WHERE c.IsCurrent = 1 "
-    "AND f.DateKey = (SELECT MAX(DateKey) FROM FactDailyStock) "
-    "GROUP BY c.Sector "
+    "SELECT Sector, Companies, TotalMarketCap/1e12 AS TotalMarketCapT "
+    "FROM FactSectorDaily "
+    "WHERE DateKey = (SELECT MAX(DateKey) FROM FactSectorDaily) "
     "ORDER BY TotalMarketCapT DESC";
 
   if (odbc.fetch(sql_sector, table) < 0)
   {
+    odbc.set_row_array_size(row_array_size);
     return -1;
   }
 
@@ -1351,6 +3540,7 @@ int etl_t::run_analytics()
     }
   }
 
+  odbc.set_row_array_size(row_array_size);
   return 0;
 }
 
@@ -0,0 +1,128 @@
+#ifndef ETL_HH
+#define ETL_HH 1
+
+#include "odbc.hh"
+#include "csv.hh"
+#include "dim_cache.hh"
+#include "indicators.hh"
+#include "pipeline.hh"
+#include "calendar.hh"
+#include <string>
+#include <string_view>
+#include <vector>
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+#include <set>
+#include <deque>
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// PARTITION
+// fact tables are partitioned by month on DateKey (partition function pf_DateKey, RANGE RIGHT on the
+// first day of each month); months from FIRST_YEAR to LAST_YEAR have a partition of their own, earlier
+// and later dates share the two edge partitions; the years are those of the date dimension
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace PARTITION
+{
+  const int FIRST_YEAR = CALENDAR::FIRST_YEAR;
+  const int LAST_YEAR = CALENDAR::LAST_YEAR;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// FINGERPRINT
+// the fingerprint of a CSV file (EtlLoadState) hashes its first and last BLOCK_SIZE bytes
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace FINGERPRINT
+{
+  const size_t BLOCK_SIZE = 65536;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// fact_row_t
+// one fact row made by the transform stage of a loader pipeline: statement parameters in the column
+// order of the load mode, and a description printed if the row is rejected (e.g., 'AAPL 2025-12-30')
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct fact_row_t
+{
+  std::vector<param_t> params;
+  std::string label;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// etl_t
+// ETL for US Companies Data Warehouse using Kimball star schema
+// implements extract, transform, load operations for financial data
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class etl_t
+{
+public:
+  etl_t();
+  ~etl_t();
+  int connect(const std::string& server, const std::string& database,
+    const std::string& user = std::string(), const std::string& password = std::string(), bool bulk_copy = false);
+  int disconnect();
+  int create_schema();
+  int delete_data();
+  int load_cache();
+  int load_date_dimension(int start_year, int end_year);
+  int load_companies_from_csv(const std::string& filename);
+  int load_stock_data_from_csv(const std::string& filename, bool bulk = false, bool staging = false);
+  int load_financials_from_csv(const std::string& filename, bool bulk = false, bool staging = false);
+  int load_facts_parallel(size_t jobs, const std::string& stock_file, const std::string& financials_file,
+    bool bulk = false, bool staging = false);
+  int refresh_sector_daily();
+  int purge_month(int month);
+  int update_company_scd2(const std::string& ticker, const std::string& field, const std::string& new_value);
+  int run_analytics();
+  void set_incremental(bool incremental);
+  void set_partition_switch(bool partition_switch);
+  void set_parse_jobs(size_t parse_jobs);
+
+private:
+  odbc_t odbc;
+  dim_cache_t cache;
+  std::string conn; //connection string and bulk copy flag of connect(), reused by the parallel workers
+  bool bulk_copy;
+  size_t partition; //fact loaders keep only the tickers with hash % nbr_partitions == partition
+  size_t nbr_partitions;
+  bool incremental; //skip unchanged files and fact rows at or below the watermark of their ticker
+  bool partition_switch; //bulk loads go to a load table and replace the fact table months by partition switch
+  size_t parse_jobs; //threads that parse a fact CSV file in the read stage of run_pipeline
+  spsc_queue_t<csv_chunk_t>* input; //rows routed by load_facts_parallel (--jobs), instead of reading the file
+  int nbr_errors; //rows rejected by the last fact loader call
+  std::set<int> loaded_dates; //DateKeys of the FactDailyStock rows loaded since the last refresh_sector_daily
+  std::unordered_map<std::string, std::vector<double>> close_history; //last closes per ticker, see fetch_close_history
+  bool close_history_loaded;
+  bool in_partition(const std::string& ticker) const;
+  int source_unchanged(const std::string& filename, std::string& fingerprint);
+  int save_source(const std::string& filename, const std::string& fingerprint);
+  int load_watermarks(const std::string& table, std::unordered_map<std::string, int>& marks);
+  int save_watermarks(const std::string& table, const std::unordered_map<std::string, int>& marks);
+  int rebuild_watermarks(const std::string& table, int first_month, const std::unordered_set<std::string>& dirty);
+  int get_company_key(const std::string& ticker);
+  int get_date_key(const std::string& date_str);
+  param_t number_param(std::string_view value);
+  int flush_batch(const std::string& sql, std::vector<std::vector<param_t>>& rows,
+    std::vector<std::string>& labels, int& errors, int* skipped = NULL);
+  int merge_staged(const std::string& stage_table, const std::string& merge_sql, int& errors);
+  int route_csv(map_csv_t& reader, const std::string& filename, std::deque<spsc_queue_t<csv_chunk_t>>& queues,
+    std::deque<std::deque<std::string>>& unquoted);
+  int run_pipeline(map_csv_t& reader,
+    const std::function<int(const csv_row_t& row, std::vector<fact_row_t>& facts)>& transform,
+    const std::function<void(std::vector<fact_row_t>& facts)>& finish,
+    const std::function<int(fact_row_t& fact)>& load, int& errors);
+  int fetch_close_history(const std::unordered_map<std::string, int>& marks, int before = 0);
+  int load_indicator_history(const std::unordered_map<std::string, int>& marks, indicator_engine_t& indicators,
+    int before = 0);
+  int is_partitioned(const std::string& table);
+  int extend_partitions();
+  int create_load_table(const std::string& table);
+  int switch_months(const std::string& table, const std::string& key, const std::string& columns,
+    std::vector<int>& months);
+};
+
+#endif
@@ -0,0 +1,278 @@
+#include "etl.hh"
+#include "stats.hh"
+#include "log.hh"
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// usage
+// same syntax as sqlcmd
+// -S localhost -d data_warehouse
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void usage(const char* program_name)
+{
+  std::cout << "Usage: " << program_name << " [OPTIONS]" << std::endl;
+  std::cout << std::endl;
+  std::cout << "Deletes all data, then runs every ETL phase once on the CSV files and reports rows/s" << std::endl;
+  std::cout << std::endl;
+  std::cout << "Required options:" << std::endl;
+  std::cout << "  -S SERVER     SQL Server hostname or IP address" << std::endl;
+  std::cout << "  -d DATABASE   Database name" << std::endl;
+  std::cout << std::endl;
+  std::cout << "Optional options:" << std::endl;
+  std::cout << "  -U USER       SQL Server username (omit for trusted connection)" << std::endl;
+  std::cout << "  -P PASSWORD   SQL Server password" << std::endl;
+  std::cout << "  -i DIR        Directory of companies.csv, stock_data.csv, financials.csv (default: current directory)" << std::endl;
+  std::cout << "  --bulk        Load the fact tables with bulk copy" << std::endl;
+  std::cout << "  --staging     Load the fact tables through staging tables" << std::endl;
+  std::cout << "  --switch      Load the fact tables with bulk copy and partition switches" << std::endl;
+  std::cout << "  --jobs N      Load the fact tables with N threads (default: 1)" << std::endl;
+  std::cout << "  --parse-jobs N  Parse each fact CSV file with N threads (default: 1)" << std::endl;
+  std::cout << "  --log SPEC    Log levels of the ETL messages (default: warn)" << std::endl;
+  std::cout << std::endl;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// phase_t
+// one timed ETL phase; 'rows' is the number of CSV rows it reads, 0 for phases without input rows
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct phase_t
+{
+  std::string name;
+  long long rows;
+  long long elapsed_us;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// count_rows
+// data rows of a CSV file (lines after the header), counted before the timed phases
+// returns -1 if the file cannot be read
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+long long count_rows(const std::string& filename)
+{
+  std::ifstream ifs(filename, std::ios::binary);
+  if (!ifs.is_open())
+  {
+    return -1;
+  }
+  std::vector<char> buf(1 << 20);
+  long long lines = 0;
+  while (ifs.read(buf.data(), buf.size()) || ifs.gcount() > 0)
+  {
+    lines += std::count(buf.data(), buf.data() + ifs.gcount(), '\n');
+  }
+  return lines > 0 ? lines - 1 : 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// run_phase
+// times 'fn' and appends it to 'phases'; returns the result of 'fn'
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int run_phase(std::vector<phase_t>& phases, const std::string& name, long long rows, const std::function<int()>& fn)
+{
+  long long start = now_us();
+  int rc = fn();
+  log_flush();
+  phases.push_back({ name, rows, now_us() - start });
+  return rc;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// print_phases
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void print_phases(const std::vector<phase_t>& phases)
+{
+  char buf[256];
+  long long total_us = 0;
+  std::cout << std::endl;
+  for (size_t idx = 0; idx < phases.size(); idx++)
+  {
+    const phase_t& phase = phases[idx];
+    total_us += phase.elapsed_us;
+    if (phase.rows > 0)
+    {
+      snprintf(buf, sizeof(buf), "Phase %-12s %12lld rows %10.1f ms %12.0f rows/s\n", phase.name.c_str(),
+        phase.rows, phase.elapsed_us / 1000.0, phase.rows * 1e6 / std::max(1LL, phase.elapsed_us));
+    }
+    else
+    {
+      snprintf(buf, sizeof(buf), "Phase %-12s %12s      %10.1f ms\n", phase.name.c_str(), "",
+        phase.elapsed_us / 1000.0);
+    }
+    std::cout << buf;
+  }
+  snprintf(buf, sizeof(buf), "Total %-12s %12s      %10.1f ms\n", "", "", total_us / 1000.0);
+  std::cout << buf << std::flush;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// main
+// end-to-end ETL benchmark: the same phases as etl, on an emptied database, every row loaded
+// (no incremental skipping); generate large inputs with datagen
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char* argv[])
+{
+  std::string server;
+  std::string database;
+  std::string user;
+  std::string password;
+  std::string dir;
+  bool bulk = false;
+  bool staging = false;
+  bool partition_switch = false;
+  size_t jobs = 1;
+  size_t parse_jobs = 1;
+  std::string log_spec = "warn";
+
+  for (int idx = 1; idx < argc; idx++)
+  {
+    std::string arg = argv[idx];
+    if (arg == "-h" || arg == "--help")
+    {
+      usage(argv[0]);
+      return 0;
+    }
+    else if (arg == "-S" && idx + 1 < argc)
+    {
+      server = argv[++idx];
+    }
+    else if (arg == "-d" && idx + 1 < argc)
+    {
+      database = argv[++idx];
+    }
+    else if (arg == "-U" && idx + 1 < argc)
+    {
+      user = argv[++idx];
+    }
+    else if (arg == "-P" && idx + 1 < argc)
+    {
+      password = argv[++idx];
+    }
+    else if (arg == "-i" && idx + 1 < argc)
+    {
+      dir = argv[++idx];
+    }
+    else if (arg == "--bulk")
+    {
+      bulk = true;
+    }
+    else if (arg == "--staging")
+    {
+      staging = true;
+    }
+    else if (arg == "--switch")
+    {
+      bulk = true;
+      partition_switch = true;
+    }
+    else if (arg == "--jobs" && idx + 1 < argc)
+    {
+      jobs = static_cast<size_t>(std::max(1, atoi(argv[++idx])));
+    }
+    else if (arg == "--parse-jobs" && idx + 1 < argc)
+    {
+      parse_jobs = static_cast<size_t>(std::max(1, atoi(argv[++idx])));
+    }
+    else if (arg == "--log" && idx + 1 < argc)
+    {
+      log_spec = argv[++idx];
+    }
+  }
+
+  if (server.empty() || database.empty())
+  {
+    usage(argv[0]);
+    return 1;
+  }
+
+  if ((bulk && staging) || (partition_switch && jobs > 1))
+  {
+    std::cout << "Error: --staging cannot be combined with --bulk or --switch, --switch cannot be combined with --jobs" << std::endl;
+    return 1;
+  }
+
+  if (log_configure(log_spec) < 0 || log_start() < 0)
+  {
+    std::cout << "Error: invalid --log level '" << log_spec << "'" << std::endl;
+    return 1;
+  }
+
+  std::string prefix = dir.empty() ? std::string() : dir + "/";
+  std::string companies_file = prefix + "companies.csv";
+  std::string stock_file = prefix + "stock_data.csv";
+  std::string financials_file = prefix + "financials.csv";
+
+  long long nbr_companies = count_rows(companies_file);
+  long long nbr_stock = count_rows(stock_file);
+  long long nbr_financials = count_rows(financials_file);
+  if (nbr_companies < 0 || nbr_stock < 0 || nbr_financials < 0)
+  {
+    std::cout << "Error: cannot read the CSV files in '" << (dir.empty() ? "." : dir) << "'" << std::endl;
+    return 1;
+  }
+
+  std::cout << "ETL Benchmark:" << std::endl;
+  std::cout << "  Server:     " << server << std::endl;
+  std::cout << "  Database:   " << database << std::endl;
+  std::cout << "  Load mode:  " << (partition_switch ? "switch" : bulk ? "bulk" : staging ? "staging" : "row") <<
+    ", " << jobs << (jobs == 1 ? " job" : " jobs") << ", " << parse_jobs <<
+    (parse_jobs == 1 ? " parse job" : " parse jobs") << std::endl;
+  std::cout << "  Input rows: " << nbr_companies << " companies, " << nbr_stock << " stock, " <<
+    nbr_financials << " financials" << std::endl;
+
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+  // phases, in the order of etl; the first failure stops the run
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+
+  etl_t etl;
+  etl.set_incremental(false);
+  etl.set_partition_switch(partition_switch);
+  etl.set_parse_jobs(parse_jobs);
+  std::vector<phase_t> phases;
+
+  int rc = run_phase(phases, "connect", 0, [&]() { return etl.connect(server, database, user, password, bulk); });
+  if (rc < 0)
+  {
+    return 1;
+  }
+
+  rc = run_phase(phases, "schema", 0, [&]() { return etl.create_schema(); });
+  if (rc == 0) rc = run_phase(phases, "delete", 0, [&]() { return etl.delete_data(); });
+  if (rc == 0) rc = run_phase(phases, "cache", 0, [&]() { return etl.load_cache(); });
+  if (rc == 0) rc = run_phase(phases, "dates", 0, [&]() { return etl.load_date_dimension(CALENDAR::FIRST_YEAR, CALENDAR::LAST_YEAR); });
+  if (rc == 0) rc = run_phase(phases, "companies", nbr_companies, [&]() { return etl.load_companies_from_csv(companies_file); });
+  if (rc == 0 && jobs > 1)
+  {
+    rc = run_phase(phases, "facts", nbr_stock + nbr_financials, [&]()
+      {
+        return etl.load_facts_parallel(jobs, stock_file, financials_file, bulk, staging);
+      });
+  }
+  else if (rc == 0)
+  {
+    rc = run_phase(phases, "stock", nbr_stock, [&]() { return etl.load_stock_data_from_csv(stock_file, bulk, staging); });
+    if (rc == 0) rc = run_phase(phases, "financials", nbr_financials, [&]() { return etl.load_financials_from_csv(financials_file, bulk, staging); });
+  }
+  if (rc == 0) rc = run_phase(phases, "sectors", 0, [&]() { return etl.refresh_sector_daily(); });
+  if (rc == 0) rc = run_phase(phases, "analytics", 0, [&]() { return etl.run_analytics(); });
+
+  etl.disconnect();
+  print_phases(phases);
+  if (rc < 0)
+  {
+    std::cout << "Error: phase " << phases.back().name << " failed" << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,337 @@
+#include "etl.hh"
+#include "log.hh"
+#include <iostream>
+#include <string>
+#include <algorithm>
+#include <cstdlib>
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// usage
+// same syntax as sqlcmd
+// -S localhost -d data_warehouse
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void usage(const char* program_name)
+{
+  std::cout << "Usage: " << program_name << " [OPTIONS]" << std::endl;
+  std::cout << std::endl;
+  std::cout << "Required options:" << std::endl;
+  std::cout << "  -S SERVER     SQL Server hostname or IP address" << std::endl;
+  std::cout << "  -d DATABASE   Database name" << std::endl;
+  std::cout << std::endl;
+  std::cout << "Optional options:" << std::endl;
+  std::cout << "  -U USER       SQL Server username (omit for trusted connection)" << std::endl;
+  std::cout << "  -P PASSWORD   SQL Server password" << std::endl;
+  std::cout << "  --delete  Delete all data from all tables" << std::endl;
+  std::cout << "  --bulk    Reload FactDailyStock and FactFinancials with bulk copy (replaces existing fact rows)" << std::endl;
+  std::cout << "  --staging Load the fact CSV files into staging tables and merge them with one statement per table" << std::endl;
+  std::cout << "  --switch  Reload the months of the fact CSV files with bulk copy and partition switches" << std::endl;
+  std::cout << "  --purge YYYYMM  Remove one month of fact rows (partition truncate) and exit" << std::endl;
+  std::cout << "  --jobs N  Load the fact CSV files with N threads, each with its own connection (default: 1)" << std::endl;
+  std::cout << "  --parse-jobs N  Parse each fact CSV file with N threads (default: 1)" << std::endl;
+  std::cout << "  --full    Ignore the load state: read every CSV file and every row, even if already loaded" << std::endl;
+  std::cout << "  --stats   Print the slowest and most frequent SQL statements at the end of the run" << std::endl;
+  std::cout << "  --log SPEC  Log levels, e.g. 'info' or 'warn,etl=debug' (debug, info, warn, error, off; default: info)" << std::endl;
+  std::cout << "  --log-file FILE  Append log messages to FILE instead of stdout" << std::endl;
+  std::cout << std::endl;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// main
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char* argv[])
+{
+  std::string server;
+  std::string database;
+  std::string user;
+  std::string password;
+  bool delete_data = false;
+  bool bulk = false;
+  bool staging = false;
+  bool stats = false;
+  bool full = false;
+  bool partition_switch = false;
+  int purge = 0;
+  size_t jobs = 1;
+  size_t parse_jobs = 1;
+  std::string log_spec = "info";
+  std::string log_file;
+
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+  // parse command line
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+
+  for (int idx = 1; idx < argc; idx++)
+  {
+    std::string arg = argv[idx];
+    if (arg == "-h" || arg == "--help")
+    {
+      usage(argv[0]);
+      return 0;
+    }
+    else if (arg == "-S" && idx + 1 < argc)
+    {
+      server = argv[++idx];
+    }
+    else if (arg == "-d" && idx + 1 < argc)
+    {
+      database = argv[++idx];
+    }
+    else if (arg == "-U" && idx + 1 < argc)
+    {
+      user = argv[++idx];
+    }
+    else if (arg == "-P" && idx + 1 < argc)
+    {
+      password = argv[++idx];
+    }
+    else if (arg == "--delete")
+    {
+      delete_data = true;
+    }
+    else if (arg == "--bulk")
+    {
+      bulk = true;
+    }
+    else if (arg == "--staging")
+    {
+      staging = true;
+    }
+    else if (arg == "--switch")
+    {
+      bulk = true;
+      partition_switch = true;
+    }
+    else if (arg == "--purge" && idx + 1 < argc)
+    {
+      purge = atoi(argv[++idx]);
+    }
+    else if (arg == "--jobs" && idx + 1 < argc)
+    {
+      jobs = static_cast<size_t>(std::max(1, atoi(argv[++idx])));
+    }
+    else if (arg == "--parse-jobs" && idx + 1 < argc)
+    {
+      parse_jobs = static_cast<size_t>(std::max(1, atoi(argv[++idx])));
+    }
+    else if (arg == "--stats")
+    {
+      stats = true;
+    }
+    else if (arg == "--full")
+    {
+      full = true;
+    }
+    else if (arg == "--log" && idx + 1 < argc)
+    {
+      log_spec = argv[++idx];
+    }
+    else if (arg == "--log-file" && idx + 1 < argc)
+    {
+      log_file = argv[++idx];
+    }
+  }
+
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+  // validate required parameters
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+
+  if (server.empty())
+  {
+    usage(argv[0]);
+    return 1;
+  }
+
+  if (database.empty())
+  {
+    usage(argv[0]);
+    return 1;
+  }
+
+  if (bulk && staging)
+  {
+    std::cout << "Error: --bulk and --staging cannot be combined" << std::endl;
+    return 1;
+  }
+
+  if (partition_switch && jobs > 1)
+  {
+    std::cout << "Error: --switch and --jobs cannot be combined" << std::endl;
+    return 1;
+  }
+
+  if (purge != 0 && (purge / 100 < 1900 || purge % 100 < 1 || purge % 100 > 12))
+  {
+    std::cout << "Error: --purge expects a month as YYYYMM" << std::endl;
+    return 1;
+  }
+
+  if (log_configure(log_spec) < 0)
+  {
+    std::cout << "Error: invalid --log level '" << log_spec << "'" << std::endl;
+    return 1;
+  }
+
+  if (log_start(log_file) < 0)
+  {
+    std::cout << "Error: cannot open log file " << log_file << std::endl;
+    return 1;
+  }
+
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+  // display configuration
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+
+  std::cout << "ETL Configuration:" << std::endl;
+  std::cout << "  Server:   " << server << std::endl;
+  std::cout << "  Database: " << database << std::endl;
+  std::cout << "  User:     " << (user.empty() ? "(trusted connection)" : user) << std::endl;
+  std::cout << std::endl;
+
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+  // connect
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+
+  stats_enable(stats);
+  etl_t etl;
+  etl.set_incremental(!full);
+  etl.set_partition_switch(partition_switch);
+  etl.set_parse_jobs(parse_jobs);
+
+  if (etl.connect(server, database, user, password, bulk) < 0)
+  {
+    return 1;
+  }
+
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+  // handle --delete
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+
+  if (delete_data)
+  {
+    if (etl.delete_data() < 0)
+    {
+      etl.disconnect();
+      return 1;
+    }
+    etl.disconnect();
+    return 0;
+  }
+
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+  // handle --purge
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+
+  if (purge != 0)
+  {
+    if (etl.purge_month(purge) < 0)
+    {
+      etl.disconnect();
+      return 1;
+    }
+    etl.disconnect();
+    return 0;
+  }
+
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+  // create schema
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+
+  if (etl.create_schema() < 0)
+  {
+    etl.disconnect();
+    return 1;
+  }
+
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+  // load dimension keys
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+
+  if (etl.load_cache() < 0)
+  {
+    etl.disconnect();
+    return 1;
+  }
+
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+  // load date dimension
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+
+  if (etl.load_date_dimension(CALENDAR::FIRST_YEAR, CALENDAR::LAST_YEAR) < 0)
+  {
+    etl.disconnect();
+    return 1;
+  }
+
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+  // load from CSV files
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+
+  std::string companies_file = "companies.csv";
+  std::string stock_file = "stock_data.csv";
+  std::string financials_file = "financials.csv";
+
+  if (etl.load_companies_from_csv(companies_file) < 0)
+  {
+    etl.disconnect();
+    return 1;
+  }
+
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+  // fact tables, after all dimensions are loaded
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+
+  if (jobs > 1)
+  {
+    if (etl.load_facts_parallel(jobs, stock_file, financials_file, bulk, staging) < 0)
+    {
+      etl.disconnect();
+      return 1;
+    }
+  }
+  else
+  {
+    if (etl.load_stock_data_from_csv(stock_file, bulk, staging) < 0)
+    {
+      etl.disconnect();
+      return 1;
+    }
+
+    if (etl.load_financials_from_csv(financials_file, bulk, staging) < 0)
+    {
+      etl.disconnect();
+      return 1;
+    }
+  }
+
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+  // sector/day aggregates of the dates just loaded
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+
+  if (etl.refresh_sector_daily() < 0)
+  {
+    etl.disconnect();
+    return 1;
+  }
+
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+  // run analytics
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+
+  log_flush();
+  if (etl.run_analytics() < 0)
+  {
+    etl.disconnect();
+    return 1;
+  }
+
+  if (stats)
+  {
+    log_flush();
+    stats_dump(std::cout);
+  }
+
+  etl.disconnect();
+  return 0;
+}
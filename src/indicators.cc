@@ -0,0 +1,246 @@
+#include "indicators.hh"
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define INDICATORS_AVX 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define INDICATORS_SSE2 1
+#endif
+
+static const double NOT_A_NUMBER = std::numeric_limits<double>::quiet_NaN();
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//scaled_difference
+//dst[i] = (hi[i] - lo[i]) * scale; all lanes are independent
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void scaled_difference(const double* hi, const double* lo, double scale, double* dst, size_t n)
+{
+  size_t idx = 0;
+#if defined(INDICATORS_AVX)
+  __m256d s = _mm256_set1_pd(scale);
+  for (; idx + 4 <= n; idx += 4)
+  {
+    __m256d d = _mm256_sub_pd(_mm256_loadu_pd(hi + idx), _mm256_loadu_pd(lo + idx));
+    _mm256_storeu_pd(dst + idx, _mm256_mul_pd(d, s));
+  }
+#elif defined(INDICATORS_SSE2)
+  __m128d s = _mm_set1_pd(scale);
+  for (; idx + 2 <= n; idx += 2)
+  {
+    __m128d d = _mm_sub_pd(_mm_loadu_pd(hi + idx), _mm_loadu_pd(lo + idx));
+    _mm_storeu_pd(dst + idx, _mm_mul_pd(d, s));
+  }
+#endif
+  for (; idx < n; idx++)
+  {
+    dst[idx] = (hi[idx] - lo[idx]) * scale;
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//gains_losses
+//gain[i] = max(x[i+1] - x[i], 0), loss[i] = max(x[i] - x[i+1], 0), for i < n - 1
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void gains_losses(const double* x, size_t n, double* gain, double* loss)
+{
+  size_t idx = 0;
+  size_t count = n > 0 ? n - 1 : 0;
+#if defined(INDICATORS_AVX)
+  __m256d zero = _mm256_setzero_pd();
+  for (; idx + 4 <= count; idx += 4)
+  {
+    __m256d d = _mm256_sub_pd(_mm256_loadu_pd(x + idx + 1), _mm256_loadu_pd(x + idx));
+    _mm256_storeu_pd(gain + idx, _mm256_max_pd(d, zero));
+    _mm256_storeu_pd(loss + idx, _mm256_max_pd(_mm256_sub_pd(zero, d), zero));
+  }
+#elif defined(INDICATORS_SSE2)
+  __m128d zero = _mm_setzero_pd();
+  for (; idx + 2 <= count; idx += 2)
+  {
+    __m128d d = _mm_sub_pd(_mm_loadu_pd(x + idx + 1), _mm_loadu_pd(x + idx));
+    _mm_storeu_pd(gain + idx, _mm_max_pd(d, zero));
+    _mm_storeu_pd(loss + idx, _mm_max_pd(_mm_sub_pd(zero, d), zero));
+  }
+#endif
+  for (; idx < count; idx++)
+  {
+    double d = x[idx + 1] - x[idx];
+    gain[idx] = d > 0 ? d : 0;
+    loss[idx] = d < 0 ? -d : 0;
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//rsi_from_averages
+//dst[i] = 100 * gain / (gain + loss), 100 when the average loss is 0
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void rsi_from_averages(const double* gain, const double* loss, double* dst, size_t n)
+{
+  size_t idx = 0;
+#if defined(INDICATORS_AVX)
+  __m256d zero = _mm256_setzero_pd();
+  __m256d hundred = _mm256_set1_pd(100.0);
+  for (; idx + 4 <= n; idx += 4)
+  {
+    __m256d g = _mm256_loadu_pd(gain + idx);
+    __m256d l = _mm256_loadu_pd(loss + idx);
+    __m256d rsi = _mm256_div_pd(_mm256_mul_pd(hundred, g), _mm256_add_pd(g, l));
+    __m256d no_loss = _mm256_cmp_pd(l, zero, _CMP_EQ_OQ);
+    _mm256_storeu_pd(dst + idx, _mm256_blendv_pd(rsi, hundred, no_loss));
+  }
+#elif defined(INDICATORS_SSE2)
+  __m128d zero = _mm_setzero_pd();
+  __m128d hundred = _mm_set1_pd(100.0);
+  for (; idx + 2 <= n; idx += 2)
+  {
+    __m128d g = _mm_loadu_pd(gain + idx);
+    __m128d l = _mm_loadu_pd(loss + idx);
+    __m128d rsi = _mm_div_pd(_mm_mul_pd(hundred, g), _mm_add_pd(g, l));
+    __m128d no_loss = _mm_cmpeq_pd(l, zero);
+    _mm_storeu_pd(dst + idx, _mm_or_pd(_mm_and_pd(no_loss, hundred), _mm_andnot_pd(no_loss, rsi)));
+  }
+#endif
+  for (; idx < n; idx++)
+  {
+    dst[idx] = loss[idx] == 0 ? 100.0 : 100.0 * gain[idx] / (gain[idx] + loss[idx]);
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//moving_average
+//out[i] = mean of x[i - window + 1] .. x[i], from prefix sums: one subtraction per row, vectorized,
+//instead of 'window' additions per row
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void moving_average(const double* x, size_t n, size_t window, double* out)
+{
+  if (window == 0 || n < window)
+  {
+    std::fill(out, out + n, NOT_A_NUMBER);
+    return;
+  }
+  std::fill(out, out + window - 1, NOT_A_NUMBER);
+
+  std::vector<double> sum(n + 1);
+  sum[0] = 0;
+  for (size_t idx = 0; idx < n; idx++)
+  {
+    sum[idx + 1] = sum[idx] + x[idx];
+  }
+  scaled_difference(sum.data() + window, sum.data(), 1.0 / window, out + window - 1, n - window + 1);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//relative_strength_index
+//Wilder RSI: the first average gain/loss is the mean of the first 'period' changes, then
+//avg = (avg * (period - 1) + change) / period; the price changes and the final ratio are vectorized,
+//the smoothing is a recurrence and stays scalar
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void relative_strength_index(const double* x, size_t n, size_t period, double* out)
+{
+  if (period == 0 || n <= period)
+  {
+    std::fill(out, out + n, NOT_A_NUMBER);
+    return;
+  }
+  std::fill(out, out + period, NOT_A_NUMBER);
+
+  //change i is x[i + 1] - x[i]; averages are stored in place, avg[i] covers changes up to i
+  std::vector<double> gain(n - 1);
+  std::vector<double> loss(n - 1);
+  gains_losses(x, n, gain.data(), loss.data());
+
+  double avg_gain = 0;
+  double avg_loss = 0;
+  for (size_t idx = 0; idx < period; idx++)
+  {
+    avg_gain += gain[idx];
+    avg_loss += loss[idx];
+  }
+  avg_gain /= period;
+  avg_loss /= period;
+  gain[period - 1] = avg_gain;
+  loss[period - 1] = avg_loss;
+
+  for (size_t idx = period; idx < n - 1; idx++)
+  {
+    avg_gain = (avg_gain * (period - 1) + gain[idx]) / period;
+    avg_loss = (avg_loss * (period - 1) + loss[idx]) / period;
+    gain[idx] = avg_gain;
+    loss[idx] = avg_loss;
+  }
+
+  rsi_from_averages(gain.data() + period - 1, loss.data() + period - 1, out + period, n - period);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//indicator_engine_t::indicator_engine_t
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+indicator_engine_t::indicator_engine_t()
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//indicator_engine_t::add_history
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void indicator_engine_t::add_history(const std::string& ticker, double close)
+{
+  std::vector<double>& tail = m_tails[ticker];
+  tail.push_back(close);
+  if (tail.size() > INDICATORS::TAIL_ROWS)
+  {
+    tail.erase(tail.begin());
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//indicator_engine_t::compute
+//the kernels run over tail + closes; 'result' has one entry per element of 'closes'
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void indicator_engine_t::compute(const std::string& ticker, const std::vector<double>& closes,
+  std::vector<indicator_t>& result)
+{
+  std::vector<double>& tail = m_tails[ticker];
+  m_series.assign(tail.begin(), tail.end());
+  m_series.insert(m_series.end(), closes.begin(), closes.end());
+  size_t n = m_series.size();
+
+  m_ma_short.resize(n);
+  m_ma_long.resize(n);
+  m_rsi.resize(n);
+  moving_average(m_series.data(), n, INDICATORS::MA_SHORT, m_ma_short.data());
+  moving_average(m_series.data(), n, INDICATORS::MA_LONG, m_ma_long.data());
+  relative_strength_index(m_series.data(), n, INDICATORS::RSI_PERIOD, m_rsi.data());
+
+  size_t offset = tail.size();
+  result.resize(closes.size());
+  for (size_t idx = 0; idx < closes.size(); idx++)
+  {
+    result[idx].ma_short = m_ma_short[offset + idx];
+    result[idx].ma_long = m_ma_long[offset + idx];
+    result[idx].rsi = m_rsi[offset + idx];
+  }
+
+  size_t keep = std::min(n, INDICATORS::TAIL_ROWS);
+  tail.assign(m_series.end() - keep, m_series.end());
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//indicator_engine_t::nbr_tickers
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t indicator_engine_t::nbr_tickers() const
+{
+  return m_tails.size();
+}
@@ -0,0 +1,70 @@
+#ifndef INDICATORS_HH
+#define INDICATORS_HH 1
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//INDICATORS
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace INDICATORS
+{
+  //moving average windows and RSI period, in trading days (rows)
+  const size_t MA_SHORT = 50;
+  const size_t MA_LONG = 200;
+  const size_t RSI_PERIOD = 14;
+
+  //closes kept per ticker between loads; MA_LONG plus a warm-up for the RSI smoothing, whose seed
+  //weight after 250 rows is (13/14)^236, below the DECIMAL(6,2) resolution of FactDailyStock.RSI
+  const size_t TAIL_ROWS = 250;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//sliding-window kernels over a price series in date order
+//values without enough history are NaN (stored as NULL)
+//the element-wise parts use SSE2/AVX when the compiler targets them, with a scalar fallback
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void moving_average(const double* x, size_t n, size_t window, double* out);
+void relative_strength_index(const double* x, size_t n, size_t period, double* out);
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//indicator_t
+//technical indicators of one FactDailyStock row
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct indicator_t
+{
+  double ma_short; //MovingAvg50
+  double ma_long; //MovingAvg200
+  double rsi; //RSI, Wilder smoothing
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//indicator_engine_t
+//keeps the last INDICATORS::TAIL_ROWS closes of each ticker, so the indicators of new rows are computed
+//from the tail and the new closes only
+//  add_history - seeds a ticker with closes already in FactDailyStock, in date order
+//  compute     - indicators of new closes (in date order, after the tail), then appends them to the tail
+//one engine is used by one thread
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class indicator_engine_t
+{
+public:
+  indicator_engine_t();
+  void add_history(const std::string& ticker, double close);
+  void compute(const std::string& ticker, const std::vector<double>& closes, std::vector<indicator_t>& result);
+  size_t nbr_tickers() const;
+
+private:
+  std::unordered_map<std::string, std::vector<double>> m_tails;
+  std::vector<double> m_series;
+  std::vector<double> m_ma_short;
+  std::vector<double> m_ma_long;
+  std::vector<double> m_rsi;
+};
+
+#endif
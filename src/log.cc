@@ -0,0 +1,469 @@
+#include "log.hh"
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <cstdint>
+#include <algorithm>
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//log_slot_t
+//one message in the ring; 'seq' is the slot sequence number of the bounded multi-producer queue:
+//seq == pos means free for the producer of position 'pos', seq == pos + 1 means written and ready for
+//the log thread, which then sets it to pos + RING_SIZE for the next lap
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct log_slot_t
+{
+  std::atomic<size_t> seq;
+  log_level_t level;
+  const char* component;
+  long long time_us; //wall clock, microseconds since the epoch
+  size_t len;
+  char text[LOG::MESSAGE_SIZE];
+};
+
+static const char* const LEVEL_NAME[] = { "DEBUG", "INFO ", "WARN ", "ERROR", "OFF  " };
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//levels, set by log_configure at startup and read by all threads
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::atomic<int> log_min_level(LOG_LEVEL_INFO);
+static int log_default_level = LOG_LEVEL_INFO;
+static std::vector<std::pair<std::string, int>> log_components;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//ring buffer and log thread
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static log_slot_t log_ring[LOG::RING_SIZE];
+static std::atomic<size_t> log_enqueue_pos(0);
+static std::atomic<size_t> log_dequeue_pos(0);
+static std::atomic<bool> log_running(false);
+
+//producers between their log_running check and the publication of their message; log_stop waits for
+//them before stopping the log thread, so no message is left in the ring after it exits
+static std::atomic<int> log_producers(0);
+
+//set by the log thread when it exits; a producer waiting on a full ring then writes synchronously
+static std::atomic<bool> log_writer_done(false);
+
+static std::thread log_thread;
+static std::mutex log_mutex;
+static std::condition_variable log_cond;
+static std::condition_variable log_flush_cond;
+static bool log_wake = false;
+static bool log_stopping = false;
+static FILE* log_file = nullptr;
+
+//synchronous writes, before log_start and after log_stop
+static std::mutex log_sync_mutex;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//wall_us
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static long long wall_us()
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//format_line
+//appends 'YYYY-MM-DD HH:MM:SS.mmm LEVEL component text' and a newline to 'line'
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void format_line(std::string& line, long long time_us, log_level_t level, const char* component,
+  const char* text, size_t len)
+{
+  time_t seconds = static_cast<time_t>(time_us / 1000000);
+  struct tm tm;
+#if defined(_WIN32)
+  localtime_s(&tm, &seconds);
+#else
+  localtime_r(&seconds, &tm);
+#endif
+  char buf[64];
+  size_t n = strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tm);
+  snprintf(buf + n, sizeof(buf) - n, ".%03d %s ", static_cast<int>(time_us / 1000 % 1000), LEVEL_NAME[level]);
+  line += buf;
+  line += component;
+  line += ' ';
+  line.append(text, len);
+  line += '\n';
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//copy_text
+//copies at most LOG::MESSAGE_SIZE bytes of 'text' to 'buf'; a longer text ends with '...'
+//returns the number of bytes copied
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static size_t copy_text(char* buf, const std::string& text)
+{
+  if (text.size() <= LOG::MESSAGE_SIZE)
+  {
+    memcpy(buf, text.data(), text.size());
+    return text.size();
+  }
+  memcpy(buf, text.data(), LOG::MESSAGE_SIZE - 3);
+  memcpy(buf + LOG::MESSAGE_SIZE - 3, "...", 3);
+  return LOG::MESSAGE_SIZE;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//write_sync
+//writes one message to stdout from the calling thread, without the ring
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void write_sync(long long time_us, log_level_t level, const char* component, const std::string& text)
+{
+  char buf[LOG::MESSAGE_SIZE];
+  size_t len = copy_text(buf, text);
+  std::string line;
+  format_line(line, time_us, level, component, buf, len);
+  std::lock_guard<std::mutex> lock(log_sync_mutex);
+  fwrite(line.data(), 1, line.size(), stdout);
+  fflush(stdout);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//wake_writer
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void wake_writer()
+{
+  {
+    std::lock_guard<std::mutex> lock(log_mutex);
+    log_wake = true;
+  }
+  log_cond.notify_one();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//drain
+//log thread: formats the ready messages into one buffer and writes it with one fwrite; stops at the
+//first slot not yet written, a producer may still be copying into it
+//returns the number of messages written
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static size_t drain(std::string& line)
+{
+  size_t pos = log_dequeue_pos.load(std::memory_order_relaxed);
+  size_t start = pos;
+  line.clear();
+  while (true)
+  {
+    log_slot_t& slot = log_ring[pos & (LOG::RING_SIZE - 1)];
+    if (slot.seq.load(std::memory_order_acquire) != pos + 1)
+    {
+      break;
+    }
+    format_line(line, slot.time_us, slot.level, slot.component, slot.text, slot.len);
+    slot.seq.store(pos + LOG::RING_SIZE, std::memory_order_release);
+    pos++;
+  }
+  if (pos != start)
+  {
+    fwrite(line.data(), 1, line.size(), log_file);
+    fflush(log_file);
+    log_dequeue_pos.store(pos, std::memory_order_release);
+  }
+  return pos - start;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//writer
+//log thread: wakes every FLUSH_MS, or earlier when a producer finds the ring a quarter full; when
+//stopping, it exits once every claimed slot is written (dequeue position equal to enqueue position)
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void writer()
+{
+  std::string line;
+  std::unique_lock<std::mutex> lock(log_mutex);
+  while (true)
+  {
+    log_cond.wait_for(lock, std::chrono::milliseconds(LOG::FLUSH_MS), [] { return log_wake || log_stopping; });
+    log_wake = false;
+    bool stopping = log_stopping;
+    lock.unlock();
+    size_t count = drain(line);
+    lock.lock();
+    log_flush_cond.notify_all();
+    if (stopping && log_dequeue_pos.load(std::memory_order_acquire) == log_enqueue_pos.load(std::memory_order_acquire))
+    {
+      log_writer_done.store(true);
+      break;
+    }
+    if (stopping && count == 0)
+    {
+      //a slot is claimed but its message is still being copied
+      lock.unlock();
+      std::this_thread::yield();
+      lock.lock();
+    }
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//parse_level
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static int parse_level(const std::string& name)
+{
+  if (name == "debug") return LOG_LEVEL_DEBUG;
+  if (name == "info") return LOG_LEVEL_INFO;
+  if (name == "warn") return LOG_LEVEL_WARN;
+  if (name == "error") return LOG_LEVEL_ERROR;
+  if (name == "off") return LOG_LEVEL_OFF;
+  return -1;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//log_configure
+//'info', 'warn,odbc=debug', 'etl=debug' (default level unchanged)
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int log_configure(const std::string& spec)
+{
+  int default_level = log_default_level;
+  std::vector<std::pair<std::string, int>> components;
+
+  size_t start = 0;
+  while (start <= spec.size())
+  {
+    size_t end = spec.find(',', start);
+    if (end == std::string::npos)
+    {
+      end = spec.size();
+    }
+    std::string token = spec.substr(start, end - start);
+    start = end + 1;
+    if (token.empty())
+    {
+      continue;
+    }
+
+    size_t eq = token.find('=');
+    if (eq == std::string::npos)
+    {
+      default_level = parse_level(token);
+      if (default_level < 0)
+      {
+        return -1;
+      }
+    }
+    else
+    {
+      int level = parse_level(token.substr(eq + 1));
+      if (eq == 0 || level < 0)
+      {
+        return -1;
+      }
+      components.push_back(std::make_pair(token.substr(0, eq), level));
+    }
+  }
+
+  int min_level = default_level;
+  for (size_t idx = 0; idx < components.size(); idx++)
+  {
+    min_level = std::min(min_level, components[idx].second);
+  }
+  log_default_level = default_level;
+  log_components = components;
+  log_min_level.store(min_level, std::memory_order_relaxed);
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//log_enabled
+//a component without its own level uses the default level; the last 'component=level' wins
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool log_enabled(log_level_t level, const char* component)
+{
+  int min_level = log_default_level;
+  for (size_t idx = 0; idx < log_components.size(); idx++)
+  {
+    if (log_components[idx].first == component)
+    {
+      min_level = log_components[idx].second;
+    }
+  }
+  return level >= min_level && level < LOG_LEVEL_OFF;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//log_start
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int log_start(const std::string& filename)
+{
+  if (log_running.load())
+  {
+    return -1;
+  }
+  FILE* file = stdout;
+  if (!filename.empty())
+  {
+    file = fopen(filename.c_str(), "a");
+    if (!file)
+    {
+      return -1;
+    }
+  }
+
+  for (size_t idx = 0; idx < LOG::RING_SIZE; idx++)
+  {
+    log_ring[idx].seq.store(idx, std::memory_order_relaxed);
+  }
+  log_enqueue_pos.store(0, std::memory_order_relaxed);
+  log_dequeue_pos.store(0, std::memory_order_relaxed);
+  log_file = file;
+  log_wake = false;
+  log_stopping = false;
+  log_writer_done.store(false);
+  log_thread = std::thread(writer);
+  log_running.store(true, std::memory_order_release);
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//log_write
+//claims the next slot with one compare-and-swap and copies the message; no lock, no allocation
+//if the ring is full the producer yields until the log thread frees a slot, messages are not dropped
+//while the logger is not running (or is stopping) the message is written synchronously
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void log_write(log_level_t level, const char* component, const std::string& text)
+{
+  long long time_us = wall_us();
+
+  log_producers.fetch_add(1);
+  if (!log_running.load())
+  {
+    log_producers.fetch_sub(1);
+    write_sync(time_us, level, component, text);
+    return;
+  }
+
+  size_t pos = log_enqueue_pos.load(std::memory_order_relaxed);
+  log_slot_t* slot = nullptr;
+  while (true)
+  {
+    slot = &log_ring[pos & (LOG::RING_SIZE - 1)];
+    intptr_t diff = static_cast<intptr_t>(slot->seq.load(std::memory_order_acquire)) - static_cast<intptr_t>(pos);
+    if (diff == 0)
+    {
+      if (log_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+      {
+        break;
+      }
+    }
+    else if (diff < 0)
+    {
+      //full: the slot still holds the message of the previous lap; nothing frees it once the log
+      //thread is gone
+      if (log_writer_done.load())
+      {
+        log_producers.fetch_sub(1);
+        write_sync(time_us, level, component, text);
+        return;
+      }
+      wake_writer();
+      std::this_thread::yield();
+      pos = log_enqueue_pos.load(std::memory_order_relaxed);
+    }
+    else
+    {
+      pos = log_enqueue_pos.load(std::memory_order_relaxed);
+    }
+  }
+
+  slot->level = level;
+  slot->component = component;
+  slot->time_us = time_us;
+  slot->len = copy_text(slot->text, text);
+  slot->seq.store(pos + 1, std::memory_order_release);
+
+  if (pos - log_dequeue_pos.load(std::memory_order_relaxed) == LOG::RING_SIZE / 4)
+  {
+    wake_writer();
+  }
+  log_producers.fetch_sub(1, std::memory_order_release);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//log_flush
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void log_flush()
+{
+  if (!log_running.load(std::memory_order_acquire))
+  {
+    return;
+  }
+  size_t target = log_enqueue_pos.load(std::memory_order_acquire);
+  std::unique_lock<std::mutex> lock(log_mutex);
+  log_wake = true;
+  log_cond.notify_one();
+  while (log_dequeue_pos.load(std::memory_order_acquire) < target && !log_stopping)
+  {
+    log_flush_cond.wait_for(lock, std::chrono::milliseconds(LOG::FLUSH_MS));
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//log_stop
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void log_stop()
+{
+  if (!log_running.load())
+  {
+    return;
+  }
+  //new messages are written synchronously; a producer that found the logger running publishes its
+  //message first (the log thread is still draining), then the log thread drains the ring and exits
+  log_running.store(false);
+  while (log_producers.load() != 0)
+  {
+    std::this_thread::yield();
+  }
+  {
+    std::lock_guard<std::mutex> lock(log_mutex);
+    log_stopping = true;
+  }
+  log_cond.notify_one();
+  if (log_thread.joinable())
+  {
+    log_thread.join();
+  }
+  if (log_file && log_file != stdout)
+  {
+    fclose(log_file);
+  }
+  log_file = nullptr;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//log_guard_t
+//stops the log thread at exit, so messages logged just before main returns are written
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct log_guard_t
+{
+  ~log_guard_t()
+  {
+    log_stop();
+  }
+};
+
+static log_guard_t log_guard;
@@ -0,0 +1,85 @@
+#ifndef LOG_HH
+#define LOG_HH 1
+
+#include <string>
+#include <sstream>
+#include <atomic>
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//LOG
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace LOG
+{
+  //messages the ring buffer holds (power of 2); a writer that finds it full waits for the log thread
+  const size_t RING_SIZE = 4096;
+
+  //bytes of text kept per message, longer text is truncated and ends with '...'
+  const size_t MESSAGE_SIZE = 480;
+
+  //the log thread writes at least this often; it is woken earlier when the ring is a quarter full
+  const int FLUSH_MS = 100;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//log_level_t
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+enum log_level_t
+{
+  LOG_LEVEL_DEBUG = 0,
+  LOG_LEVEL_INFO = 1,
+  LOG_LEVEL_WARN = 2,
+  LOG_LEVEL_ERROR = 3,
+  LOG_LEVEL_OFF = 4
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//global functions
+//the logger is shared by all threads of the process
+//  log_configure - levels from a spec, 'info' or 'warn,odbc=debug,etl=info'; the first form sets the
+//                  default level, 'component=level' overrides it for one component; call it at startup,
+//                  before other threads log
+//  log_start     - starts the log thread, writing to 'filename' (appended) or stdout if empty; before
+//                  log_start and after log_stop messages are written synchronously to stdout
+//  log_write     - copies one message into the lock-free ring buffer (multi-producer), called by the
+//                  LOG_* macros after the level check
+//  log_flush     - waits until every message logged so far is written, e.g. before printing a report
+//                  to stdout directly
+//  log_stop      - writes the remaining messages and stops the log thread; also called at exit
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int log_configure(const std::string& spec);
+int log_start(const std::string& filename = std::string());
+void log_write(log_level_t level, const char* component, const std::string& text);
+void log_flush();
+void log_stop();
+bool log_enabled(log_level_t level, const char* component);
+
+//lowest level enabled for any component; a message below it costs one relaxed load and a compare
+extern std::atomic<int> log_min_level;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//LOG_DEBUG, LOG_INFO, LOG_WARN, LOG_ERROR
+//LOG_INFO("etl", "Loaded " << count << " rows"); 'component' is a string literal
+//the stream expression is evaluated only if the level is enabled for the component, so a disabled
+//debug statement in a hot loop formats nothing
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#define LOG_AT(level, component, expr) \
+  do \
+  { \
+    if ((level) >= log_min_level.load(std::memory_order_relaxed) && log_enabled((level), (component))) \
+    { \
+      std::ostringstream log_ss; \
+      log_ss << expr; \
+      log_write((level), (component), log_ss.str()); \
+    } \
+  } while (0)
+
+#define LOG_DEBUG(component, expr) LOG_AT(LOG_LEVEL_DEBUG, component, expr)
+#define LOG_INFO(component, expr) LOG_AT(LOG_LEVEL_INFO, component, expr)
+#define LOG_WARN(component, expr) LOG_AT(LOG_LEVEL_WARN, component, expr)
+#define LOG_ERROR(component, expr) LOG_AT(LOG_LEVEL_ERROR, component, expr)
+
+#endif
@@ -1,6 +1,10 @@
 #include "odbc.hh"
+#include "log.hh"
 #include <sstream>
-#include <iostream>
+#include <cstring>
+#include <algorithm>
+#include <thread>
+#include <chrono>
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////
 //make_conn
@@ -54,7 +58,7 @@ std::string make_conn(const std::string& server, const std::string& database, st
   conn += "TrustServerCertificate=yes;";
 #endif
 
-  std::cout << conn << std::endl;
+  LOG_DEBUG("odbc", conn);
   return conn;
 }
 
@@ -65,7 +69,10 @@ std::string make_conn(const std::string& server, const std::string& database, st
 
 odbc_t::odbc_t() :
   m_henv(0),
-  m_hdbc(0)
+  m_hdbc(0),
+  m_row_array_size(1),
+  m_stmt_clock(0),
+  m_timing()
 {
   if (!SQL_SUCCEEDED(SQLAllocHandle(SQL_HANDLE_ENV, SQL_NULL_HANDLE, &m_henv)))
   {
@@ -84,9 +91,11 @@ odbc_t::~odbc_t()
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////
 //odbc::connect
+//'bulk_copy' enables the msodbcsql bulk copy extensions (SQL_COPT_SS_BCP) on the connection,
+//must be set before SQLDriverConnect; see bcp_t
 /////////////////////////////////////////////////////////////////////////////////////////////////////
 
-int odbc_t::connect(const std::string& conn)
+int odbc_t::connect(const std::string& conn, bool bulk_copy)
 {
   SQLCHAR outstr[1024];
   SQLSMALLINT outstrlen;
@@ -102,6 +111,24 @@ int odbc_t::connect(const std::string& conn)
     return -1;
   }
 
+  if (bulk_copy)
+  {
+#ifdef HAVE_MSODBCSQL
+    if (!SQL_SUCCEEDED(SQLSetConnectAttr(m_hdbc, SQL_COPT_SS_BCP, (SQLPOINTER)SQL_BCP_ON, SQL_IS_INTEGER)))
+    {
+      extract_error(m_hdbc, SQL_HANDLE_DBC);
+      SQLFreeHandle(SQL_HANDLE_DBC, m_hdbc);
+      m_hdbc = 0;
+      return -1;
+    }
+#else
+    LOG_ERROR("odbc", "Bulk copy requires the msodbcsql driver SDK (HAVE_MSODBCSQL)");
+    SQLFreeHandle(SQL_HANDLE_DBC, m_hdbc);
+    m_hdbc = 0;
+    return -1;
+#endif
+  }
+
   switch (SQLDriverConnect(
     m_hdbc,
     NULL,
@@ -139,6 +166,7 @@ int odbc_t::connect(const std::string& conn)
 
 int odbc_t::disconnect()
 {
+  free_statements();
   SQLDisconnect(m_hdbc);
   SQLFreeHandle(SQL_HANDLE_DBC, m_hdbc);
   return 0;
@@ -174,7 +202,7 @@ int odbc_t::get_version()
   }
   SQLFreeHandle(SQL_HANDLE_STMT, hstmt);
 
-  std::cout << reinterpret_cast<char*>(str) << std::endl;
+  LOG_INFO("odbc", reinterpret_cast<char*>(str));
 
   return 0;
 }
@@ -231,6 +259,31 @@ int odbc_t::rollback_transaction()
   return 0;
 }
 
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//odbc::set_row_array_size
+//number of rows that each SQLFetch call in fetch() returns (SQL_ATTR_ROW_ARRAY_SIZE)
+//1 keeps the single-row loop; large scans use a block cursor, for example ODBC::ROW_ARRAY_SIZE rows
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int odbc_t::set_row_array_size(size_t row_array_size)
+{
+  if (row_array_size == 0)
+  {
+    return -1;
+  }
+  m_row_array_size = row_array_size;
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//odbc::get_row_array_size
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t odbc_t::get_row_array_size() const
+{
+  return m_row_array_size;
+}
+
 /////////////////////////////////////////////////////////////////////////////////////////////////////
 //odbc::exec_direct
 //return values from SQLExecDirect
@@ -262,23 +315,36 @@ int odbc_t::exec_direct(const std::string& sql)
   {
   }
 
+  long long start = now_us();
   SQLRETURN rc = SQLExecDirect(hstmt, sqlstr, SQL_NTS);
+  m_timing.execute_us = now_us() - start;
   if (rc == SQL_SUCCESS || rc == SQL_SUCCESS_WITH_INFO || rc == SQL_NO_DATA)
   {
+    SQLLEN nbr_rows = 0;
+    if (rc != SQL_NO_DATA && SQL_SUCCEEDED(SQLRowCount(hstmt, &nbr_rows)) && nbr_rows > 0)
+    {
+      m_timing.rows = nbr_rows;
+    }
   }
   else
   {
     extract_error(hstmt, SQL_HANDLE_STMT);
     SQLFreeHandle(SQL_HANDLE_STMT, hstmt);
+    record(sql, true);
     return -1;
   }
 
   SQLFreeHandle(SQL_HANDLE_STMT, hstmt);
+  record(sql, false);
   return 0;
 }
 
+//SQLSTATE of the first diagnostic record read by extract_error on this thread, see get_sql_state
+static thread_local std::string last_sql_state;
+
 /////////////////////////////////////////////////////////////////////////////////////////////////////
 //extract_error
+//logs the diagnostic records of 'handle'; the SQLSTATE of the first is kept for get_sql_state
 /////////////////////////////////////////////////////////////////////////////////////////////////////
 
 void extract_error(SQLHANDLE handle, SQLSMALLINT type)
@@ -302,38 +368,182 @@ void extract_error(SQLHANDLE handle, SQLSMALLINT type)
       &str_len);
     if (SQL_SUCCEEDED(rc))
     {
-      std::stringstream ss;
-      ss << idx << ":" << sql_state << ":" << native_error << ":" << str;
-
-      std::cerr << ss.str() << std::endl;
+      if (idx == 1)
+      {
+        last_sql_state = reinterpret_cast<const char*>(sql_state);
+      }
+      LOG_ERROR("odbc", idx << ":" << sql_state << ":" << native_error << ":" << str);
     }
   } while (rc == SQL_SUCCESS);
 }
 
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//get_sql_state
+//SQLSTATE of the last error reported on the calling thread (e.g. '08S01' communication link failure,
+//'23000' constraint violation), empty if none since reset_sql_state
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::string get_sql_state()
+{
+  return last_sql_state;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//reset_sql_state
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void reset_sql_state()
+{
+  last_sql_state.clear();
+}
+
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////
 //odbc::fetch
+//executes 'sql' and reads the result set into 'table'
 /////////////////////////////////////////////////////////////////////////////////////////////////////
 
 int odbc_t::fetch(const std::string& sql, table_t& table)
 {
-  table.remove();
   SQLHSTMT hstmt;
-  SQLSMALLINT nbr_cols;
   SQLCHAR* sqlstr = (SQLCHAR*)sql.c_str();
-  struct bind_column_data_t* bind_data = NULL;
 
   if (!SQL_SUCCEEDED(SQLAllocHandle(SQL_HANDLE_STMT, m_hdbc, &hstmt)))
   {
-
+    extract_error(m_hdbc, SQL_HANDLE_DBC);
+    return -1;
   }
 
-  if (!SQL_SUCCEEDED(SQLExecDirect(hstmt, sqlstr, SQL_NTS)))
+  long long start = now_us();
+  SQLRETURN ret = SQLExecDirect(hstmt, sqlstr, SQL_NTS);
+  m_timing.execute_us = now_us() - start;
+  if (!SQL_SUCCEEDED(ret))
   {
     extract_error(hstmt, SQL_HANDLE_STMT);
+    SQLFreeHandle(SQL_HANDLE_STMT, hstmt);
+    record(sql, true);
     return -1;
   }
 
+  start = now_us();
+  int rc = fetch_result(hstmt, table);
+  m_timing.fetch_us = now_us() - start;
+  SQLFreeHandle(SQL_HANDLE_STMT, hstmt);
+  record(sql, rc < 0);
+  return rc;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//char_buffer_len
+//bytes needed to fetch column 'col' as SQL_C_CHAR, including the null termination byte, from the
+//SQL_DESC_DISPLAY_SIZE of the column: characters for text, 2 per byte for binary, digits with sign and
+//decimal point for numbers, 19 or more for datetime; wide characters take up to 4 bytes in UTF-8
+//returns 0 for a long or unbounded column (VARCHAR(MAX), TEXT, XML) or one above ODBC::MAX_BIND_SIZE
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static SQLLEN char_buffer_len(SQLHSTMT hstmt, SQLUSMALLINT col, SQLSMALLINT sqltype, SQLULEN sqlsize)
+{
+  switch (sqltype)
+  {
+  case SQL_LONGVARCHAR:
+  case SQL_WLONGVARCHAR:
+  case SQL_LONGVARBINARY:
+    return 0;
+  default:
+    break;
+  }
+
+  SQLLEN display_size = 0;
+  if (!SQL_SUCCEEDED(SQLColAttribute(hstmt, col, SQL_DESC_DISPLAY_SIZE, NULL, 0, NULL, &display_size)) || display_size <= 0)
+  {
+    display_size = static_cast<SQLLEN>(sqlsize);
+  }
+  if (sqltype == SQL_WCHAR || sqltype == SQL_WVARCHAR)
+  {
+    display_size *= 4;
+  }
+  if (display_size <= 0 || display_size + 1 > ODBC::MAX_BIND_SIZE)
+  {
+    return 0;
+  }
+  return display_size + 1;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//get_long_data
+//reads column 'col' of the current row as SQL_C_CHAR with SQLGetData, ODBC::GET_DATA_CHUNK bytes per call
+//'ind' is SQL_NULL_DATA for NULL, the length of 'str' otherwise
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static int get_long_data(SQLHSTMT hstmt, SQLUSMALLINT col, std::string& str, SQLLEN& ind)
+{
+  char buf[ODBC::GET_DATA_CHUNK];
+  str.clear();
+  ind = 0;
+
+  while (true)
+  {
+    SQLLEN len = 0;
+    SQLRETURN rc = SQLGetData(hstmt, col, SQL_C_CHAR, buf, sizeof(buf), &len);
+    if (rc == SQL_NO_DATA)
+    {
+      break;
+    }
+    if (!SQL_SUCCEEDED(rc))
+    {
+      extract_error(hstmt, SQL_HANDLE_STMT);
+      return -1;
+    }
+    if (len == SQL_NULL_DATA)
+    {
+      ind = SQL_NULL_DATA;
+      return 0;
+    }
+
+    //SQL_SUCCESS_WITH_INFO (01004) means the chunk was truncated and more data follows,
+    //'len' is the remaining length or SQL_NO_TOTAL
+    if (len == SQL_NO_TOTAL || len >= (SQLLEN)sizeof(buf))
+    {
+      if (str.empty() && len != SQL_NO_TOTAL)
+      {
+        str.reserve(len);
+      }
+      str.append(buf, sizeof(buf) - 1);
+    }
+    else
+    {
+      str.append(buf, len);
+    }
+
+    if (rc == SQL_SUCCESS)
+    {
+      break;
+    }
+  }
+  ind = static_cast<SQLLEN>(str.size());
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//odbc::fetch_result
+//reads the result set of an executed statement into 'table', shared by direct and prepared execution
+//with a row array size > 1 the statement uses a block cursor: columns are bound column-wise
+//(SQL_BIND_BY_COLUMN) to arrays of m_row_array_size elements and each SQLFetch returns up to that
+//many rows, the count is written to SQL_ATTR_ROWS_FETCHED_PTR
+//each buffer is sized from the column metadata; a long column is not bound and is read with SQLGetData,
+//and so are the columns after it (SQLGetData only reads unbound columns in increasing order), with one
+//row per SQLFetch
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int odbc_t::fetch_result(SQLHSTMT hstmt, table_t& table)
+{
+  table.remove();
+  SQLSMALLINT nbr_cols;
+  struct bind_column_data_t* bind_data = NULL;
+  SQLULEN row_array_size = m_row_array_size;
+  SQLULEN nbr_fetched = 0;
+  SQLUSMALLINT* row_status = NULL;
+
   if (!SQL_SUCCEEDED(SQLNumResultCols(hstmt, &nbr_cols)))
   {
 
@@ -343,7 +553,10 @@ int odbc_t::fetch(const std::string& sql, table_t& table)
   for (SQLUSMALLINT idx = 0; idx < nbr_cols; idx++)
   {
     bind_data[idx].target_value_ptr = NULL;
+    bind_data[idx].strlen_or_ind = NULL;
+    bind_data[idx].bound = true;
   }
+  SQLUSMALLINT first_unbound = nbr_cols;
 
   /////////////////////////////////////////////////////////////////////////////////////////////////////
   //get column names
@@ -376,13 +589,56 @@ int odbc_t::fetch(const std::string& sql, table_t& table)
     col.name = (char*)buf;
     col.sqltype = sqltype;
     table.cols.push_back(col);
+
+    bind_data[idx].target_type = SQL_C_CHAR;
+    bind_data[idx].buf_len = char_buffer_len(hstmt, idx + 1, sqltype, sqlsize);
+    if (bind_data[idx].buf_len == 0 && first_unbound == nbr_cols)
+    {
+      first_unbound = idx;
+    }
+  }
+
+  for (SQLUSMALLINT idx = first_unbound; idx < nbr_cols; idx++)
+  {
+    bind_data[idx].bound = false;
+  }
+  if (first_unbound < nbr_cols)
+  {
+    row_array_size = 1;
+  }
+
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+  //block cursor
+  //column-wise binding, SQL_ATTR_ROW_ARRAY_SIZE rows per fetch, number of rows fetched and
+  //status of each row are returned in nbr_fetched and row_status
+  //the driver may lower the row array size (SQL_SUCCESS_WITH_INFO), in that case read it back
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+
+  if (row_array_size > 1)
+  {
+    if (!SQL_SUCCEEDED(SQLSetStmtAttr(hstmt, SQL_ATTR_ROW_BIND_TYPE, (SQLPOINTER)SQL_BIND_BY_COLUMN, 0)) ||
+      !SQL_SUCCEEDED(SQLSetStmtAttr(hstmt, SQL_ATTR_ROW_ARRAY_SIZE, (SQLPOINTER)row_array_size, 0)))
+    {
+      extract_error(hstmt, SQL_HANDLE_STMT);
+      row_array_size = 1;
+    }
+    else if (!SQL_SUCCEEDED(SQLGetStmtAttr(hstmt, SQL_ATTR_ROW_ARRAY_SIZE, &row_array_size, 0, NULL)) || row_array_size == 0)
+    {
+      row_array_size = 1;
+    }
   }
 
+  row_status = (SQLUSMALLINT*)malloc(row_array_size * sizeof(SQLUSMALLINT));
+  SQLSetStmtAttr(hstmt, SQL_ATTR_ROW_STATUS_PTR, row_status, 0);
+  SQLSetStmtAttr(hstmt, SQL_ATTR_ROWS_FETCHED_PTR, &nbr_fetched, 0);
+
   for (SQLUSMALLINT idx = 0; idx < nbr_cols; idx++)
   {
-    bind_data[idx].target_type = SQL_C_CHAR;
-    bind_data[idx].buf_len = (1024 + 1);
-    bind_data[idx].target_value_ptr = malloc(sizeof(unsigned char) * bind_data[idx].buf_len);
+    if (bind_data[idx].bound)
+    {
+      bind_data[idx].target_value_ptr = malloc(sizeof(unsigned char) * bind_data[idx].buf_len * row_array_size);
+    }
+    bind_data[idx].strlen_or_ind = (SQLLEN*)malloc(sizeof(SQLLEN) * row_array_size);
   }
 
   /////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -394,7 +650,7 @@ int odbc_t::fetch(const std::string& sql, table_t& table)
   //returned by the fetch operation data type conversion
   /////////////////////////////////////////////////////////////////////////////////////////////////////
 
-  for (SQLUSMALLINT idx = 0; idx < nbr_cols; idx++)
+  for (SQLUSMALLINT idx = 0; idx < first_unbound; idx++)
   {
     if (!SQL_SUCCEEDED(SQLBindCol(
       hstmt,
@@ -402,7 +658,7 @@ int odbc_t::fetch(const std::string& sql, table_t& table)
       bind_data[idx].target_type,
       bind_data[idx].target_value_ptr,
       bind_data[idx].buf_len,
-      &(bind_data[idx].strlen_or_ind))))
+      bind_data[idx].strlen_or_ind)))
     {
       extract_error(hstmt, SQL_HANDLE_STMT);
     }
@@ -411,23 +667,39 @@ int odbc_t::fetch(const std::string& sql, table_t& table)
   size_t nbr_rows = 0;
   while (SQL_SUCCEEDED(SQLFetch(hstmt)))
   {
-    row_t row;
-    for (int idx_col = 0; idx_col < nbr_cols; idx_col++)
+    for (SQLULEN idx_row = 0; idx_row < nbr_fetched; idx_row++)
     {
-      std::string str;
-      if (bind_data[idx_col].strlen_or_ind != SQL_NULL_DATA)
+      if (row_status[idx_row] == SQL_ROW_ERROR || row_status[idx_row] == SQL_ROW_NOROW)
       {
-        str = (char*)bind_data[idx_col].target_value_ptr;
+        continue;
       }
-      else
+
+      row_t row;
+      row.col.reserve(nbr_cols);
+      for (int idx_col = 0; idx_col < nbr_cols; idx_col++)
       {
-        str = ODBC::SQL_NULL;
+        if (!bind_data[idx_col].bound)
+        {
+          std::string str;
+          SQLLEN ind = 0;
+          get_long_data(hstmt, idx_col + 1, str, ind);
+          row.col.push_back(ind == SQL_NULL_DATA ? ODBC::SQL_NULL : std::move(str));
+        }
+        else if (bind_data[idx_col].strlen_or_ind[idx_row] != SQL_NULL_DATA)
+        {
+          char* value = (char*)bind_data[idx_col].target_value_ptr + idx_row * bind_data[idx_col].buf_len;
+          row.col.push_back(value);
+        }
+        else
+        {
+          row.col.push_back(ODBC::SQL_NULL);
+        }
       }
-      row.col.push_back(str);
+      table.rows.push_back(std::move(row));
+      nbr_rows++;
     }
-    table.rows.push_back(row);
-    nbr_rows++;
   }
+  m_timing.rows += nbr_rows;
 
   for (SQLUSMALLINT idx_col = 0; idx_col < nbr_cols; idx_col++)
   {
@@ -435,12 +707,22 @@ int odbc_t::fetch(const std::string& sql, table_t& table)
     {
       free(bind_data[idx_col].target_value_ptr);
     }
+    if (bind_data[idx_col].strlen_or_ind != NULL)
+    {
+      free(bind_data[idx_col].strlen_or_ind);
+    }
   }
   if (bind_data != NULL)
   {
     free(bind_data);
   }
-  SQLFreeHandle(SQL_HANDLE_STMT, hstmt);
+  free(row_status);
+
+  //buffers are freed, restore the statement attributes so a cached prepared statement can be reused
+  SQLFreeStmt(hstmt, SQL_UNBIND);
+  SQLSetStmtAttr(hstmt, SQL_ATTR_ROW_STATUS_PTR, NULL, 0);
+  SQLSetStmtAttr(hstmt, SQL_ATTR_ROWS_FETCHED_PTR, NULL, 0);
+  SQLSetStmtAttr(hstmt, SQL_ATTR_ROW_ARRAY_SIZE, (SQLPOINTER)1, 0);
   return 0;
 }
 
@@ -478,3 +760,1354 @@ std::string table_t::get_row_col_value(int row, const std::string& col_name)
 
 
 
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//odbc::fetch
+//typed columnar result set; each column is bound with the C type of its SQL type and the block cursor
+//rows are appended to contiguous per-column vectors, no per-cell strings and no text to number parsing
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int odbc_t::fetch(const std::string& sql, typed_table_t& table)
+{
+  SQLHSTMT hstmt;
+  SQLCHAR* sqlstr = (SQLCHAR*)sql.c_str();
+
+  if (!SQL_SUCCEEDED(SQLAllocHandle(SQL_HANDLE_STMT, m_hdbc, &hstmt)))
+  {
+    extract_error(m_hdbc, SQL_HANDLE_DBC);
+    return -1;
+  }
+
+  long long start = now_us();
+  SQLRETURN ret = SQLExecDirect(hstmt, sqlstr, SQL_NTS);
+  m_timing.execute_us = now_us() - start;
+  if (!SQL_SUCCEEDED(ret))
+  {
+    extract_error(hstmt, SQL_HANDLE_STMT);
+    SQLFreeHandle(SQL_HANDLE_STMT, hstmt);
+    record(sql, true);
+    return -1;
+  }
+
+  start = now_us();
+  int rc = fetch_result(hstmt, table);
+  m_timing.fetch_us = now_us() - start;
+  SQLFreeHandle(SQL_HANDLE_STMT, hstmt);
+  record(sql, rc < 0);
+  return rc;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//odbc::fetch_result
+//reads the result set of an executed statement into the typed columnar 'table'
+//with a 'visitor' the table holds one block at a time: the visitor is called after each SQLFetch
+//and the rows are cleared, memory is bounded by the row array size
+//numbers are bound with their C type, character buffers are sized as in fetch_result(table_t)
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int odbc_t::fetch_result(SQLHSTMT hstmt, typed_table_t& table, const batch_visitor_t* visitor)
+{
+  table.remove();
+  SQLSMALLINT nbr_cols;
+  struct bind_column_data_t* bind_data = NULL;
+  SQLULEN row_array_size = m_row_array_size;
+  SQLULEN nbr_fetched = 0;
+  SQLUSMALLINT* row_status = NULL;
+
+  if (!SQL_SUCCEEDED(SQLNumResultCols(hstmt, &nbr_cols)))
+  {
+
+  }
+
+  bind_data = (bind_column_data_t*)malloc(nbr_cols * sizeof(bind_column_data_t));
+  for (SQLUSMALLINT idx = 0; idx < nbr_cols; idx++)
+  {
+    bind_data[idx].target_value_ptr = NULL;
+    bind_data[idx].strlen_or_ind = NULL;
+    bind_data[idx].bound = true;
+  }
+  SQLUSMALLINT first_unbound = nbr_cols;
+
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+  //get column names and SQL types, choose the C type of each column
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+
+  table.cols.resize(nbr_cols);
+  for (SQLUSMALLINT idx = 0; idx < nbr_cols; idx++)
+  {
+    SQLCHAR buf[1024];
+    SQLSMALLINT sqltype = 0;
+    SQLSMALLINT scale = 0;
+    SQLSMALLINT nullable = 0;
+    SQLSMALLINT len = 0;
+    SQLULEN sqlsize = 0;
+
+    if (!SQL_SUCCEEDED(SQLDescribeCol(
+      hstmt,
+      idx + 1,
+      (SQLCHAR*)buf, //column name
+      sizeof(buf) / sizeof(SQLCHAR),
+      &len,
+      &sqltype,
+      &sqlsize,
+      &scale,
+      &nullable)))
+    {
+      extract_error(hstmt, SQL_HANDLE_STMT);
+    }
+
+    typed_column_t& col = table.cols.at(idx);
+    col.name = (char*)buf;
+    col.sqltype = sqltype;
+
+    switch (sqltype)
+    {
+    case SQL_DECIMAL:
+    case SQL_NUMERIC:
+    case SQL_FLOAT:
+    case SQL_REAL:
+    case SQL_DOUBLE:
+      col.ctype = SQL_C_DOUBLE;
+      bind_data[idx].buf_len = sizeof(double);
+      break;
+    case SQL_BIGINT:
+      col.ctype = SQL_C_SBIGINT;
+      bind_data[idx].buf_len = sizeof(int64_t);
+      break;
+    case SQL_INTEGER:
+    case SQL_SMALLINT:
+    case SQL_TINYINT:
+    case SQL_BIT:
+      col.ctype = SQL_C_LONG;
+      bind_data[idx].buf_len = sizeof(int32_t);
+      break;
+    default:
+      col.ctype = SQL_C_CHAR;
+      bind_data[idx].buf_len = char_buffer_len(hstmt, idx + 1, sqltype, sqlsize);
+      col.offsets.push_back(0);
+      break;
+    }
+    bind_data[idx].target_type = col.ctype;
+    if (bind_data[idx].buf_len == 0 && first_unbound == nbr_cols)
+    {
+      first_unbound = idx;
+    }
+  }
+
+  for (SQLUSMALLINT idx = first_unbound; idx < nbr_cols; idx++)
+  {
+    bind_data[idx].bound = false;
+  }
+  if (first_unbound < nbr_cols)
+  {
+    row_array_size = 1;
+  }
+
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+  //block cursor, column-wise binding
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+
+  if (row_array_size > 1)
+  {
+    if (!SQL_SUCCEEDED(SQLSetStmtAttr(hstmt, SQL_ATTR_ROW_BIND_TYPE, (SQLPOINTER)SQL_BIND_BY_COLUMN, 0)) ||
+      !SQL_SUCCEEDED(SQLSetStmtAttr(hstmt, SQL_ATTR_ROW_ARRAY_SIZE, (SQLPOINTER)row_array_size, 0)))
+    {
+      extract_error(hstmt, SQL_HANDLE_STMT);
+      row_array_size = 1;
+    }
+    else if (!SQL_SUCCEEDED(SQLGetStmtAttr(hstmt, SQL_ATTR_ROW_ARRAY_SIZE, &row_array_size, 0, NULL)) || row_array_size == 0)
+    {
+      row_array_size = 1;
+    }
+  }
+
+  row_status = (SQLUSMALLINT*)malloc(row_array_size * sizeof(SQLUSMALLINT));
+  SQLSetStmtAttr(hstmt, SQL_ATTR_ROW_STATUS_PTR, row_status, 0);
+  SQLSetStmtAttr(hstmt, SQL_ATTR_ROWS_FETCHED_PTR, &nbr_fetched, 0);
+
+  for (SQLUSMALLINT idx = 0; idx < nbr_cols; idx++)
+  {
+    //an unbound numeric column is read into its buffer with SQLGetData, an unbound character column
+    //is streamed into the column vector
+    bind_data[idx].target_value_ptr = bind_data[idx].buf_len > 0 ? malloc(bind_data[idx].buf_len * row_array_size) : NULL;
+    bind_data[idx].strlen_or_ind = (SQLLEN*)malloc(sizeof(SQLLEN) * row_array_size);
+    if (!bind_data[idx].bound)
+    {
+      continue;
+    }
+
+    if (!SQL_SUCCEEDED(SQLBindCol(
+      hstmt,
+      idx + 1,
+      bind_data[idx].target_type,
+      bind_data[idx].target_value_ptr,
+      bind_data[idx].buf_len,
+      bind_data[idx].strlen_or_ind)))
+    {
+      extract_error(hstmt, SQL_HANDLE_STMT);
+    }
+  }
+
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+  //append each fetched block to the column vectors
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+
+  while (SQL_SUCCEEDED(SQLFetch(hstmt)))
+  {
+    for (SQLULEN idx_row = 0; idx_row < nbr_fetched; idx_row++)
+    {
+      if (row_status[idx_row] == SQL_ROW_ERROR || row_status[idx_row] == SQL_ROW_NOROW)
+      {
+        continue;
+      }
+
+      size_t row = table.nbr_rows;
+      for (int idx_col = 0; idx_col < nbr_cols; idx_col++)
+      {
+        typed_column_t& col = table.cols.at(idx_col);
+        SQLLEN ind = SQL_NULL_DATA;
+        char* value = NULL;
+        std::string long_value;
+
+        if (bind_data[idx_col].bound)
+        {
+          ind = bind_data[idx_col].strlen_or_ind[idx_row];
+          value = (char*)bind_data[idx_col].target_value_ptr + idx_row * bind_data[idx_col].buf_len;
+        }
+        else if (col.ctype == SQL_C_CHAR)
+        {
+          get_long_data(hstmt, idx_col + 1, long_value, ind);
+          value = &long_value[0];
+        }
+        else
+        {
+          value = (char*)bind_data[idx_col].target_value_ptr;
+          if (!SQL_SUCCEEDED(SQLGetData(hstmt, idx_col + 1, col.ctype, value, bind_data[idx_col].buf_len, &ind)))
+          {
+            extract_error(hstmt, SQL_HANDLE_STMT);
+            ind = SQL_NULL_DATA;
+          }
+        }
+
+        if (row % 64 == 0)
+        {
+          col.nulls.push_back(0);
+        }
+        if (ind == SQL_NULL_DATA)
+        {
+          col.nulls.back() |= (uint64_t)1 << (row % 64);
+        }
+
+        switch (col.ctype)
+        {
+        case SQL_C_DOUBLE:
+          col.dbl.push_back(ind == SQL_NULL_DATA ? 0.0 : *(double*)value);
+          break;
+        case SQL_C_SBIGINT:
+          col.i64.push_back(ind == SQL_NULL_DATA ? 0 : *(int64_t*)value);
+          break;
+        case SQL_C_LONG:
+          col.i32.push_back(ind == SQL_NULL_DATA ? 0 : *(int32_t*)value);
+          break;
+        default:
+          if (ind != SQL_NULL_DATA)
+          {
+            size_t len = (bind_data[idx_col].bound && (ind == SQL_NO_TOTAL || ind >= bind_data[idx_col].buf_len)) ?
+              strlen(value) : (size_t)ind;
+            col.chars.insert(col.chars.end(), value, value + len);
+          }
+          col.offsets.push_back(col.chars.size());
+          break;
+        }
+        col.nbr_rows++;
+      }
+      table.nbr_rows++;
+      m_timing.rows++;
+    }
+
+    if (visitor != NULL && table.nbr_rows > 0)
+    {
+      int rc = (*visitor)(table);
+      table.clear_rows();
+      if (rc < 0)
+      {
+        break;
+      }
+    }
+  }
+
+  for (SQLUSMALLINT idx_col = 0; idx_col < nbr_cols; idx_col++)
+  {
+    free(bind_data[idx_col].target_value_ptr);
+    free(bind_data[idx_col].strlen_or_ind);
+  }
+  free(bind_data);
+  free(row_status);
+
+  //buffers are freed, restore the statement attributes so a cached prepared statement can be reused
+  SQLFreeStmt(hstmt, SQL_UNBIND);
+  SQLSetStmtAttr(hstmt, SQL_ATTR_ROW_STATUS_PTR, NULL, 0);
+  SQLSetStmtAttr(hstmt, SQL_ATTR_ROWS_FETCHED_PTR, NULL, 0);
+  SQLSetStmtAttr(hstmt, SQL_ATTR_ROW_ARRAY_SIZE, (SQLPOINTER)1, 0);
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//param_t::param_t
+//SQL_C_CHAR with SQL_NULL_DATA indicator binds a NULL of any parameter type
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+param_t::param_t() :
+  ctype(SQL_C_CHAR),
+  sqltype(SQL_VARCHAR),
+  i32(0),
+  i64(0),
+  dbl(0),
+  ind(SQL_NULL_DATA)
+{
+}
+
+param_t::param_t(int value) :
+  ctype(SQL_C_LONG),
+  sqltype(SQL_INTEGER),
+  i32(value),
+  i64(value),
+  dbl(value),
+  ind(0)
+{
+}
+
+param_t::param_t(long long value) :
+  ctype(SQL_C_SBIGINT),
+  sqltype(SQL_BIGINT),
+  i32(0),
+  i64(value),
+  dbl(static_cast<double>(value)),
+  ind(0)
+{
+}
+
+param_t::param_t(double value) :
+  ctype(SQL_C_DOUBLE),
+  sqltype(SQL_DOUBLE),
+  i32(0),
+  i64(0),
+  dbl(value),
+  ind(0)
+{
+}
+
+param_t::param_t(const std::string& value) :
+  ctype(SQL_C_CHAR),
+  sqltype(SQL_VARCHAR),
+  i32(0),
+  i64(0),
+  dbl(0),
+  str(value),
+  ind(SQL_NTS)
+{
+}
+
+param_t::param_t(const char* value) :
+  ctype(SQL_C_CHAR),
+  sqltype(SQL_VARCHAR),
+  i32(0),
+  i64(0),
+  dbl(0),
+  str(value),
+  ind(SQL_NTS)
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//odbc::get_statement
+//returns the cached statement for 'sql', allocating and preparing it with SQLPrepare on first use
+//when the cache is full the least recently used statement is freed, never one in use (a result still
+//being read, e.g. by the visitor of a streaming fetch that runs other statements); if every statement
+//is in use the cache grows past ODBC::STATEMENT_CACHE_SIZE
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+odbc_t::stmt_t* odbc_t::get_statement(const std::string& sql)
+{
+  std::map<std::string, stmt_t*>::iterator it = m_stmt_cache.find(sql);
+  if (it != m_stmt_cache.end())
+  {
+    it->second->last_use = ++m_stmt_clock;
+    return it->second;
+  }
+
+  if (m_stmt_cache.size() >= ODBC::STATEMENT_CACHE_SIZE)
+  {
+    std::map<std::string, stmt_t*>::iterator lru = m_stmt_cache.end();
+    for (it = m_stmt_cache.begin(); it != m_stmt_cache.end(); ++it)
+    {
+      if (!it->second->in_use && (lru == m_stmt_cache.end() || it->second->last_use < lru->second->last_use))
+      {
+        lru = it;
+      }
+    }
+    if (lru != m_stmt_cache.end())
+    {
+      SQLFreeHandle(SQL_HANDLE_STMT, lru->second->hstmt);
+      delete lru->second;
+      m_stmt_cache.erase(lru);
+    }
+  }
+
+  SQLHSTMT hstmt;
+  SQLCHAR* sqlstr = (SQLCHAR*)sql.c_str();
+
+  if (!SQL_SUCCEEDED(SQLAllocHandle(SQL_HANDLE_STMT, m_hdbc, &hstmt)))
+  {
+    extract_error(m_hdbc, SQL_HANDLE_DBC);
+    return NULL;
+  }
+
+  long long start = now_us();
+  SQLRETURN rc = SQLPrepare(hstmt, sqlstr, SQL_NTS);
+  m_timing.prepare_us += now_us() - start;
+  if (!SQL_SUCCEEDED(rc))
+  {
+    extract_error(hstmt, SQL_HANDLE_STMT);
+    SQLFreeHandle(SQL_HANDLE_STMT, hstmt);
+    return NULL;
+  }
+
+  stmt_t* stmt = new stmt_t;
+  stmt->hstmt = hstmt;
+  stmt->last_use = ++m_stmt_clock;
+  stmt->in_use = false;
+  m_stmt_cache[sql] = stmt;
+  return stmt;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//odbc::close_statement
+//closes the result of a statement run by execute_statement and releases its parameters; the statement
+//stays prepared in the cache and can be freed again when the cache is full
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void odbc_t::close_statement(stmt_t* stmt)
+{
+  SQLFreeStmt(stmt->hstmt, SQL_CLOSE);
+  SQLFreeStmt(stmt->hstmt, SQL_RESET_PARAMS);
+  stmt->in_use = false;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//odbc::free_statements
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void odbc_t::free_statements()
+{
+  for (std::map<std::string, stmt_t*>::iterator it = m_stmt_cache.begin(); it != m_stmt_cache.end(); ++it)
+  {
+    SQLFreeHandle(SQL_HANDLE_STMT, it->second->hstmt);
+    delete it->second;
+  }
+  m_stmt_cache.clear();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//odbc::record
+//adds the measurements of the call that is returning to the statement registry and clears them
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void odbc_t::record(const std::string& sql, bool error)
+{
+  stats_record(sql, m_timing.prepare_us, m_timing.execute_us, m_timing.fetch_us, m_timing.rows,
+    m_timing.bytes_bound, error);
+  m_timing = timing_t();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//odbc::execute_statement
+//binds 'params' to the markers of the cached statement for 'sql' and calls SQLExecute
+//strings are bound with a fixed column size (255 or 8000) so the server reuses one plan for all values
+//returns the statement, in use until close_statement, NULL on error
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+odbc_t::stmt_t* odbc_t::execute_statement(const std::string& sql, const std::vector<param_t>& params)
+{
+  stmt_t* stmt = get_statement(sql);
+  if (stmt == NULL)
+  {
+    return NULL;
+  }
+
+  //copy values into the cache entry, SQLBindParameter keeps pointers to them until SQLExecute
+  stmt->params = params;
+
+  for (size_t idx = 0; idx < stmt->params.size(); idx++)
+  {
+    param_t& param = stmt->params[idx];
+    SQLULEN column_size = 0;
+    SQLPOINTER value_ptr = NULL;
+    SQLLEN buffer_len = 0;
+
+    switch (param.ctype)
+    {
+    case SQL_C_LONG:
+      column_size = 10;
+      value_ptr = &param.i32;
+      m_timing.bytes_bound += sizeof(int32_t);
+      break;
+    case SQL_C_SBIGINT:
+      column_size = 19;
+      value_ptr = &param.i64;
+      m_timing.bytes_bound += sizeof(int64_t);
+      break;
+    case SQL_C_DOUBLE:
+      column_size = 15;
+      value_ptr = &param.dbl;
+      m_timing.bytes_bound += sizeof(double);
+      break;
+    default:
+      column_size = param.str.size() <= 255 ? 255 : 8000;
+      if (param.str.size() > 8000)
+      {
+        param.sqltype = SQL_LONGVARCHAR;
+        column_size = param.str.size();
+      }
+      value_ptr = (SQLPOINTER)param.str.c_str();
+      buffer_len = param.str.size() + 1;
+      m_timing.bytes_bound += param.str.size();
+      break;
+    }
+
+    if (!SQL_SUCCEEDED(SQLBindParameter(
+      stmt->hstmt,
+      static_cast<SQLUSMALLINT>(idx + 1),
+      SQL_PARAM_INPUT,
+      param.ctype,
+      param.sqltype,
+      column_size,
+      0,
+      value_ptr,
+      buffer_len,
+      &param.ind)))
+    {
+      extract_error(stmt->hstmt, SQL_HANDLE_STMT);
+      SQLFreeStmt(stmt->hstmt, SQL_RESET_PARAMS);
+      return NULL;
+    }
+  }
+
+  long long start = now_us();
+  SQLRETURN rc = SQLExecute(stmt->hstmt);
+  m_timing.execute_us += now_us() - start;
+  if (rc == SQL_SUCCESS || rc == SQL_SUCCESS_WITH_INFO || rc == SQL_NO_DATA)
+  {
+  }
+  else
+  {
+    extract_error(stmt->hstmt, SQL_HANDLE_STMT);
+    SQLFreeStmt(stmt->hstmt, SQL_CLOSE);
+    SQLFreeStmt(stmt->hstmt, SQL_RESET_PARAMS);
+    return NULL;
+  }
+
+  stmt->in_use = true;
+  return stmt;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//odbc::prepare
+//prepares 'sql' and keeps it in the statement cache; optional, execute() and fetch() prepare on first use
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int odbc_t::prepare(const std::string& sql)
+{
+  if (get_statement(sql) == NULL)
+  {
+    record(sql, true);
+    return -1;
+  }
+  record(sql, false);
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//odbc::execute
+//executes a cached prepared statement with parameter markers '?' bound to 'params'
+//parameter values are sent separately from the SQL text, no quoting or escaping is needed
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int odbc_t::execute(const std::string& sql, const std::vector<param_t>& params)
+{
+  stmt_t* stmt = execute_statement(sql, params);
+  if (stmt == NULL)
+  {
+    record(sql, true);
+    return -1;
+  }
+
+  SQLLEN nbr_rows = 0;
+  if (SQL_SUCCEEDED(SQLRowCount(stmt->hstmt, &nbr_rows)) && nbr_rows > 0)
+  {
+    m_timing.rows = nbr_rows;
+  }
+  close_statement(stmt);
+  record(sql, false);
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//odbc::fetch
+//executes a cached prepared statement with 'params' and reads the result set into 'table'
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int odbc_t::fetch(const std::string& sql, const std::vector<param_t>& params, table_t& table)
+{
+  stmt_t* stmt = execute_statement(sql, params);
+  if (stmt == NULL)
+  {
+    record(sql, true);
+    return -1;
+  }
+
+  long long start = now_us();
+  int rc = fetch_result(stmt->hstmt, table);
+  m_timing.fetch_us = now_us() - start;
+  close_statement(stmt);
+  record(sql, rc < 0);
+  return rc;
+}
+
+int odbc_t::fetch(const std::string& sql, const std::vector<param_t>& params, typed_table_t& table)
+{
+  stmt_t* stmt = execute_statement(sql, params);
+  if (stmt == NULL)
+  {
+    record(sql, true);
+    return -1;
+  }
+
+  long long start = now_us();
+  int rc = fetch_result(stmt->hstmt, table);
+  m_timing.fetch_us = now_us() - start;
+  close_statement(stmt);
+  record(sql, rc < 0);
+  return rc;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//odbc::fetch
+//streaming fetch: 'visitor' receives each block of up to get_row_array_size() rows while the
+//result set is read, no row is kept after the visitor returns
+//a large scan should set a row array size > 1, otherwise the visitor is called once per row
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int odbc_t::fetch(const std::string& sql, const batch_visitor_t& visitor)
+{
+  SQLHSTMT hstmt;
+  SQLCHAR* sqlstr = (SQLCHAR*)sql.c_str();
+
+  if (!SQL_SUCCEEDED(SQLAllocHandle(SQL_HANDLE_STMT, m_hdbc, &hstmt)))
+  {
+    extract_error(m_hdbc, SQL_HANDLE_DBC);
+    return -1;
+  }
+
+  long long start = now_us();
+  SQLRETURN ret = SQLExecDirect(hstmt, sqlstr, SQL_NTS);
+  m_timing.execute_us = now_us() - start;
+  if (!SQL_SUCCEEDED(ret))
+  {
+    extract_error(hstmt, SQL_HANDLE_STMT);
+    SQLFreeHandle(SQL_HANDLE_STMT, hstmt);
+    record(sql, true);
+    return -1;
+  }
+
+  typed_table_t batch;
+  start = now_us();
+  int rc = fetch_result(hstmt, batch, &visitor);
+  m_timing.fetch_us = now_us() - start;
+  SQLFreeHandle(SQL_HANDLE_STMT, hstmt);
+  record(sql, rc < 0);
+  return rc;
+}
+
+int odbc_t::fetch(const std::string& sql, const std::vector<param_t>& params, const batch_visitor_t& visitor)
+{
+  stmt_t* stmt = execute_statement(sql, params);
+  if (stmt == NULL)
+  {
+    record(sql, true);
+    return -1;
+  }
+
+  typed_table_t batch;
+  long long start = now_us();
+  int rc = fetch_result(stmt->hstmt, batch, &visitor);
+  m_timing.fetch_us = now_us() - start;
+  close_statement(stmt);
+  record(sql, rc < 0);
+  return rc;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//async_t::async_t
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+async_t::async_t() :
+  odbc(NULL),
+  hstmt(NULL),
+  state(0),
+  start_us(0),
+  execute_us(0)
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//async_t::~async_t
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+async_t::~async_t()
+{
+  if (hstmt != NULL)
+  {
+    if (state == 1)
+    {
+      SQLCancel(hstmt);
+    }
+    SQLFreeHandle(SQL_HANDLE_STMT, hstmt);
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//odbc::exec_direct_async
+//starts 'sql' on a new statement with SQL_ATTR_ASYNC_ENABLE and returns without waiting
+//SQLExecDirect returns SQL_STILL_EXECUTING while the server works; poll() calls it again with the
+//same arguments until it returns the final result; a driver without async support executes
+//synchronously and the statement is complete on return
+//one connection runs one statement at a time, statements in flight at once use different connections
+//returns 0 if the statement was started or completed, -1 on error
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int odbc_t::exec_direct_async(const std::string& sql, async_t& async)
+{
+  if (async.hstmt != NULL)
+  {
+    SQLFreeHandle(SQL_HANDLE_STMT, async.hstmt);
+    async.hstmt = NULL;
+  }
+  async.odbc = this;
+  async.sql = sql;
+  async.state = -1;
+  async.start_us = now_us();
+  async.execute_us = 0;
+
+  if (!SQL_SUCCEEDED(SQLAllocHandle(SQL_HANDLE_STMT, m_hdbc, &async.hstmt)))
+  {
+    extract_error(m_hdbc, SQL_HANDLE_DBC);
+    async.hstmt = NULL;
+    return -1;
+  }
+
+  if (!SQL_SUCCEEDED(SQLSetStmtAttr(async.hstmt, SQL_ATTR_ASYNC_ENABLE, (SQLPOINTER)SQL_ASYNC_ENABLE_ON, 0)))
+  {
+    extract_error(async.hstmt, SQL_HANDLE_STMT);
+  }
+
+  async.state = 1;
+  return poll(async) < 0 ? -1 : 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//odbc::poll
+//checks a statement started with exec_direct_async
+//returns 1 while executing, 0 when complete, -1 on error
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int odbc_t::poll(async_t& async)
+{
+  if (async.state != 1)
+  {
+    return async.state;
+  }
+
+  SQLCHAR* sqlstr = (SQLCHAR*)async.sql.c_str();
+  SQLRETURN rc = SQLExecDirect(async.hstmt, sqlstr, SQL_NTS);
+  if (rc == SQL_STILL_EXECUTING)
+  {
+    return 1;
+  }
+
+  async.execute_us = now_us() - async.start_us;
+  if (rc == SQL_SUCCESS || rc == SQL_SUCCESS_WITH_INFO || rc == SQL_NO_DATA)
+  {
+    //result set is read synchronously
+    SQLSetStmtAttr(async.hstmt, SQL_ATTR_ASYNC_ENABLE, (SQLPOINTER)SQL_ASYNC_ENABLE_OFF, 0);
+    async.state = 0;
+  }
+  else
+  {
+    extract_error(async.hstmt, SQL_HANDLE_STMT);
+    async.state = -1;
+    stats_record(async.sql, 0, async.execute_us, 0, 0, 0, true);
+  }
+
+  if (async.on_complete)
+  {
+    async.on_complete(async);
+  }
+  return async.state;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//odbc::cancel
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int odbc_t::cancel(async_t& async)
+{
+  if (async.state != 1)
+  {
+    return 0;
+  }
+
+  if (!SQL_SUCCEEDED(SQLCancel(async.hstmt)))
+  {
+    extract_error(async.hstmt, SQL_HANDLE_STMT);
+    return -1;
+  }
+  async.state = -1;
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//odbc::fetch
+//reads the result set of a completed asynchronous statement and frees the statement
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int odbc_t::fetch(async_t& async, table_t& table)
+{
+  if (async.state != 0 || async.hstmt == NULL)
+  {
+    return -1;
+  }
+
+  long long start = now_us();
+  int rc = fetch_result(async.hstmt, table);
+  m_timing.execute_us = async.execute_us;
+  m_timing.fetch_us = now_us() - start;
+  SQLFreeHandle(SQL_HANDLE_STMT, async.hstmt);
+  async.hstmt = NULL;
+  record(async.sql, rc < 0);
+  return rc;
+}
+
+int odbc_t::fetch(async_t& async, typed_table_t& table)
+{
+  if (async.state != 0 || async.hstmt == NULL)
+  {
+    return -1;
+  }
+
+  long long start = now_us();
+  int rc = fetch_result(async.hstmt, table);
+  m_timing.execute_us = async.execute_us;
+  m_timing.fetch_us = now_us() - start;
+  SQLFreeHandle(SQL_HANDLE_STMT, async.hstmt);
+  async.hstmt = NULL;
+  record(async.sql, rc < 0);
+  return rc;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//wait_async
+//polls every statement in 'pending' from the calling thread until none is executing
+//returns 0 if all completed, -1 if any failed
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int wait_async(const std::vector<async_t*>& pending, int interval_ms)
+{
+  while (true)
+  {
+    bool executing = false;
+    int rc = 0;
+    for (size_t idx = 0; idx < pending.size(); idx++)
+    {
+      async_t* async = pending[idx];
+      int state = async->odbc != NULL ? async->odbc->poll(*async) : async->state;
+      if (state == 1)
+      {
+        executing = true;
+      }
+      else if (state < 0)
+      {
+        rc = -1;
+      }
+    }
+
+    if (!executing)
+    {
+      return rc;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(interval_ms));
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//odbc::execute_batch
+//executes a cached prepared statement once for every row of 'rows', ODBC::PARAMSET_SIZE rows per SQLExecute
+//parameters are bound column-wise (SQL_PARAM_BIND_BY_COLUMN) to arrays and SQL_ATTR_PARAMSET_SIZE
+//is the number of rows in the array; the driver sends the whole array in one round trip
+//the column C type is the widest type in the column: SQL_C_CHAR, SQL_C_DOUBLE, SQL_C_SBIGINT, SQL_C_LONG
+//'row_status' receives the SQL_ATTR_PARAM_STATUS_PTR value of each row: SQL_PARAM_SUCCESS,
+//SQL_PARAM_SUCCESS_WITH_INFO, SQL_PARAM_ERROR (row rejected) or SQL_PARAM_UNUSED
+//'nbr_affected', if not NULL, receives the sum of the row counts (SQLRowCount) of all rows; a row executed by
+//'INSERT ... WHERE NOT EXISTS' that found its row counts 0; rows whose driver reports no count count as 1
+//returns number of rows executed successfully, -1 on error
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int odbc_t::execute_batch(const std::string& sql, const std::vector<std::vector<param_t>>& rows, std::vector<SQLUSMALLINT>& row_status,
+  long long* nbr_affected)
+{
+  row_status.assign(rows.size(), SQL_PARAM_UNUSED);
+  if (nbr_affected != NULL)
+  {
+    *nbr_affected = 0;
+  }
+  if (rows.empty())
+  {
+    return 0;
+  }
+
+  stmt_t* stmt = get_statement(sql);
+  if (stmt == NULL)
+  {
+    record(sql, true);
+    return -1;
+  }
+
+  size_t nbr_params = rows[0].size();
+  int nbr_success = 0;
+
+  for (size_t start = 0; start < rows.size(); start += ODBC::PARAMSET_SIZE)
+  {
+    size_t nbr_rows = std::min(ODBC::PARAMSET_SIZE, rows.size() - start);
+    SQLULEN nbr_processed = 0;
+    long long nbr_counted = 0;
+    bool counted = false;
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////
+    //fill one array per parameter
+    /////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    std::vector<std::vector<char>> buffers(nbr_params);
+    std::vector<std::vector<SQLLEN>> indicators(nbr_params);
+    std::vector<SQLSMALLINT> ctypes(nbr_params, SQL_C_LONG);
+    std::vector<SQLSMALLINT> sqltypes(nbr_params, SQL_INTEGER);
+    std::vector<SQLLEN> widths(nbr_params, sizeof(int32_t));
+
+    for (size_t idx_col = 0; idx_col < nbr_params; idx_col++)
+    {
+      size_t max_len = 0;
+      for (size_t idx_row = start; idx_row < start + nbr_rows; idx_row++)
+      {
+        const param_t& param = rows[idx_row][idx_col];
+        if (param.ind == SQL_NULL_DATA)
+        {
+          continue;
+        }
+        if (param.ctype == SQL_C_CHAR)
+        {
+          ctypes[idx_col] = SQL_C_CHAR;
+        }
+        else if (param.ctype == SQL_C_DOUBLE && ctypes[idx_col] != SQL_C_CHAR)
+        {
+          ctypes[idx_col] = SQL_C_DOUBLE;
+        }
+        else if (param.ctype == SQL_C_SBIGINT && ctypes[idx_col] == SQL_C_LONG)
+        {
+          ctypes[idx_col] = SQL_C_SBIGINT;
+        }
+      }
+
+      //a column with any string is bound as SQL_C_CHAR; its numbers are sent as text, so the width is
+      //measured on the converted values
+      std::vector<std::string> strings;
+      if (ctypes[idx_col] == SQL_C_CHAR)
+      {
+        strings.resize(nbr_rows);
+        for (size_t idx_row = 0; idx_row < nbr_rows; idx_row++)
+        {
+          const param_t& param = rows[start + idx_row][idx_col];
+          if (param.ind == SQL_NULL_DATA)
+          {
+            continue;
+          }
+          if (param.ctype == SQL_C_CHAR)
+          {
+            strings[idx_row] = param.str;
+          }
+          else if (param.ctype == SQL_C_DOUBLE)
+          {
+            strings[idx_row] = std::to_string(param.dbl);
+          }
+          else
+          {
+            strings[idx_row] = std::to_string(param.i64);
+          }
+          max_len = std::max(max_len, strings[idx_row].size());
+        }
+      }
+
+      switch (ctypes[idx_col])
+      {
+      case SQL_C_CHAR:
+        sqltypes[idx_col] = max_len > 8000 ? SQL_LONGVARCHAR : SQL_VARCHAR;
+        widths[idx_col] = max_len + 1;
+        break;
+      case SQL_C_DOUBLE:
+        sqltypes[idx_col] = SQL_DOUBLE;
+        widths[idx_col] = sizeof(double);
+        break;
+      case SQL_C_SBIGINT:
+        sqltypes[idx_col] = SQL_BIGINT;
+        widths[idx_col] = sizeof(int64_t);
+        break;
+      default:
+        break;
+      }
+
+      buffers[idx_col].assign(widths[idx_col] * nbr_rows, 0);
+      indicators[idx_col].assign(nbr_rows, SQL_NULL_DATA);
+
+      for (size_t idx_row = 0; idx_row < nbr_rows; idx_row++)
+      {
+        const param_t& param = rows[start + idx_row][idx_col];
+        if (param.ind == SQL_NULL_DATA)
+        {
+          continue;
+        }
+        char* ptr = &buffers[idx_col][idx_row * widths[idx_col]];
+        switch (ctypes[idx_col])
+        {
+        case SQL_C_CHAR:
+        {
+          const std::string& str = strings[idx_row];
+          memcpy(ptr, str.c_str(), str.size());
+          indicators[idx_col][idx_row] = str.size();
+          m_timing.bytes_bound += str.size();
+        }
+        break;
+        case SQL_C_DOUBLE:
+          memcpy(ptr, &param.dbl, sizeof(double));
+          indicators[idx_col][idx_row] = 0;
+          m_timing.bytes_bound += sizeof(double);
+          break;
+        case SQL_C_SBIGINT:
+          memcpy(ptr, &param.i64, sizeof(int64_t));
+          indicators[idx_col][idx_row] = 0;
+          m_timing.bytes_bound += sizeof(int64_t);
+          break;
+        default:
+          memcpy(ptr, &param.i32, sizeof(int32_t));
+          indicators[idx_col][idx_row] = 0;
+          m_timing.bytes_bound += sizeof(int32_t);
+          break;
+        }
+      }
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////
+    //bind arrays and execute
+    /////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    SQLSetStmtAttr(stmt->hstmt, SQL_ATTR_PARAM_BIND_TYPE, (SQLPOINTER)SQL_PARAM_BIND_BY_COLUMN, 0);
+    SQLSetStmtAttr(stmt->hstmt, SQL_ATTR_PARAMSET_SIZE, (SQLPOINTER)nbr_rows, 0);
+    SQLSetStmtAttr(stmt->hstmt, SQL_ATTR_PARAM_STATUS_PTR, &row_status[start], 0);
+    SQLSetStmtAttr(stmt->hstmt, SQL_ATTR_PARAMS_PROCESSED_PTR, &nbr_processed, 0);
+
+    int rc = 0;
+    for (size_t idx_col = 0; idx_col < nbr_params; idx_col++)
+    {
+      SQLULEN column_size = 0;
+      switch (ctypes[idx_col])
+      {
+      case SQL_C_CHAR:
+        column_size = widths[idx_col] - 1 <= 255 ? 255 : std::max<SQLULEN>(8000, widths[idx_col] - 1);
+        break;
+      case SQL_C_DOUBLE:
+        column_size = 15;
+        break;
+      case SQL_C_SBIGINT:
+        column_size = 19;
+        break;
+      default:
+        column_size = 10;
+        break;
+      }
+
+      if (!SQL_SUCCEEDED(SQLBindParameter(
+        stmt->hstmt,
+        static_cast<SQLUSMALLINT>(idx_col + 1),
+        SQL_PARAM_INPUT,
+        ctypes[idx_col],
+        sqltypes[idx_col],
+        column_size,
+        0,
+        buffers[idx_col].data(),
+        widths[idx_col],
+        indicators[idx_col].data())))
+      {
+        extract_error(stmt->hstmt, SQL_HANDLE_STMT);
+        rc = -1;
+        break;
+      }
+    }
+
+    if (rc == 0)
+    {
+      //SQL_ERROR with a status array means one or more rows were rejected, the others are executed
+      long long start_us = now_us();
+      SQLRETURN ret = SQLExecute(stmt->hstmt);
+      m_timing.execute_us += now_us() - start_us;
+      if (!SQL_SUCCEEDED(ret) && ret != SQL_NO_DATA)
+      {
+        extract_error(stmt->hstmt, SQL_HANDLE_STMT);
+        if (nbr_processed == 0)
+        {
+          rc = -1;
+        }
+      }
+
+      //one row count per row of the array (SQL_PARC_BATCH) or one for the whole array, the next one is
+      //read after SQLMoreResults; the result of a rejected row has no count
+      if (rc == 0 && nbr_affected != NULL)
+      {
+        for (size_t idx_result = 0; idx_result < nbr_rows; idx_result++)
+        {
+          SQLLEN row_count = -1;
+          if (SQL_SUCCEEDED(SQLRowCount(stmt->hstmt, &row_count)) && row_count >= 0)
+          {
+            nbr_counted += row_count;
+            counted = true;
+          }
+          ret = SQLMoreResults(stmt->hstmt);
+          if (ret == SQL_NO_DATA || ret == SQL_INVALID_HANDLE)
+          {
+            break;
+          }
+        }
+      }
+    }
+
+    SQLFreeStmt(stmt->hstmt, SQL_CLOSE);
+    SQLFreeStmt(stmt->hstmt, SQL_RESET_PARAMS);
+    SQLSetStmtAttr(stmt->hstmt, SQL_ATTR_PARAMSET_SIZE, (SQLPOINTER)1, 0);
+    SQLSetStmtAttr(stmt->hstmt, SQL_ATTR_PARAM_STATUS_PTR, NULL, 0);
+    SQLSetStmtAttr(stmt->hstmt, SQL_ATTR_PARAMS_PROCESSED_PTR, NULL, 0);
+
+    if (rc < 0)
+    {
+      m_timing.rows = nbr_success;
+      record(sql, true);
+      return -1;
+    }
+
+    int nbr_executed = 0;
+    for (size_t idx_row = start; idx_row < start + nbr_rows; idx_row++)
+    {
+      if (row_status[idx_row] == SQL_PARAM_SUCCESS || row_status[idx_row] == SQL_PARAM_SUCCESS_WITH_INFO)
+      {
+        nbr_executed++;
+      }
+    }
+    nbr_success += nbr_executed;
+    if (nbr_affected != NULL)
+    {
+      *nbr_affected += counted ? nbr_counted : nbr_executed;
+    }
+  }
+
+  m_timing.rows = nbr_success;
+  record(sql, nbr_success < static_cast<int>(rows.size()));
+  return nbr_success;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//typed_column_t::typed_column_t
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+typed_column_t::typed_column_t() :
+  sqltype(0),
+  ctype(SQL_C_CHAR),
+  nbr_rows(0)
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//typed_column_t::is_null
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool typed_column_t::is_null(size_t row) const
+{
+  return (nulls.at(row / 64) >> (row % 64)) & 1;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//typed_column_t::is_number
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool typed_column_t::is_number() const
+{
+  return ctype == SQL_C_DOUBLE || ctype == SQL_C_SBIGINT || ctype == SQL_C_LONG;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//typed_column_t::get_double
+//value of a numeric column as double, 0 for NULL or character columns
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+double typed_column_t::get_double(size_t row) const
+{
+  switch (ctype)
+  {
+  case SQL_C_DOUBLE:
+    return dbl.at(row);
+  case SQL_C_SBIGINT:
+    return static_cast<double>(i64.at(row));
+  case SQL_C_LONG:
+    return static_cast<double>(i32.at(row));
+  default:
+    break;
+  }
+  return 0.0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//typed_column_t::get_int
+//value of an integer column (a double column is truncated), 0 for NULL or character columns
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int64_t typed_column_t::get_int(size_t row) const
+{
+  switch (ctype)
+  {
+  case SQL_C_DOUBLE:
+    return static_cast<int64_t>(dbl.at(row));
+  case SQL_C_SBIGINT:
+    return i64.at(row);
+  case SQL_C_LONG:
+    return i32.at(row);
+  default:
+    break;
+  }
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//typed_column_t::get_string
+//view of a character column value, valid while the column is not modified
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::string_view typed_column_t::get_string(size_t row) const
+{
+  if (ctype != SQL_C_CHAR)
+  {
+    return std::string_view();
+  }
+  size_t start = offsets.at(row);
+  return std::string_view(chars.data() + start, offsets.at(row + 1) - start);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//typed_column_t::to_string
+//value of any column as a string, ODBC::SQL_NULL for NULL
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::string typed_column_t::to_string(size_t row) const
+{
+  if (is_null(row))
+  {
+    return ODBC::SQL_NULL;
+  }
+  switch (ctype)
+  {
+  case SQL_C_DOUBLE:
+    return std::to_string(dbl.at(row));
+  case SQL_C_SBIGINT:
+    return std::to_string(i64.at(row));
+  case SQL_C_LONG:
+    return std::to_string(i32.at(row));
+  default:
+    break;
+  }
+  return std::string(get_string(row));
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//typed_column_t::remove
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void typed_column_t::remove()
+{
+  nbr_rows = 0;
+  dbl.clear();
+  i64.clear();
+  i32.clear();
+  chars.clear();
+  offsets.clear();
+  nulls.clear();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//typed_column_t::clear_rows
+//removes all values, keeps name and types; capacity is kept for the next block
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void typed_column_t::clear_rows()
+{
+  remove();
+  if (ctype == SQL_C_CHAR)
+  {
+    offsets.push_back(0);
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//typed_table_t::remove
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void typed_table_t::remove()
+{
+  cols.clear();
+  nbr_rows = 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//typed_table_t::clear_rows
+//removes all rows, keeps the columns
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void typed_table_t::clear_rows()
+{
+  for (size_t idx = 0; idx < cols.size(); idx++)
+  {
+    cols[idx].clear_rows();
+  }
+  nbr_rows = 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//typed_table_t::col
+//column by name; asserts the column exists
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+const typed_column_t& typed_table_t::col(const std::string& col_name) const
+{
+  size_t col_num = cols.size();
+  for (size_t idx = 0; idx < cols.size(); idx++)
+  {
+    if (cols.at(idx).name.compare(col_name) == 0)
+    {
+      col_num = idx;
+      break;
+    }
+  }
+  assert(col_num < cols.size());
+  return cols.at(col_num);
+}
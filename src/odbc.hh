@@ -8,9 +8,17 @@
 #include <stdio.h>
 #include <sql.h>
 #include <sqlext.h>
+#ifdef HAVE_MSODBCSQL
+#include <msodbcsql.h>
+#endif
 #include <string>
+#include <string_view>
 #include <vector>
+#include <map>
+#include <functional>
+#include <stdint.h>
 #include <assert.h>
+#include "stats.hh"
 
 #ifndef _MSC_VER
 #ifndef FALSE
@@ -25,6 +33,25 @@ namespace ODBC
 {
   //return value for a cell that is SQL_NULL_DATA as a string
   const std::string SQL_NULL = "SQL_NULL_DATA";
+
+  //number of rows returned by one SQLFetch call for scans that use a block cursor
+  const size_t ROW_ARRAY_SIZE = 1000;
+
+  //maximum number of prepared statements kept per connection
+  const size_t STATEMENT_CACHE_SIZE = 256;
+
+  //number of parameter rows sent by one SQLExecute call of a batched insert
+  const size_t PARAMSET_SIZE = 1000;
+
+  //interval between polls of statements executed asynchronously
+  const int ASYNC_POLL_MS = 5;
+
+  //largest bind buffer of a character column, in bytes; longer and unbounded columns (VARCHAR(MAX), TEXT, XML)
+  //are not bound and are read with SQLGetData in GET_DATA_CHUNK pieces
+  const SQLLEN MAX_BIND_SIZE = 8001;
+
+  //size of one SQLGetData call for a long column
+  const SQLLEN GET_DATA_CHUNK = 8192;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -66,6 +93,120 @@ public:
   std::string get_row_col_value(int row, const std::string& col_name);
 };
 
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//typed_column_t
+//a column of a typed result set, bound with the C type that matches the SQL type from SQLDescribeCol
+//  DECIMAL, NUMERIC, FLOAT, REAL     -> SQL_C_DOUBLE, stored in 'dbl'
+//  BIGINT                            -> SQL_C_SBIGINT, stored in 'i64'
+//  INT, SMALLINT, TINYINT, BIT       -> SQL_C_LONG, stored in 'i32'
+//  other types                       -> SQL_C_CHAR, stored back to back in 'chars', row N is
+//                                       chars[offsets[N], offsets[N + 1])
+//values are contiguous, one per row (0 for NULL), NULL rows have their bit set in 'nulls'
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class typed_column_t
+{
+public:
+  typed_column_t();
+  std::string name;
+  SQLSMALLINT sqltype; //SQL type reported by SQLDescribeCol
+  SQLSMALLINT ctype; //C type of the binding
+  size_t nbr_rows;
+  std::vector<double> dbl;
+  std::vector<int64_t> i64;
+  std::vector<int32_t> i32;
+  std::vector<char> chars;
+  std::vector<size_t> offsets;
+  std::vector<uint64_t> nulls; //null bitmap, bit (row % 64) of word (row / 64)
+
+  bool is_null(size_t row) const;
+  bool is_number() const;
+  double get_double(size_t row) const;
+  int64_t get_int(size_t row) const;
+  std::string_view get_string(size_t row) const;
+  std::string to_string(size_t row) const;
+  void remove();
+  void clear_rows();
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//typed_table_t
+//columnar result set, one typed_column_t per column
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class typed_table_t
+{
+public:
+  typed_table_t() :
+    nbr_rows(0)
+  {
+
+  }
+  std::vector<typed_column_t> cols;
+  size_t nbr_rows;
+  void remove();
+  void clear_rows();
+  const typed_column_t& col(const std::string& col_name) const;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//batch_visitor_t
+//called by the streaming odbc_t::fetch with each block of rows returned by SQLFetch
+//the batch is cleared after the call, return -1 to stop reading the result set
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+typedef std::function<int(const typed_table_t& batch)> batch_visitor_t;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//param_t
+//typed value of a statement parameter marker '?'; default constructed is NULL
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class param_t
+{
+public:
+  param_t();
+  param_t(int value);
+  param_t(long long value);
+  param_t(double value);
+  param_t(const std::string& value);
+  param_t(const char* value);
+  SQLSMALLINT ctype; //C type of the value: SQL_C_LONG, SQL_C_SBIGINT, SQL_C_DOUBLE or SQL_C_CHAR
+  SQLSMALLINT sqltype; //SQL type of the parameter
+  int32_t i32;
+  int64_t i64;
+  double dbl;
+  std::string str;
+  SQLLEN ind; //length or indicator, SQL_NULL_DATA for NULL
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//async_t
+//statement executed asynchronously with odbc_t::exec_direct_async (SQL_ATTR_ASYNC_ENABLE, polling)
+//'state' is 1 while executing, 0 when complete, -1 on error
+//'on_complete' is called once, by the call that observes the end of the execution
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class odbc_t;
+
+class async_t
+{
+public:
+  async_t();
+  ~async_t();
+  odbc_t* odbc;
+  SQLHSTMT hstmt;
+  std::string sql;
+  int state;
+  std::function<void(async_t& async)> on_complete;
+  long long start_us; //now_us() when started
+  long long execute_us; //time to completion, recorded with the fetch time by fetch()
+
+private:
+  async_t(const async_t&) = delete;
+  async_t& operator=(const async_t&) = delete;
+};
+
 /////////////////////////////////////////////////////////////////////////////////////////////////////
 // odbc_t
 /////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -75,27 +216,85 @@ class odbc_t
 public:
   odbc_t();
   ~odbc_t();
-  int connect(const std::string& conn);
+  int connect(const std::string& conn, bool bulk_copy = false);
   int disconnect();
   int exec_direct(const std::string& sql);
   int fetch(const std::string& sql, table_t& table);
+  int fetch(const std::string& sql, typed_table_t& table);
+  int prepare(const std::string& sql);
+  int execute(const std::string& sql, const std::vector<param_t>& params);
+  int fetch(const std::string& sql, const std::vector<param_t>& params, table_t& table);
+  int fetch(const std::string& sql, const std::vector<param_t>& params, typed_table_t& table);
+  int fetch(const std::string& sql, const batch_visitor_t& visitor);
+  int fetch(const std::string& sql, const std::vector<param_t>& params, const batch_visitor_t& visitor);
+  int exec_direct_async(const std::string& sql, async_t& async);
+  int poll(async_t& async);
+  int cancel(async_t& async);
+  int fetch(async_t& async, table_t& table);
+  int fetch(async_t& async, typed_table_t& table);
+  int execute_batch(const std::string& sql, const std::vector<std::vector<param_t>>& rows, std::vector<SQLUSMALLINT>& row_status,
+    long long* nbr_affected = NULL);
   int set_auto_commit();
   int set_manual();
   int commit_transaction();
   int rollback_transaction();
+  int set_row_array_size(size_t row_array_size);
+  size_t get_row_array_size() const;
   SQLHENV m_henv; //environment handle
   SQLHDBC m_hdbc; //connection handle
 
 private:
   int get_version();
+  int fetch_result(SQLHSTMT hstmt, table_t& table);
+  int fetch_result(SQLHSTMT hstmt, typed_table_t& table, const batch_visitor_t* visitor = NULL);
+  size_t m_row_array_size; //rows per SQLFetch; 1 is the single-row loop, > 1 is a block cursor
+
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+  //statement cache
+  //statements prepared once with SQLPrepare, keyed by SQL text, re-executed with new parameter values
+  //'params' keeps the values bound with SQLBindParameter alive until the next execution
+  //a full cache frees the least recently used statement that has no open result
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+
+  struct stmt_t
+  {
+    SQLHSTMT hstmt;
+    std::vector<param_t> params;
+    unsigned long long last_use; //value of m_stmt_clock when last returned by get_statement
+    bool in_use; //executed and not yet closed (close_statement)
+  };
+  std::map<std::string, stmt_t*> m_stmt_cache;
+  unsigned long long m_stmt_clock;
+  stmt_t* get_statement(const std::string& sql);
+  stmt_t* execute_statement(const std::string& sql, const std::vector<param_t>& params);
+  void close_statement(stmt_t* stmt);
+  void free_statements();
+
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+  //instrumentation
+  //measurements of the statement being executed, added to the process-wide registry (stats.hh)
+  //by record() when the call returns; prepare_us is non zero only when the statement cache misses
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+
+  struct timing_t
+  {
+    long long prepare_us;
+    long long execute_us;
+    long long fetch_us;
+    long long rows; //rows fetched for queries, SQLRowCount otherwise
+    long long bytes_bound; //parameter bytes sent
+  };
+  timing_t m_timing;
+  void record(const std::string& sql, bool error);
 
   struct bind_column_data_t
   {
     SQLSMALLINT target_type; //the C data type of the result data
-    SQLPOINTER target_value_ptr; //pointer to storage for the data
+    SQLPOINTER target_value_ptr; //pointer to storage for the data, one buffer of buf_len for each row of the row array
     SQLINTEGER buf_len; //maximum length of the buffer being bound for data (including null-termination byte for char)
-    SQLLEN strlen_or_ind; //number of bytes(excluding the null termination byte for character data) available
+    SQLLEN* strlen_or_ind; //for each row of the row array, number of bytes(excluding the null termination byte for character data) available
     //to return in the buffer prior to calling SQLFetch
+    bool bound; //false for a long column and the columns after it, read with SQLGetData after each SQLFetch
   };
 };
 
@@ -104,6 +303,9 @@ private:
 /////////////////////////////////////////////////////////////////////////////////////////////////////
 
 void extract_error(SQLHANDLE handle, SQLSMALLINT type);
+std::string get_sql_state();
+void reset_sql_state();
+int wait_async(const std::vector<async_t*>& pending, int interval_ms = ODBC::ASYNC_POLL_MS);
 std::string make_conn(const std::string& server, const std::string& database, std::string user = std::string(),
   std::string password = std::string());
 
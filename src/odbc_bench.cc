@@ -0,0 +1,196 @@
+#include "odbc.hh"
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <cstdlib>
+#include <cstdio>
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// usage
+// same syntax as sqlcmd
+// -S localhost -d data_warehouse
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void usage(const char* program_name)
+{
+  std::cout << "Usage: " << program_name << " [OPTIONS]" << std::endl;
+  std::cout << std::endl;
+  std::cout << "Required options:" << std::endl;
+  std::cout << "  -S SERVER     SQL Server hostname or IP address" << std::endl;
+  std::cout << "  -d DATABASE   Database name" << std::endl;
+  std::cout << std::endl;
+  std::cout << "Optional options:" << std::endl;
+  std::cout << "  -U USER       SQL Server username (omit for trusted connection)" << std::endl;
+  std::cout << "  -P PASSWORD   SQL Server password" << std::endl;
+  std::cout << "  -q SQL        Query to fetch (default: full FactDailyStock history scan)" << std::endl;
+  std::cout << "  -n ROWS       Row array size of the block cursor (default: 1000)" << std::endl;
+  std::cout << "  -r COUNT      Number of runs of each mode, best time is reported (default: 3)" << std::endl;
+  std::cout << std::endl;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// bench_fetch
+// runs odbc_t::fetch 'runs' times with the given row array size
+// returns best elapsed seconds, number of rows in 'nbr_rows', -1 on error
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+double bench_fetch(odbc_t& odbc, const std::string& sql, size_t row_array_size, int runs, size_t& nbr_rows)
+{
+  double best = -1;
+  odbc.set_row_array_size(row_array_size);
+
+  for (int idx = 0; idx < runs; idx++)
+  {
+    table_t table;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if (odbc.fetch(sql, table) < 0)
+    {
+      return -1;
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    nbr_rows = table.rows.size();
+    if (best < 0 || elapsed.count() < best)
+    {
+      best = elapsed.count();
+    }
+  }
+  return best;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// bench_stream
+// runs the streaming odbc_t::fetch 'runs' times; the visitor only counts rows, at most one block
+// of 'row_array_size' rows is held in memory
+// returns best elapsed seconds, number of rows in 'nbr_rows', -1 on error
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+double bench_stream(odbc_t& odbc, const std::string& sql, size_t row_array_size, int runs, size_t& nbr_rows)
+{
+  double best = -1;
+  odbc.set_row_array_size(row_array_size);
+
+  for (int idx = 0; idx < runs; idx++)
+  {
+    size_t count = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if (odbc.fetch(sql, [&count](const typed_table_t& batch)
+      {
+        count += batch.nbr_rows;
+        return 0;
+      }) < 0)
+    {
+      return -1;
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    nbr_rows = count;
+    if (best < 0 || elapsed.count() < best)
+    {
+      best = elapsed.count();
+    }
+  }
+  return best;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// main
+// compares rows/s of the single-row SQLFetch loop against the block cursor, and of the
+// materialized block cursor against the streaming fetch
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char* argv[])
+{
+  std::string server;
+  std::string database;
+  std::string user;
+  std::string password;
+  std::string sql =
+    "SELECT c.Ticker, d.FullDate, f.OpenPrice, f.HighPrice, f.LowPrice, f.ClosePrice, "
+    "f.Volume, f.MarketCap/1e9 AS MarketCapB, f.DailyReturn "
+    "FROM FactDailyStock f "
+    "JOIN DimCompany c ON f.CompanyKey = c.CompanyKey "
+    "JOIN DimDate d ON f.DateKey = d.DateKey "
+    "WHERE c.IsCurrent = 1 "
+    "ORDER BY d.FullDate DESC, c.Ticker";
+  size_t row_array_size = ODBC::ROW_ARRAY_SIZE;
+  int runs = 3;
+
+  for (int idx = 1; idx < argc; idx++)
+  {
+    std::string arg = argv[idx];
+    if (arg == "-h" || arg == "--help")
+    {
+      usage(argv[0]);
+      return 0;
+    }
+    else if (arg == "-S" && idx + 1 < argc)
+    {
+      server = argv[++idx];
+    }
+    else if (arg == "-d" && idx + 1 < argc)
+    {
+      database = argv[++idx];
+    }
+    else if (arg == "-U" && idx + 1 < argc)
+    {
+      user = argv[++idx];
+    }
+    else if (arg == "-P" && idx + 1 < argc)
+    {
+      password = argv[++idx];
+    }
+    else if (arg == "-q" && idx + 1 < argc)
+    {
+      sql = argv[++idx];
+    }
+    else if (arg == "-n" && idx + 1 < argc)
+    {
+      row_array_size = static_cast<size_t>(atol(argv[++idx]));
+    }
+    else if (arg == "-r" && idx + 1 < argc)
+    {
+      runs = atoi(argv[++idx]);
+    }
+  }
+
+  if (server.empty() || database.empty() || row_array_size == 0 || runs <= 0)
+  {
+    usage(argv[0]);
+    return 1;
+  }
+
+  odbc_t odbc;
+  if (odbc.connect(make_conn(server, database, user, password)) < 0)
+  {
+    return 1;
+  }
+
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+  // single-row loop (row array size 1) against block cursor
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+
+  size_t rows_single = 0;
+  size_t rows_block = 0;
+  size_t rows_stream = 0;
+  double sec_single = bench_fetch(odbc, sql, 1, runs, rows_single);
+  double sec_block = bench_fetch(odbc, sql, row_array_size, runs, rows_block);
+  double sec_stream = bench_stream(odbc, sql, row_array_size, runs, rows_stream);
+  odbc.disconnect();
+
+  if (sec_single < 0 || sec_block < 0 || sec_stream < 0)
+  {
+    return 1;
+  }
+
+  printf("\n");
+  printf("%-14s %12s %12s %14s\n", "Mode", "Rows", "Seconds", "Rows/s");
+  printf("------------------------------------------------------\n");
+  printf("%-14s %12zu %12.4f %14.0f\n", "single-row", rows_single, sec_single, sec_single > 0 ? rows_single / sec_single : 0.0);
+  printf("block %-8zu %12zu %12.4f %14.0f\n", row_array_size, rows_block, sec_block, sec_block > 0 ? rows_block / sec_block : 0.0);
+  printf("stream %-7zu %12zu %12.4f %14.0f\n", row_array_size, rows_stream, sec_stream, sec_stream > 0 ? rows_stream / sec_stream : 0.0);
+  if (sec_block > 0)
+  {
+    printf("\nspeedup: %.2fx\n", sec_single / sec_block);
+  }
+
+  return 0;
+}
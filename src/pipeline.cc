@@ -0,0 +1,69 @@
+#include "pipeline.hh"
+#include "log.hh"
+#include <thread>
+#include <chrono>
+#include <cstdio>
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//stage_stats_t::stage_stats_t
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+stage_stats_t::stage_stats_t(const std::string& name) :
+  name(name),
+  items(0),
+  wall_us(0),
+  wait_us(0)
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//stage_stats_t::utilization
+//fraction of the stage run time not blocked on a queue, 0-1
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+double stage_stats_t::utilization() const
+{
+  if (wall_us <= 0)
+  {
+    return 0;
+  }
+  long long busy_us = wall_us > wait_us ? wall_us - wait_us : 0;
+  return static_cast<double>(busy_us) / wall_us;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//pipeline_backoff
+//one wait step of a stage blocked on a queue: yield first, then sleep so an idle stage does not
+//hold a core while the database works
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void pipeline_backoff(int& spins)
+{
+  if (spins < PIPELINE::SPIN_COUNT)
+  {
+    spins++;
+    std::this_thread::yield();
+  }
+  else
+  {
+    std::this_thread::sleep_for(std::chrono::microseconds(PIPELINE::SLEEP_US));
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//log_stages
+//one info message per stage: rows processed, run time, utilization; one message per line, so the
+//stages of concurrent pipelines (--jobs) do not interleave
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void log_stages(const char* component, const std::vector<stage_stats_t>& stages)
+{
+  char buf[256];
+  for (size_t idx = 0; idx < stages.size(); idx++)
+  {
+    const stage_stats_t& stage = stages[idx];
+    snprintf(buf, sizeof(buf), "Stage %-10s %10lld rows %10.1f ms %6.1f%% busy",
+      stage.name.c_str(), stage.items, stage.wall_us / 1000.0, stage.utilization() * 100.0);
+    LOG_INFO(component, buf);
+  }
+}
@@ -0,0 +1,141 @@
+#ifndef PIPELINE_HH
+#define PIPELINE_HH 1
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include "stats.hh"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//PIPELINE
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace PIPELINE
+{
+  //rows moved between stages in one queue item; amortizes the queue operations over many rows
+  const size_t CHUNK_ROWS = 256;
+
+  //chunks a queue holds before its producer blocks (back-pressure)
+  const size_t QUEUE_CHUNKS = 16;
+
+  //a blocked stage spins (yielding) this many times before it sleeps between checks
+  const int SPIN_COUNT = 64;
+  const int SLEEP_US = 100;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//stage_stats_t
+//counters of one pipeline stage, times in microseconds; 'wait_us' is the time blocked on an empty
+//input queue or a full output queue, the rest of 'wall_us' the stage was busy
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class stage_stats_t
+{
+public:
+  explicit stage_stats_t(const std::string& name);
+  std::string name;
+  long long items;
+  long long wall_us;
+  long long wait_us;
+
+  double utilization() const;
+};
+
+void pipeline_backoff(int& spins);
+void log_stages(const char* component, const std::vector<stage_stats_t>& stages);
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//spsc_queue_t
+//bounded lock-free queue between one producer thread and one consumer thread (ring buffer with
+//acquire/release head and tail indexes)
+//push blocks while the queue is full, so a fast stage is throttled to the speed of the next one
+//close: producer, no more items; pop returns false once the queue is drained
+//cancel: consumer, stop; a blocked or later push returns false
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+template <typename T>
+class spsc_queue_t
+{
+public:
+  explicit spsc_queue_t(size_t capacity) :
+    m_items(capacity + 1),
+    m_head(0),
+    m_tail(0),
+    m_closed(false),
+    m_cancelled(false)
+  {
+  }
+
+  bool push(T&& item, stage_stats_t& stats)
+  {
+    size_t tail = m_tail.load(std::memory_order_relaxed);
+    size_t next = (tail + 1) % m_items.size();
+    if (next == m_head.load(std::memory_order_acquire))
+    {
+      long long start = now_us();
+      int spins = 0;
+      while (next == m_head.load(std::memory_order_acquire))
+      {
+        if (m_cancelled.load(std::memory_order_acquire))
+        {
+          stats.wait_us += now_us() - start;
+          return false;
+        }
+        pipeline_backoff(spins);
+      }
+      stats.wait_us += now_us() - start;
+    }
+    if (m_cancelled.load(std::memory_order_acquire))
+    {
+      return false;
+    }
+
+    m_items[tail] = std::move(item);
+    m_tail.store(next, std::memory_order_release);
+    return true;
+  }
+
+  bool pop(T& item, stage_stats_t& stats)
+  {
+    size_t head = m_head.load(std::memory_order_relaxed);
+    if (head == m_tail.load(std::memory_order_acquire))
+    {
+      long long start = now_us();
+      int spins = 0;
+      while (head == m_tail.load(std::memory_order_acquire))
+      {
+        //the producer pushes its last item before it closes, check the tail again after 'closed'
+        if (m_closed.load(std::memory_order_acquire) && head == m_tail.load(std::memory_order_acquire))
+        {
+          stats.wait_us += now_us() - start;
+          return false;
+        }
+        pipeline_backoff(spins);
+      }
+      stats.wait_us += now_us() - start;
+    }
+
+    item = std::move(m_items[head]);
+    m_head.store((head + 1) % m_items.size(), std::memory_order_release);
+    return true;
+  }
+
+  void close()
+  {
+    m_closed.store(true, std::memory_order_release);
+  }
+
+  void cancel()
+  {
+    m_cancelled.store(true, std::memory_order_release);
+  }
+
+private:
+  std::vector<T> m_items;
+  alignas(64) std::atomic<size_t> m_head; //consumer index, own cache line
+  alignas(64) std::atomic<size_t> m_tail; //producer index, own cache line
+  std::atomic<bool> m_closed;
+  std::atomic<bool> m_cancelled;
+};
+
+#endif
@@ -0,0 +1,395 @@
+#include "pool.hh"
+#include "log.hh"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//pool_stats_t::pool_stats_t
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+pool_stats_t::pool_stats_t() :
+  nbr_acquire(0),
+  nbr_wait(0),
+  nbr_timeout(0),
+  nbr_created(0),
+  nbr_evicted(0),
+  nbr_broken(0),
+  total_wait_us(0),
+  max_wait_us(0),
+  nbr_open(0),
+  nbr_idle(0)
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//pool_t::pool_t
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+pool_t::pool_t() :
+  m_min_size(POOL::MIN_SIZE),
+  m_max_size(POOL::MAX_SIZE),
+  m_row_array_size(1),
+  m_nbr_open(0),
+  m_stopping(false)
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//pool_t::~pool_t
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+pool_t::~pool_t()
+{
+  stop();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//pool_t::start
+//opens 'min_size' connections; a failure here means the server is not reachable
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int pool_t::start(const std::string& conn, size_t min_size, size_t max_size)
+{
+  m_conn = conn;
+  m_min_size = min_size;
+  m_max_size = max_size < 1 ? 1 : max_size;
+  if (m_min_size > m_max_size)
+  {
+    m_min_size = m_max_size;
+  }
+
+  for (size_t idx = 0; idx < m_min_size; idx++)
+  {
+    odbc_t* odbc = open();
+    if (odbc == NULL)
+    {
+      stop();
+      return -1;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_nbr_open++;
+    m_stats.nbr_created++;
+    m_idle.push_back({ odbc, std::chrono::steady_clock::now() });
+  }
+
+  m_stopping = false;
+  m_reaper = std::thread(&pool_t::reap, this);
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//pool_t::stop
+//stops the reaper and closes idle connections; connections still checked out are closed when released
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void pool_t::stop()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stopping = true;
+  }
+  m_reaper_cond.notify_all();
+  if (m_reaper.joinable())
+  {
+    m_reaper.join();
+  }
+
+  std::vector<idle_t> idle;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    idle.swap(m_idle);
+    m_nbr_open -= idle.size();
+    m_min_size = 0;
+    m_max_size = 0;
+  }
+
+  for (size_t idx = 0; idx < idle.size(); idx++)
+  {
+    close(idle[idx].odbc);
+  }
+  m_cond.notify_all();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//pool_t::set_row_array_size
+//row array size of connections opened by the pool, see odbc_t::set_row_array_size
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void pool_t::set_row_array_size(size_t row_array_size)
+{
+  m_row_array_size = row_array_size;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//pool_t::acquire
+//returns an idle connection, opens a new one if fewer than 'max_size' are open, otherwise waits
+//until a connection is released; connections idle longer than POOL::HEALTH_CHECK_SECONDS are
+//checked with 'SELECT 1' and replaced if the check fails
+//a 'timeout_ms' of 0 does not wait: NULL is returned at once if every connection is checked out
+//returns NULL on timeout or if a new connection cannot be opened
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+odbc_t* pool_t::acquire(int timeout_ms)
+{
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  std::chrono::steady_clock::time_point deadline = start + std::chrono::milliseconds(timeout_ms);
+  std::vector<odbc_t*> evicted;
+  odbc_t* odbc = NULL;
+  bool waited = false;
+
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while (odbc == NULL)
+  {
+    evict_idle(evicted);
+
+    if (!m_idle.empty())
+    {
+      idle_t idle = m_idle.back();
+      m_idle.pop_back();
+      lock.unlock();
+
+      if (std::chrono::steady_clock::now() - idle.since > std::chrono::seconds(POOL::HEALTH_CHECK_SECONDS) &&
+        idle.odbc->exec_direct("SELECT 1") < 0)
+      {
+        close(idle.odbc);
+        lock.lock();
+        m_nbr_open--;
+        m_stats.nbr_broken++;
+        continue;
+      }
+
+      odbc = idle.odbc;
+      lock.lock();
+    }
+    else if (m_nbr_open < m_max_size)
+    {
+      //reserve the slot, the login is done without holding the lock
+      m_nbr_open++;
+      lock.unlock();
+      odbc = open();
+      lock.lock();
+      if (odbc == NULL)
+      {
+        m_nbr_open--;
+        m_cond.notify_one();
+        break;
+      }
+      m_stats.nbr_created++;
+    }
+    else if (timeout_ms == 0)
+    {
+      break;
+    }
+    else
+    {
+      waited = true;
+      if (m_cond.wait_until(lock, deadline) == std::cv_status::timeout && m_idle.empty() && m_nbr_open >= m_max_size)
+      {
+        break;
+      }
+    }
+  }
+
+  long long wait_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+  if (odbc == NULL && timeout_ms != 0)
+  {
+    m_stats.nbr_timeout++;
+  }
+  else
+  {
+    m_stats.nbr_acquire++;
+    m_stats.total_wait_us += wait_us;
+    if (wait_us > m_stats.max_wait_us)
+    {
+      m_stats.max_wait_us = wait_us;
+    }
+  }
+  if (waited)
+  {
+    m_stats.nbr_wait++;
+  }
+  lock.unlock();
+
+  for (size_t idx = 0; idx < evicted.size(); idx++)
+  {
+    close(evicted[idx]);
+  }
+  return odbc;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//pool_t::release
+//returns a connection to the pool; a 'broken' connection (failed query) is closed instead
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void pool_t::release(odbc_t* odbc, bool broken)
+{
+  if (odbc == NULL)
+  {
+    return;
+  }
+
+  std::vector<odbc_t*> evicted;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (broken || m_max_size == 0)
+    {
+      evicted.push_back(odbc);
+      m_nbr_open--;
+      if (broken)
+      {
+        m_stats.nbr_broken++;
+      }
+    }
+    else
+    {
+      m_idle.push_back({ odbc, std::chrono::steady_clock::now() });
+      evict_idle(evicted);
+    }
+  }
+  m_cond.notify_one();
+
+  for (size_t idx = 0; idx < evicted.size(); idx++)
+  {
+    close(evicted[idx]);
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//pool_t::get_stats
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+pool_stats_t pool_t::get_stats()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  pool_stats_t stats = m_stats;
+  stats.nbr_open = m_nbr_open;
+  stats.nbr_idle = m_idle.size();
+  return stats;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//pool_t::open
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+odbc_t* pool_t::open()
+{
+  odbc_t* odbc = new odbc_t;
+  if (odbc->connect(m_conn) < 0)
+  {
+    delete odbc;
+    return NULL;
+  }
+  odbc->set_row_array_size(m_row_array_size);
+  return odbc;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//pool_t::close
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void pool_t::close(odbc_t* odbc)
+{
+  odbc->disconnect();
+  delete odbc;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//pool_t::evict_idle
+//called with the lock held; moves connections above 'min_size' that are idle longer than
+//POOL::IDLE_TIMEOUT_SECONDS to 'evicted', the caller closes them after releasing the lock
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void pool_t::evict_idle(std::vector<odbc_t*>& evicted)
+{
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+  //oldest idle connections are at the front
+  while (!m_idle.empty() && m_nbr_open > m_min_size &&
+    now - m_idle.front().since > std::chrono::seconds(POOL::IDLE_TIMEOUT_SECONDS))
+  {
+    evicted.push_back(m_idle.front().odbc);
+    m_idle.erase(m_idle.begin());
+    m_nbr_open--;
+    m_stats.nbr_evicted++;
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//pool_t::reap
+//reaper thread: evicts idle connections every POOL::REAP_INTERVAL_SECONDS, so a pool that grew under
+//load shrinks back to 'min_size' after the load stops, when no acquire or release runs evict_idle
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void pool_t::reap()
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while (!m_stopping)
+  {
+    m_reaper_cond.wait_for(lock, std::chrono::seconds(POOL::REAP_INTERVAL_SECONDS));
+    if (m_stopping)
+    {
+      break;
+    }
+
+    std::vector<odbc_t*> evicted;
+    evict_idle(evicted);
+    if (evicted.empty())
+    {
+      continue;
+    }
+
+    lock.unlock();
+    for (size_t idx = 0; idx < evicted.size(); idx++)
+    {
+      close(evicted[idx]);
+    }
+    lock.lock();
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//connection_t::connection_t
+//'timeout_ms' as in pool_t::acquire; a connection not available at once (0) is not an error
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+connection_t::connection_t(pool_t& pool, int timeout_ms) :
+  odbc(NULL),
+  m_pool(pool),
+  m_broken(false)
+{
+  odbc = m_pool.acquire(timeout_ms);
+  if (odbc == NULL && timeout_ms != 0)
+  {
+    LOG_ERROR("pool", "No database connection available");
+  }
+  reset_sql_state();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//connection_t::~connection_t
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+connection_t::~connection_t()
+{
+  m_pool.release(odbc, m_broken);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//connection_t::set_broken
+//called after a failed call; the connection is closed on release instead of returned to the pool if
+//the error was a connection error, SQLSTATE class 08 (e.g. 08S01 communication link failure); a
+//statement error such as a constraint violation (23000) or a query timeout (HYT00) keeps it
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void connection_t::set_broken()
+{
+  std::string sql_state = get_sql_state();
+  if (sql_state.compare(0, 2, "08") == 0)
+  {
+    m_broken = true;
+  }
+  else
+  {
+    LOG_DEBUG("pool", "Connection kept after error " << sql_state);
+  }
+}
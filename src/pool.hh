@@ -0,0 +1,125 @@
+#ifndef POOL_HH
+#define POOL_HH 1
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include "odbc.hh"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//POOL
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace POOL
+{
+  //connections kept open by default
+  const size_t MIN_SIZE = 2;
+
+  //upper bound of open connections by default
+  const size_t MAX_SIZE = 16;
+
+  //connections above the minimum that are idle longer than this are closed
+  const int IDLE_TIMEOUT_SECONDS = 300;
+
+  //interval of the background check for idle connections, which also runs when no request comes
+  const int REAP_INTERVAL_SECONDS = 30;
+
+  //a connection idle longer than this is checked with 'SELECT 1' before it is handed out
+  const int HEALTH_CHECK_SECONDS = 30;
+
+  //acquire gives up after waiting this long for a free connection
+  const int ACQUIRE_TIMEOUT_MS = 10000;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//pool_stats_t
+//counters of a pool_t, wait times in microseconds
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class pool_stats_t
+{
+public:
+  pool_stats_t();
+  size_t nbr_acquire; //successful acquire calls
+  size_t nbr_wait; //acquire calls that waited for a connection released by another thread
+  size_t nbr_timeout; //acquire calls that gave up
+  size_t nbr_created; //connections opened
+  size_t nbr_evicted; //connections closed because idle
+  size_t nbr_broken; //connections closed because the health check or a query failed
+  long long total_wait_us;
+  long long max_wait_us;
+  size_t nbr_open;
+  size_t nbr_idle;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//pool_t
+//thread-safe pool of odbc_t connections to the same connection string
+//connections are opened lazily up to 'max_size'; 'min_size' connections are opened by start()
+//and are never evicted; callers hold a connection only for the duration of one unit of work
+//a reaper thread started by start() closes idle connections every POOL::REAP_INTERVAL_SECONDS
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class pool_t
+{
+public:
+  pool_t();
+  ~pool_t();
+  int start(const std::string& conn, size_t min_size = POOL::MIN_SIZE, size_t max_size = POOL::MAX_SIZE);
+  void stop();
+  void set_row_array_size(size_t row_array_size);
+  odbc_t* acquire(int timeout_ms = POOL::ACQUIRE_TIMEOUT_MS);
+  void release(odbc_t* odbc, bool broken = false);
+  pool_stats_t get_stats();
+
+private:
+  struct idle_t
+  {
+    odbc_t* odbc;
+    std::chrono::steady_clock::time_point since;
+  };
+  odbc_t* open();
+  void close(odbc_t* odbc);
+  void evict_idle(std::vector<odbc_t*>& evicted);
+  void reap();
+  std::string m_conn;
+  size_t m_min_size;
+  size_t m_max_size;
+  size_t m_row_array_size;
+  size_t m_nbr_open; //connections checked out, idle, or being opened
+  std::vector<idle_t> m_idle; //most recently released at the back
+  std::mutex m_mutex;
+  std::condition_variable m_cond;
+  pool_stats_t m_stats;
+  std::thread m_reaper;
+  std::condition_variable m_reaper_cond;
+  bool m_stopping;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//connection_t
+//borrows a connection from a pool_t for the lifetime of the object
+//'odbc' is NULL if no connection could be acquired
+//set_broken after a failed call closes the connection on release only if the error was a connection
+//error (SQLSTATE class 08), other errors leave it usable
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class connection_t
+{
+public:
+  connection_t(pool_t& pool, int timeout_ms = POOL::ACQUIRE_TIMEOUT_MS);
+  ~connection_t();
+  void set_broken();
+  odbc_t* odbc;
+
+private:
+  connection_t(const connection_t&) = delete;
+  connection_t& operator=(const connection_t&) = delete;
+  pool_t& m_pool;
+  bool m_broken;
+};
+
+#endif
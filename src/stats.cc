@@ -0,0 +1,342 @@
+#include "stats.hh"
+#include <map>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <iostream>
+#include <cstdio>
+#include <cctype>
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//registry of statement counters, keyed by shape
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static std::mutex stats_mutex;
+static std::map<std::string, stmt_stats_t> stats_map;
+static std::atomic<bool> stats_on(false);
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//periodic dump thread
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static std::thread dump_thread;
+static std::mutex dump_mutex;
+static std::condition_variable dump_cond;
+static bool dump_stop = false;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//stmt_stats_t::stmt_stats_t
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+stmt_stats_t::stmt_stats_t() :
+  nbr_calls(0),
+  nbr_errors(0),
+  prepare_us(0),
+  execute_us(0),
+  fetch_us(0),
+  max_us(0),
+  rows(0),
+  bytes_bound(0)
+{
+  for (int idx = 0; idx < STATS::NBR_BUCKETS; idx++)
+  {
+    histogram[idx] = 0;
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//stmt_stats_t::total_us
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+long long stmt_stats_t::total_us() const
+{
+  return prepare_us + execute_us + fetch_us;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//stmt_stats_t::percentile_us
+//upper bound of the histogram bucket that contains 'percent' (0-100) of the calls
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+long long stmt_stats_t::percentile_us(double percent) const
+{
+  long long count = 0;
+  long long target = static_cast<long long>(nbr_calls * percent / 100.0 + 0.5);
+  for (int idx = 0; idx < STATS::NBR_BUCKETS; idx++)
+  {
+    count += histogram[idx];
+    if (count >= target && count > 0)
+    {
+      return std::min(max_us, (1LL << (idx + 1)) - 1);
+    }
+  }
+  return max_us;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//now_us
+//monotonic clock in microseconds
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+long long now_us()
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//normalize_sql
+//shape of a statement: string literals ('AAPL', N'x') and numbers become '?', whitespace runs
+//become one space, so statements that differ only in their values are counted together
+//  SELECT 1 FROM DimDate WHERE DateKey=20251230  ->  SELECT ? FROM DimDate WHERE DateKey=?
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::string normalize_sql(const std::string& sql)
+{
+  std::string shape;
+  shape.reserve(sql.size());
+  size_t idx = 0;
+  size_t len = sql.size();
+
+  while (idx < len)
+  {
+    char c = sql[idx];
+    char prev = shape.empty() ? ' ' : shape.back();
+    bool prev_ident = isalnum((unsigned char)prev) || prev == '_' || prev == '@' || prev == '#';
+
+    if (c == '\'' || ((c == 'N' || c == 'n') && idx + 1 < len && sql[idx + 1] == '\'' && !prev_ident))
+    {
+      //string literal, '' is an escaped quote
+      idx += (c == '\'') ? 1 : 2;
+      while (idx < len)
+      {
+        if (sql[idx] == '\'')
+        {
+          if (idx + 1 < len && sql[idx + 1] == '\'')
+          {
+            idx += 2;
+            continue;
+          }
+          idx++;
+          break;
+        }
+        idx++;
+      }
+      shape += '?';
+    }
+    else if (isdigit((unsigned char)c) && !prev_ident)
+    {
+      //number, including decimals and exponents (1e9)
+      while (idx < len && (isalnum((unsigned char)sql[idx]) || sql[idx] == '.'))
+      {
+        idx++;
+      }
+      shape += '?';
+    }
+    else if (isspace((unsigned char)c))
+    {
+      while (idx < len && isspace((unsigned char)sql[idx]))
+      {
+        idx++;
+      }
+      if (!shape.empty())
+      {
+        shape += ' ';
+      }
+    }
+    else
+    {
+      shape += c;
+      idx++;
+    }
+  }
+
+  if (!shape.empty() && shape.back() == ' ')
+  {
+    shape.pop_back();
+  }
+  return shape;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//stats_enable
+//instrumentation is off by default; when off, stats_record returns without normalizing the statement
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void stats_enable(bool enable)
+{
+  stats_on = enable;
+}
+
+bool stats_enabled()
+{
+  return stats_on;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//stats_record
+//adds one call of 'sql' to the counters of its shape
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void stats_record(const std::string& sql, long long prepare_us, long long execute_us, long long fetch_us,
+  long long rows, long long bytes_bound, bool error)
+{
+  if (!stats_on)
+  {
+    return;
+  }
+
+  std::string shape = normalize_sql(sql);
+  long long total = prepare_us + execute_us + fetch_us;
+  int bucket = 0;
+  while (bucket < STATS::NBR_BUCKETS - 1 && (1LL << (bucket + 1)) <= total)
+  {
+    bucket++;
+  }
+
+  std::lock_guard<std::mutex> lock(stats_mutex);
+  stmt_stats_t& stats = stats_map[shape];
+  if (stats.shape.empty())
+  {
+    stats.shape = shape;
+  }
+  stats.nbr_calls++;
+  if (error)
+  {
+    stats.nbr_errors++;
+  }
+  stats.prepare_us += prepare_us;
+  stats.execute_us += execute_us;
+  stats.fetch_us += fetch_us;
+  stats.rows += rows;
+  stats.bytes_bound += bytes_bound;
+  stats.histogram[bucket]++;
+  if (total > stats.max_us)
+  {
+    stats.max_us = total;
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//stats_snapshot
+//copy of the counters of all shapes
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::vector<stmt_stats_t> stats_snapshot()
+{
+  std::vector<stmt_stats_t> snapshot;
+  std::lock_guard<std::mutex> lock(stats_mutex);
+  snapshot.reserve(stats_map.size());
+  for (std::map<std::string, stmt_stats_t>::const_iterator it = stats_map.begin(); it != stats_map.end(); ++it)
+  {
+    snapshot.push_back(it->second);
+  }
+  return snapshot;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//stats_reset
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void stats_reset()
+{
+  std::lock_guard<std::mutex> lock(stats_mutex);
+  stats_map.clear();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//stats_dump
+//prints the 'top' slowest statements (by total time) and the 'top' most frequent statements
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void dump_table(std::ostream& os, std::vector<stmt_stats_t>& snapshot, size_t top)
+{
+  char buf[512];
+  snprintf(buf, sizeof(buf), "%10s %6s %10s %9s %9s %9s %9s %10s %10s %9s %9s %9s  %s\n",
+    "Calls", "Errors", "Total ms", "Avg us", "p50 us", "p99 us", "Max us", "Rows", "Bytes",
+    "Prep ms", "Exec ms", "Fetch ms", "Statement");
+  os << buf;
+
+  for (size_t idx = 0; idx < snapshot.size() && idx < top; idx++)
+  {
+    const stmt_stats_t& stats = snapshot[idx];
+    std::string shape = stats.shape.size() > 100 ? stats.shape.substr(0, 97) + "..." : stats.shape;
+    snprintf(buf, sizeof(buf), "%10lld %6lld %10.1f %9lld %9lld %9lld %9lld %10lld %10lld %9.1f %9.1f %9.1f  ",
+      stats.nbr_calls, stats.nbr_errors, stats.total_us() / 1000.0,
+      stats.nbr_calls > 0 ? stats.total_us() / stats.nbr_calls : 0,
+      stats.percentile_us(50), stats.percentile_us(99), stats.max_us,
+      stats.rows, stats.bytes_bound,
+      stats.prepare_us / 1000.0, stats.execute_us / 1000.0, stats.fetch_us / 1000.0);
+    os << buf << shape << "\n";
+  }
+}
+
+void stats_dump(std::ostream& os, size_t top)
+{
+  std::vector<stmt_stats_t> snapshot = stats_snapshot();
+  if (snapshot.empty())
+  {
+    return;
+  }
+
+  std::sort(snapshot.begin(), snapshot.end(), [](const stmt_stats_t& a, const stmt_stats_t& b)
+    {
+      return a.total_us() > b.total_us();
+    });
+  os << "\nSlowest statements (total time)\n";
+  dump_table(os, snapshot, top);
+
+  std::sort(snapshot.begin(), snapshot.end(), [](const stmt_stats_t& a, const stmt_stats_t& b)
+    {
+      return a.nbr_calls > b.nbr_calls;
+    });
+  os << "\nMost frequent statements\n";
+  dump_table(os, snapshot, top);
+  os << std::flush;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//stats_start_dump
+//starts a thread that calls stats_dump to std::cout every 'interval_seconds'
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int stats_start_dump(int interval_seconds, size_t top)
+{
+  if (interval_seconds <= 0 || dump_thread.joinable())
+  {
+    return -1;
+  }
+
+  dump_stop = false;
+  dump_thread = std::thread([interval_seconds, top]()
+    {
+      std::unique_lock<std::mutex> lock(dump_mutex);
+      while (!dump_cond.wait_for(lock, std::chrono::seconds(interval_seconds), []() { return dump_stop; }))
+      {
+        stats_dump(std::cout, top);
+      }
+    });
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//stats_stop_dump
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void stats_stop_dump()
+{
+  if (!dump_thread.joinable())
+  {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(dump_mutex);
+    dump_stop = true;
+  }
+  dump_cond.notify_all();
+  dump_thread.join();
+}
@@ -0,0 +1,64 @@
+#ifndef STATS_HH
+#define STATS_HH 1
+
+#include <string>
+#include <vector>
+#include <ostream>
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//STATS
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace STATS
+{
+  //latency histogram buckets; bucket N counts calls of [2^N, 2^(N+1)) microseconds, the last bucket
+  //counts everything above
+  const int NBR_BUCKETS = 26;
+
+  //statements printed by stats_dump by default
+  const size_t DUMP_TOP = 10;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//stmt_stats_t
+//counters of one SQL shape: the statement text with literals replaced by '?'
+//times are in microseconds; 'rows' is rows fetched for queries and rows affected otherwise
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class stmt_stats_t
+{
+public:
+  stmt_stats_t();
+  std::string shape;
+  long long nbr_calls;
+  long long nbr_errors;
+  long long prepare_us;
+  long long execute_us;
+  long long fetch_us;
+  long long max_us;
+  long long rows;
+  long long bytes_bound;
+  long long histogram[STATS::NBR_BUCKETS];
+
+  long long total_us() const;
+  long long percentile_us(double percent) const;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//global functions
+//the registry is shared by all odbc_t connections of the process and is thread-safe
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::string normalize_sql(const std::string& sql);
+void stats_enable(bool enable);
+bool stats_enabled();
+void stats_record(const std::string& sql, long long prepare_us, long long execute_us, long long fetch_us,
+  long long rows, long long bytes_bound, bool error);
+std::vector<stmt_stats_t> stats_snapshot();
+void stats_reset();
+void stats_dump(std::ostream& os, size_t top = STATS::DUMP_TOP);
+int stats_start_dump(int interval_seconds, size_t top = STATS::DUMP_TOP);
+void stats_stop_dump();
+long long now_us();
+
+#endif
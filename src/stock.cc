@@ -7,6 +7,7 @@
 #include <cassert>
 #include "ssl_read.hh"
 #include "stock.hh"
+#include "csv_scan.hh"
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////
 // constants
@@ -19,7 +20,7 @@ static const std::string ALPHAVANTAGE_PORT = "443";
 // prototype declarations
 /////////////////////////////////////////////////////////////////////////////////////////////////////
 
-std::vector<std::string> split_csv_line(const std::string& line);
+std::string trim_field(std::string_view field);
 double safe_stod(const std::string& str);
 long long safe_stoll(const std::string& str);
 std::string get_market_cap_tier(long long market_cap);
@@ -60,14 +61,17 @@ int fetch_daily_stock(const std::string& api_key, const std::string& ticker,
     std::cout << response << std::endl;
   }
 
-  std::istringstream iss(response);
-  std::string line;
+  csv_tokenizer_t tokenizer;
+  tokenizer.reset(response.data(), response.size());
+  std::vector<std::string_view> row;
   bool first_line = true;
   int count = 0;
 
-  while (std::getline(iss, line) && count < limit)
+  while (count < limit)
   {
-    if (line.empty() || line[0] == '\r') continue;
+    row.clear();
+    if (tokenizer.next_row(row) == 0) break;
+    if (row.size() == 1 && trim_field(row[0]).empty()) continue;
 
     if (first_line)
     {
@@ -75,7 +79,11 @@ int fetch_daily_stock(const std::string& api_key, const std::string& ticker,
       continue;
     }
 
-    std::vector<std::string> fields = split_csv_line(line);
+    std::vector<std::string> fields;
+    for (size_t idx = 0; idx < row.size(); ++idx)
+    {
+      fields.push_back(trim_field(row[idx]));
+    }
     if (fields.size() < 5) continue;
 
     // CSV format: timestamp,open,high,low,close,volume
@@ -528,55 +536,19 @@ int export_financials_csv(const std::vector<FinancialStatement>& statements, con
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////
-// split_csv_line
-// splits a CSV line into fields, handling quoted fields with commas.
+// trim_field
+// copy of a CSV field without leading and trailing whitespace
 /////////////////////////////////////////////////////////////////////////////////////////////////////
 
-std::vector<std::string> split_csv_line(const std::string& line)
+std::string trim_field(std::string_view field)
 {
-  std::vector<std::string> fields;
-  std::string field;
-  bool in_quotes = false;
-
-  for (size_t idx = 0; idx < line.size(); ++idx)
-  {
-    char c = line[idx];
-    if (c == '"')
-    {
-      in_quotes = !in_quotes;
-    }
-    else if (c == ',' && !in_quotes)
-    {
-      size_t start = field.find_first_not_of(" \t\r\n");
-      size_t end = field.find_last_not_of(" \t\r\n");
-      if (start != std::string::npos)
-      {
-        fields.push_back(field.substr(start, end - start + 1));
-      }
-      else
-      {
-        fields.push_back("");
-      }
-      field.clear();
-    }
-    else
-    {
-      field += c;
-    }
-  }
-
   size_t start = field.find_first_not_of(" \t\r\n");
-  size_t end = field.find_last_not_of(" \t\r\n");
-  if (start != std::string::npos)
-  {
-    fields.push_back(field.substr(start, end - start + 1));
-  }
-  else
+  if (start == std::string_view::npos)
   {
-    fields.push_back("");
+    return std::string();
   }
-
-  return fields;
+  size_t end = field.find_last_not_of(" \t\r\n");
+  return std::string(field.substr(start, end - start + 1));
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////
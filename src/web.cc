@@ -1,4 +1,5 @@
 #include "web.hh"
+#include "log.hh"
 #include <Wt/WBreak.h>
 #include <Wt/WHBoxLayout.h>
 #include <Wt/WVBoxLayout.h>
@@ -25,6 +26,16 @@ static std::string server;
 static std::string database;
 static std::string user;
 static std::string password;
+static size_t pool_min = POOL::MIN_SIZE;
+static size_t pool_max = POOL::MAX_SIZE;
+static int stats_seconds = 0;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// connection pool shared by all sessions
+// a session borrows a connection for one query instead of keeping one open for its lifetime
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static pool_t pool;
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////
 // usage
@@ -39,6 +50,11 @@ void usage(const char* program_name)
   std::cout << "  -d DATABASE   Database name (required)" << std::endl;
   std::cout << "  -U USER       SQL Server username (omit for trusted connection)" << std::endl;
   std::cout << "  -P PASSWORD   SQL Server password" << std::endl;
+  std::cout << "  --pool-min N  Connections kept open in the pool (default: " << POOL::MIN_SIZE << ")" << std::endl;
+  std::cout << "  --pool-max N  Maximum connections in the pool (default: " << POOL::MAX_SIZE << ")" << std::endl;
+  std::cout << "  --stats N     Print the slowest and most frequent SQL statements every N seconds" << std::endl;
+  std::cout << "  --log SPEC    Log levels, e.g. 'info' or 'warn,pool=debug' (default: info)" << std::endl;
+  std::cout << "  --log-file FILE  Append log messages to FILE instead of stdout" << std::endl;
   std::cout << "  -h, --help    Display this help message and exit" << std::endl;
   std::cout << std::endl;
 }
@@ -58,6 +74,9 @@ std::unique_ptr<Wt::WApplication> create_application(const Wt::WEnvironment& env
 
 int main(int argc, char* argv[])
 {
+  std::string log_spec = "info";
+  std::string log_file;
+
   /////////////////////////////////////////////////////////////////////////////////////////////////////
   // parse command line 
   /////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -86,6 +105,26 @@ int main(int argc, char* argv[])
     {
       password = argv[++idx];
     }
+    else if (arg == "--pool-min" && idx + 1 < argc)
+    {
+      pool_min = static_cast<size_t>(atol(argv[++idx]));
+    }
+    else if (arg == "--pool-max" && idx + 1 < argc)
+    {
+      pool_max = static_cast<size_t>(atol(argv[++idx]));
+    }
+    else if (arg == "--stats" && idx + 1 < argc)
+    {
+      stats_seconds = atoi(argv[++idx]);
+    }
+    else if (arg == "--log" && idx + 1 < argc)
+    {
+      log_spec = argv[++idx];
+    }
+    else if (arg == "--log-file" && idx + 1 < argc)
+    {
+      log_file = argv[++idx];
+    }
   }
 
   /////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -130,23 +169,56 @@ int main(int argc, char* argv[])
   std::cout << "  Server:   " << server << std::endl;
   std::cout << "  Database: " << database << std::endl;
   std::cout << "  User:     " << (user.empty() ? "(trusted connection)" : user) << std::endl;
+  std::cout << "  Pool:     " << pool_min << "-" << pool_max << " connections" << std::endl;
   std::cout << std::endl;
 
-  std::string conn = make_conn(server, database, user, password);
-  odbc_t odbc;
-  if (odbc.connect(conn) != 0)
+  if (log_configure(log_spec) < 0 || log_start(log_file) < 0)
   {
-    std::cout << "Error: Cannot connect to database" << std::endl;
+    std::cout << "Error: invalid --log level or log file" << std::endl;
     return 1;
   }
 
-  odbc.disconnect();
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+  // open connection pool
+  // views scan FactDailyStock history, pooled connections fetch with a block cursor
+  /////////////////////////////////////////////////////////////////////////////////////////////////////
+
+  std::string conn = make_conn(server, database, user, password);
+  pool.set_row_array_size(ODBC::ROW_ARRAY_SIZE);
+  if (pool.start(conn, pool_min, pool_max) != 0)
+  {
+    LOG_ERROR("web", "Cannot connect to database");
+    return 1;
+  }
 
   /////////////////////////////////////////////////////////////////////////////////////////////////////
   // run Wt application
+  // with --stats, statement counters of all sessions are printed periodically and at exit
   /////////////////////////////////////////////////////////////////////////////////////////////////////
 
-  return Wt::WRun(argc, argv, &create_application);
+  if (stats_seconds > 0)
+  {
+    stats_enable(true);
+    stats_start_dump(stats_seconds);
+  }
+
+  int rc = Wt::WRun(argc, argv, &create_application);
+
+  log_flush();
+  if (stats_seconds > 0)
+  {
+    stats_stop_dump();
+    stats_dump(std::cout);
+  }
+
+  pool_stats_t stats = pool.get_stats();
+  std::cout << "Connection pool: " << stats.nbr_acquire << " acquired, "
+    << stats.nbr_wait << " waited, " << stats.nbr_timeout << " timed out, "
+    << stats.nbr_created << " opened, " << stats.nbr_evicted << " evicted, " << stats.nbr_broken << " broken, "
+    << "average wait " << (stats.nbr_acquire > 0 ? stats.total_wait_us / (long long)stats.nbr_acquire : 0) << " us, "
+    << "max wait " << stats.max_wait_us << " us" << std::endl;
+  pool.stop();
+  return rc;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -158,16 +230,6 @@ WApplicationFinmart::WApplicationFinmart(const Wt::WEnvironment& env)
 {
   setTitle("FinMart Data Warehouse");
 
-  /////////////////////////////////////////////////////////////////////////////////////////////////////
-  // connect to database
-  /////////////////////////////////////////////////////////////////////////////////////////////////////
-
-  if (!connect_database())
-  {
-    root()->addWidget(std::make_unique<Wt::WText>("Error: Cannot connect to database"));
-    return;
-  }
-
   /////////////////////////////////////////////////////////////////////////////////////////////////////
   // setup UI
   /////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -192,17 +254,45 @@ WApplicationFinmart::WApplicationFinmart(const Wt::WEnvironment& env)
 
 WApplicationFinmart::~WApplicationFinmart()
 {
-  odbc.disconnect();
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////
-// WApplicationFinmart::connect_database
+// WApplicationFinmart::fetch
+// borrows a pooled connection for one query; statements are prepared and cached per connection,
+// so the plan is reused by every session that gets the same connection
+// a connection whose query fails with a connection error is closed instead of returned to the pool
 /////////////////////////////////////////////////////////////////////////////////////////////////////
 
-bool WApplicationFinmart::connect_database()
+int WApplicationFinmart::fetch(const std::string& sql, table_t& table, const std::vector<param_t>& params)
 {
-  std::string conn = make_conn(server, database, user, password);
-  return odbc.connect(conn) == 0;
+  connection_t conn(pool);
+  if (conn.odbc == NULL)
+  {
+    return -1;
+  }
+
+  if (conn.odbc->fetch(sql, params, table) < 0)
+  {
+    conn.set_broken();
+    return -1;
+  }
+  return 0;
+}
+
+int WApplicationFinmart::fetch(const std::string& sql, typed_table_t& table, const std::vector<param_t>& params)
+{
+  connection_t conn(pool);
+  if (conn.odbc == NULL)
+  {
+    return -1;
+  }
+
+  if (conn.odbc->fetch(sql, params, table) < 0)
+  {
+    conn.set_broken();
+    return -1;
+  }
+  return 0;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -297,26 +387,18 @@ void WApplicationFinmart::setup_dashboard()
 
   Wt::WContainerWidget* row = dashboard_view->addWidget(std::make_unique<Wt::WContainerWidget>());
 
-  table_t tbl;
-
   /////////////////////////////////////////////////////////////////////////////////////////////////////
   // sector breakdown
   //
   // SQL:
-  //   SELECT c.Sector, COUNT(DISTINCT c.Ticker) AS Companies,
-  //     SUM(f.MarketCap)/1e12 AS TotalMarketCapT
-  //   FROM FactDailyStock f
-  //   JOIN DimCompany c ON f.CompanyKey = c.CompanyKey
-  //   WHERE c.IsCurrent = 1
-  //     AND f.DateKey = (SELECT MAX(DateKey) FROM FactDailyStock)
-  //   GROUP BY c.Sector
+  //   SELECT Sector, Companies, TotalMarketCap/1e12 AS TotalMarketCapT
+  //   FROM FactSectorDaily
+  //   WHERE DateKey = (SELECT MAX(DateKey) FROM FactSectorDaily)
   //   ORDER BY TotalMarketCapT DESC
   //
   // notes:
-  //   - joins fact table with company dimension on surrogate key
-  //   - filters for current company records (SCD Type 2)
-  //   - uses subquery to get most recent trading day
-  //   - aggregates at sector level with COUNT and SUM
+  //   - reads the sector/day aggregate table the ETL maintains, one row per sector of the most
+  //     recent trading day instead of a scan and GROUP BY of FactDailyStock
   //   - market cap converted to trillions (1e12)
   /////////////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -332,27 +414,21 @@ void WApplicationFinmart::setup_dashboard()
   add_header_cell(sector_table, 0, 2, "Total Cap");
 
   std::string sql_sector =
-    "SELECT c.Sector, COUNT(DISTINCT c.Ticker) AS Companies, SUM(f.MarketCap)/1e12 AS TotalMarketCapT "
-    "FROM FactDailyStock f "
-    "JOIN DimCompany c ON f.CompanyKey = c.CompanyKey "
-    "WHERE c.IsCurrent = 1 "
-    "AND f.DateKey = (SELECT MAX(DateKey) FROM FactDailyStock) "
-    "GROUP BY c.Sector "
+    "SELECT Sector, Companies, TotalMarketCap/1e12 AS TotalMarketCapT "
+    "FROM FactSectorDaily "
+    "WHERE DateKey = (SELECT MAX(DateKey) FROM FactSectorDaily) "
     "ORDER BY TotalMarketCapT DESC";
 
-  if (odbc.fetch(sql_sector, tbl) == 0)
+  //both dashboard queries run at the same time on two pooled connections, the page waits for the
+  //slower one instead of the sum of both; statements are freed before the connections are released
+  //the second connection is taken only if one is free at once: a session holding one connection must
+  //not wait for another, or sessions that each hold one could wait on each other until the timeout;
+  //without it the second query runs after the first on the same connection
+  connection_t conn_sector(pool);
+  async_t async_sector;
+  if (conn_sector.odbc != NULL)
   {
-    for (int idx = 0; idx < (int)tbl.rows.size(); idx++)
-    {
-      int row = idx + 1;
-      std::string sector = tbl.get_row_col_value(idx, "Sector");
-      std::string cnt = tbl.get_row_col_value(idx, "Companies");
-      std::string total = tbl.get_row_col_value(idx, "TotalMarketCapT");
-
-      add_cell(sector_table, row, 0, sector);
-      add_cell(sector_table, row, 1, cnt);
-      add_currency_cell(sector_table, row, 2, total, "T");
-    }
+    conn_sector.odbc->exec_direct_async(sql_sector, async_sector);
   }
 
   /////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -399,23 +475,66 @@ void WApplicationFinmart::setup_dashboard()
     "WHERE c.IsCurrent = 1 "
     "ORDER BY c.Ticker";
 
-  if (odbc.fetch(sql_all, tbl) == 0)
+  connection_t conn_all(pool, 0);
+  async_t async_all;
+  if (conn_all.odbc != NULL)
   {
-    for (int idx = 0; idx < (int)tbl.rows.size(); idx++)
+    conn_all.odbc->exec_direct_async(sql_all, async_all);
+  }
+
+  wait_async({ &async_sector, &async_all });
+
+  //a statement that failed to start or to execute fails its fetch; set_broken closes its connection
+  //on a connection error
+  typed_table_t typed;
+  int rc_sector = conn_sector.odbc != NULL ? conn_sector.odbc->fetch(async_sector, typed) : -1;
+  if (rc_sector < 0 && conn_sector.odbc != NULL)
+  {
+    conn_sector.set_broken();
+  }
+  if (rc_sector == 0)
+  {
+    const typed_column_t& sector = typed.col("Sector");
+    const typed_column_t& cnt = typed.col("Companies");
+    const typed_column_t& total = typed.col("TotalMarketCapT");
+    for (int idx = 0; idx < (int)typed.nbr_rows; idx++)
     {
       int row = idx + 1;
-      std::string ticker = tbl.get_row_col_value(idx, "Ticker");
-      std::string name = tbl.get_row_col_value(idx, "CompanyName");
-      std::string sector = tbl.get_row_col_value(idx, "Sector");
-      std::string industry = tbl.get_row_col_value(idx, "Industry");
-      std::string mcap = tbl.get_row_col_value(idx, "MarketCapB");
+      add_cell(sector_table, row, 0, sector.to_string(idx));
+      add_cell(sector_table, row, 1, cnt.to_string(idx));
+      add_currency_cell(sector_table, row, 2, total, idx, "T");
+    }
+  }
 
+  connection_t* conn_used = &conn_all;
+  if (conn_all.odbc == NULL && rc_sector == 0)
+  {
+    conn_used = &conn_sector;
+    conn_sector.odbc->exec_direct_async(sql_all, async_all);
+    wait_async({ &async_all });
+  }
+
+  int rc_all = conn_used->odbc != NULL ? conn_used->odbc->fetch(async_all, typed) : -1;
+  if (rc_all < 0 && conn_used->odbc != NULL)
+  {
+    conn_used->set_broken();
+  }
+  if (rc_all == 0)
+  {
+    const typed_column_t& ticker = typed.col("Ticker");
+    const typed_column_t& name = typed.col("CompanyName");
+    const typed_column_t& sector = typed.col("Sector");
+    const typed_column_t& industry = typed.col("Industry");
+    const typed_column_t& mcap = typed.col("MarketCapB");
+    for (int idx = 0; idx < (int)typed.nbr_rows; idx++)
+    {
+      int row = idx + 1;
       add_cell(all_table, row, 0, std::to_string(row));
-      add_cell(all_table, row, 1, ticker);
-      add_cell(all_table, row, 2, name);
-      add_cell(all_table, row, 3, sector);
-      add_cell(all_table, row, 4, industry);
-      add_currency_cell(all_table, row, 5, mcap, "B");
+      add_cell(all_table, row, 1, ticker.to_string(idx));
+      add_cell(all_table, row, 2, name.to_string(idx));
+      add_cell(all_table, row, 3, sector.to_string(idx));
+      add_cell(all_table, row, 4, industry.to_string(idx));
+      add_currency_cell(all_table, row, 5, mcap, idx, "B");
     }
   }
 }
@@ -463,7 +582,7 @@ void WApplicationFinmart::setup_companies()
 
   std::string sql = "SELECT DISTINCT Sector FROM DimCompany WHERE IsCurrent=1 ORDER BY Sector";
   table_t table;
-  if (odbc.fetch(sql, table) == 0)
+  if (fetch(sql, table) == 0)
   {
     for (int idx = 0; idx < (int)table.rows.size(); idx++)
     {
@@ -523,7 +642,7 @@ void WApplicationFinmart::setup_stocks()
 
   std::string sql = "SELECT Ticker, CompanyName FROM DimCompany WHERE IsCurrent=1 ORDER BY Ticker";
   table_t table;
-  if (odbc.fetch(sql, table) == 0)
+  if (fetch(sql, table) == 0)
   {
     for (int idx = 0; idx < (int)table.rows.size(); idx++)
     {
@@ -587,13 +706,13 @@ void WApplicationFinmart::load_dashboard()
 //   SELECT Ticker, CompanyName, Sector, Industry, CEO, Headquarters, Employees, MarketCapTier
 //   FROM DimCompany
 //   WHERE IsCurrent=1
-//     AND Sector='Technology'  -- optional, based on filter selection
+//     AND Sector=?  -- optional, bound to the filter selection
 //   ORDER BY Ticker
 //
 // notes:
 //   - queries DimCompany dimension table directly
 //   - filters for current records (SCD Type 2)
-//   - optional Sector filter added dynamically based on UI selection
+//   - optional Sector filter is a parameter marker, each variant is a cached prepared statement
 //   - ordered alphabetically by ticker symbol
 /////////////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -614,15 +733,17 @@ void WApplicationFinmart::load_companies()
   sql << "SELECT Ticker, CompanyName, Sector, Industry, CEO, Headquarters, Employees, MarketCapTier "
     << "FROM DimCompany WHERE IsCurrent=1 ";
 
+  std::vector<param_t> params;
   if (sector_filter->currentIndex() > 0)
   {
-    sql << "AND Sector='" << sector_filter->currentText().toUTF8() << "' ";
+    sql << "AND Sector=? ";
+    params.push_back(sector_filter->currentText().toUTF8());
   }
 
   sql << "ORDER BY Ticker";
 
   table_t table;
-  if (odbc.fetch(sql.str(), table) == 0)
+  if (fetch(sql.str(), table, params) == 0)
   {
     for (int idx = 0; idx < (int)table.rows.size(); idx++)
     {
@@ -651,7 +772,7 @@ void WApplicationFinmart::load_companies()
 //   JOIN DimCompany c ON f.CompanyKey = c.CompanyKey
 //   JOIN DimDate d ON f.DateKey = d.DateKey
 //   WHERE c.IsCurrent = 1
-//     AND c.Ticker='AAPL'  -- optional, based on filter selection
+//     AND c.Ticker=?  -- optional, bound to the filter selection
 //   ORDER BY d.FullDate DESC, c.Ticker
 //
 // notes:
@@ -684,29 +805,40 @@ void WApplicationFinmart::load_stocks()
     << "JOIN DimDate d ON f.DateKey = d.DateKey "
     << "WHERE c.IsCurrent = 1 ";
 
+  std::vector<param_t> params;
   if (company_filter->currentIndex() > 0)
   {
-    sql << "AND c.Ticker='" << company_filter->currentText().toUTF8() << "' ";
+    sql << "AND c.Ticker=? ";
+    params.push_back(company_filter->currentText().toUTF8());
   }
 
   sql << "ORDER BY d.FullDate DESC, c.Ticker";
 
-  table_t table;
-  if (odbc.fetch(sql.str(), table) == 0)
+  typed_table_t table;
+  if (fetch(sql.str(), table, params) == 0)
   {
-    for (int idx = 0; idx < (int)table.rows.size(); idx++)
+    const typed_column_t& col_ticker = table.col("Ticker");
+    const typed_column_t& col_full_date = table.col("FullDate");
+    const typed_column_t& col_open = table.col("OpenPrice");
+    const typed_column_t& col_high = table.col("HighPrice");
+    const typed_column_t& col_low = table.col("LowPrice");
+    const typed_column_t& col_close = table.col("ClosePrice");
+    const typed_column_t& col_volume = table.col("Volume");
+    const typed_column_t& col_market_cap = table.col("MarketCapB");
+    const typed_column_t& col_daily_return = table.col("DailyReturn");
+    for (int idx = 0; idx < (int)table.nbr_rows; idx++)
     {
       int row = idx + 1;
 
-      add_cell(stocks_table, row, 0, table.get_row_col_value(idx, "Ticker"));
-      add_cell(stocks_table, row, 1, table.get_row_col_value(idx, "FullDate"));
-      add_currency_cell(stocks_table, row, 2, table.get_row_col_value(idx, "OpenPrice"));
-      add_currency_cell(stocks_table, row, 3, table.get_row_col_value(idx, "HighPrice"));
-      add_currency_cell(stocks_table, row, 4, table.get_row_col_value(idx, "LowPrice"));
-      add_currency_cell(stocks_table, row, 5, table.get_row_col_value(idx, "ClosePrice"));
-      add_number_cell(stocks_table, row, 6, table.get_row_col_value(idx, "Volume"));
-      add_currency_cell(stocks_table, row, 7, table.get_row_col_value(idx, "MarketCapB"), "B");
-      add_percent_cell(stocks_table, row, 8, table.get_row_col_value(idx, "DailyReturn"));
+      add_cell(stocks_table, row, 0, col_ticker.to_string(idx));
+      add_cell(stocks_table, row, 1, col_full_date.to_string(idx));
+      add_currency_cell(stocks_table, row, 2, col_open, idx);
+      add_currency_cell(stocks_table, row, 3, col_high, idx);
+      add_currency_cell(stocks_table, row, 4, col_low, idx);
+      add_currency_cell(stocks_table, row, 5, col_close, idx);
+      add_number_cell(stocks_table, row, 6, col_volume, idx);
+      add_currency_cell(stocks_table, row, 7, col_market_cap, idx, "B");
+      add_percent_cell(stocks_table, row, 8, col_daily_return, idx);
     }
   }
 }
@@ -759,21 +891,29 @@ void WApplicationFinmart::load_financials()
     "AND ff.DateKey = (SELECT MAX(ff2.DateKey) FROM FactFinancials ff2 WHERE ff2.CompanyKey = ff.CompanyKey) "
     "ORDER BY ff.Revenue DESC";
 
-  table_t table;
-  if (odbc.fetch(sql, table) == 0)
+  typed_table_t table;
+  if (fetch(sql, table) == 0)
   {
-    for (int idx = 0; idx < (int)table.rows.size(); idx++)
+    const typed_column_t& col_ticker = table.col("Ticker");
+    const typed_column_t& col_company_name = table.col("CompanyName");
+    const typed_column_t& col_revenue = table.col("RevenueB");
+    const typed_column_t& col_net_income = table.col("NetIncomeB");
+    const typed_column_t& col_gross_margin = table.col("GrossMargin");
+    const typed_column_t& col_net_margin = table.col("NetMargin");
+    const typed_column_t& col_roe = table.col("ROE");
+    const typed_column_t& col_roa = table.col("ROA");
+    for (int idx = 0; idx < (int)table.nbr_rows; idx++)
     {
       int row = idx + 1;
 
-      add_cell(financials_table, row, 0, table.get_row_col_value(idx, "Ticker"));
-      add_cell(financials_table, row, 1, table.get_row_col_value(idx, "CompanyName"));
-      add_currency_cell(financials_table, row, 2, table.get_row_col_value(idx, "RevenueB"), "B");
-      add_currency_cell(financials_table, row, 3, table.get_row_col_value(idx, "NetIncomeB"), "B");
-      add_percent_cell(financials_table, row, 4, table.get_row_col_value(idx, "GrossMargin"));
-      add_percent_cell(financials_table, row, 5, table.get_row_col_value(idx, "NetMargin"));
-      add_percent_cell(financials_table, row, 6, table.get_row_col_value(idx, "ROE"));
-      add_percent_cell(financials_table, row, 7, table.get_row_col_value(idx, "ROA"));
+      add_cell(financials_table, row, 0, col_ticker.to_string(idx));
+      add_cell(financials_table, row, 1, col_company_name.to_string(idx));
+      add_currency_cell(financials_table, row, 2, col_revenue, idx, "B");
+      add_currency_cell(financials_table, row, 3, col_net_income, idx, "B");
+      add_percent_cell(financials_table, row, 4, col_gross_margin, idx);
+      add_percent_cell(financials_table, row, 5, col_net_margin, idx);
+      add_percent_cell(financials_table, row, 6, col_roe, idx);
+      add_percent_cell(financials_table, row, 7, col_roa, idx);
     }
   }
 }
@@ -833,19 +973,25 @@ void WApplicationFinmart::load_sectors()
     "GROUP BY c.Sector "
     "ORDER BY TotalMarketCapT DESC";
 
-  table_t table;
-  if (odbc.fetch(sql, table) == 0)
+  typed_table_t table;
+  if (fetch(sql, table) == 0)
   {
-    for (int idx = 0; idx < (int)table.rows.size(); idx++)
+    const typed_column_t& col_sector = table.col("Sector");
+    const typed_column_t& col_companies = table.col("Companies");
+    const typed_column_t& col_total_market_cap = table.col("TotalMarketCapT");
+    const typed_column_t& col_avg_revenue = table.col("AvgRevenueB");
+    const typed_column_t& col_avg_gross_margin = table.col("AvgGrossMargin");
+    const typed_column_t& col_avg_net_margin = table.col("AvgNetMargin");
+    for (int idx = 0; idx < (int)table.nbr_rows; idx++)
     {
       int row = idx + 1;
 
-      add_cell(sectors_table, row, 0, table.get_row_col_value(idx, "Sector"));
-      add_cell(sectors_table, row, 1, table.get_row_col_value(idx, "Companies"));
-      add_currency_cell(sectors_table, row, 2, table.get_row_col_value(idx, "TotalMarketCapT"), "T");
-      add_currency_cell(sectors_table, row, 3, table.get_row_col_value(idx, "AvgRevenueB"), "B");
-      add_percent_cell(sectors_table, row, 4, table.get_row_col_value(idx, "AvgGrossMargin"));
-      add_percent_cell(sectors_table, row, 5, table.get_row_col_value(idx, "AvgNetMargin"));
+      add_cell(sectors_table, row, 0, col_sector.to_string(idx));
+      add_cell(sectors_table, row, 1, col_companies.to_string(idx));
+      add_currency_cell(sectors_table, row, 2, col_total_market_cap, idx, "T");
+      add_currency_cell(sectors_table, row, 3, col_avg_revenue, idx, "B");
+      add_percent_cell(sectors_table, row, 4, col_avg_gross_margin, idx);
+      add_percent_cell(sectors_table, row, 5, col_avg_net_margin, idx);
     }
   }
 }
@@ -927,34 +1073,17 @@ void WApplicationFinmart::add_cell(Wt::WTable* table, int row, int col, const st
 
 void WApplicationFinmart::add_number_cell(Wt::WTable* table, int row, int col, const std::string& text)
 {
-  Wt::WTableCell* cell = table->elementAt(row, col);
-
   std::string formatted = text;
   try
   {
     double value = std::stod(text);
-    std::stringstream ss;
-    ss << std::fixed << std::setprecision(1) << value;
-    formatted = ss.str();
+    formatted = format_number(value);
   }
   catch (...)
   {
   }
 
-  Wt::WText* txt = cell->addWidget(std::make_unique<Wt::WText>(formatted));
-
-  Wt::WCssDecorationStyle cell_style;
-  if (row % 2 == 0)
-  {
-    cell_style.setBackgroundColor(Wt::WColor(210, 210, 210));
-  }
-  else
-  {
-    cell_style.setBackgroundColor(Wt::WColor(230, 230, 230));
-  }
-  cell_style.setForegroundColor(Wt::WColor(0, 123, 255));
-  cell->setDecorationStyle(cell_style);
-  cell->setPadding(Wt::WLength(6, Wt::LengthUnit::Pixel));
+  add_styled_cell(table, row, col, formatted, Wt::WColor(0, 123, 255));
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -963,34 +1092,17 @@ void WApplicationFinmart::add_number_cell(Wt::WTable* table, int row, int col, c
 
 void WApplicationFinmart::add_currency_cell(Wt::WTable* table, int row, int col, const std::string& text, const std::string& suffix)
 {
-  Wt::WTableCell* cell = table->elementAt(row, col);
-
   std::string formatted = "$" + text + suffix;
   try
   {
     double value = std::stod(text);
-    std::stringstream ss;
-    ss << "$" << std::fixed << std::setprecision(1) << value << suffix;
-    formatted = ss.str();
+    formatted = format_currency(value, suffix);
   }
   catch (...)
   {
   }
 
-  Wt::WText* txt = cell->addWidget(std::make_unique<Wt::WText>(formatted));
-
-  Wt::WCssDecorationStyle cell_style;
-  if (row % 2 == 0)
-  {
-    cell_style.setBackgroundColor(Wt::WColor(210, 210, 210));
-  }
-  else
-  {
-    cell_style.setBackgroundColor(Wt::WColor(230, 230, 230));
-  }
-  cell_style.setForegroundColor(Wt::WColor(40, 167, 69));
-  cell->setDecorationStyle(cell_style);
-  cell->setPadding(Wt::WLength(6, Wt::LengthUnit::Pixel));
+  add_styled_cell(table, row, col, formatted, Wt::WColor(40, 167, 69));
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -999,21 +1111,71 @@ void WApplicationFinmart::add_currency_cell(Wt::WTable* table, int row, int col,
 
 void WApplicationFinmart::add_percent_cell(Wt::WTable* table, int row, int col, const std::string& text)
 {
-  Wt::WTableCell* cell = table->elementAt(row, col);
-
   std::string formatted = text + "%";
   try
   {
     double value = std::stod(text);
-    std::stringstream ss;
-    ss << std::fixed << std::setprecision(1) << value << "%";
-    formatted = ss.str();
+    formatted = format_percent(value);
   }
   catch (...)
   {
   }
 
-  Wt::WText* txt = cell->addWidget(std::make_unique<Wt::WText>(formatted));
+  add_styled_cell(table, row, col, formatted, Wt::WColor(111, 66, 193));
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// WApplicationFinmart::add_number_cell
+// typed column value, no text parsing; NULL is shown as before (ODBC::SQL_NULL)
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void WApplicationFinmart::add_number_cell(Wt::WTable* table, int row, int col, const typed_column_t& column, size_t idx)
+{
+  if (column.is_null(idx) || !column.is_number())
+  {
+    add_number_cell(table, row, col, column.to_string(idx));
+    return;
+  }
+  add_styled_cell(table, row, col, format_number(column.get_double(idx)), Wt::WColor(0, 123, 255));
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// WApplicationFinmart::add_currency_cell
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void WApplicationFinmart::add_currency_cell(Wt::WTable* table, int row, int col, const typed_column_t& column, size_t idx, const std::string& suffix)
+{
+  if (column.is_null(idx) || !column.is_number())
+  {
+    add_currency_cell(table, row, col, column.to_string(idx), suffix);
+    return;
+  }
+  add_styled_cell(table, row, col, format_currency(column.get_double(idx), suffix), Wt::WColor(40, 167, 69));
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// WApplicationFinmart::add_percent_cell
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void WApplicationFinmart::add_percent_cell(Wt::WTable* table, int row, int col, const typed_column_t& column, size_t idx)
+{
+  if (column.is_null(idx) || !column.is_number())
+  {
+    add_percent_cell(table, row, col, column.to_string(idx));
+    return;
+  }
+  add_styled_cell(table, row, col, format_percent(column.get_double(idx)), Wt::WColor(111, 66, 193));
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// WApplicationFinmart::add_styled_cell
+// value cell with alternating row background and a foreground color
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void WApplicationFinmart::add_styled_cell(Wt::WTable* table, int row, int col, const std::string& text, const Wt::WColor& color)
+{
+  Wt::WTableCell* cell = table->elementAt(row, col);
+  Wt::WText* txt = cell->addWidget(std::make_unique<Wt::WText>(text));
 
   Wt::WCssDecorationStyle cell_style;
   if (row % 2 == 0)
@@ -1024,7 +1186,7 @@ void WApplicationFinmart::add_percent_cell(Wt::WTable* table, int row, int col,
   {
     cell_style.setBackgroundColor(Wt::WColor(230, 230, 230));
   }
-  cell_style.setForegroundColor(Wt::WColor(111, 66, 193));
+  cell_style.setForegroundColor(color);
   cell->setDecorationStyle(cell_style);
   cell->setPadding(Wt::WLength(6, Wt::LengthUnit::Pixel));
 }
@@ -12,11 +12,13 @@
 #include <Wt/WPushButton.h>
 #include <Wt/WLineEdit.h>
 #include <Wt/WTemplate.h>
+#include <Wt/WColor.h>
 #include <string>
 #include <vector>
 #include <memory>
 
 #include "odbc.hh"
+#include "pool.hh"
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////
 // WApplicationFinmart
@@ -29,8 +31,6 @@ public:
   ~WApplicationFinmart();
 
 private:
-  odbc_t odbc;
-
   Wt::WNavigationBar* navbar;
   Wt::WStackedWidget* contents;
   Wt::WMenu* menu;
@@ -66,12 +66,17 @@ private:
   void on_company_changed();
   void on_refresh_clicked();
 
-  bool connect_database();
+  int fetch(const std::string& sql, table_t& table, const std::vector<param_t>& params = std::vector<param_t>());
+  int fetch(const std::string& sql, typed_table_t& table, const std::vector<param_t>& params = std::vector<param_t>());
   void add_header_cell(Wt::WTable* table, int row, int col, const std::string& text);
   void add_cell(Wt::WTable* table, int row, int col, const std::string& text);
   void add_number_cell(Wt::WTable* table, int row, int col, const std::string& text);
   void add_currency_cell(Wt::WTable* table, int row, int col, const std::string& text, const std::string& suffix = "");
   void add_percent_cell(Wt::WTable* table, int row, int col, const std::string& text);
+  void add_number_cell(Wt::WTable* table, int row, int col, const typed_column_t& column, size_t idx);
+  void add_currency_cell(Wt::WTable* table, int row, int col, const typed_column_t& column, size_t idx, const std::string& suffix = "");
+  void add_percent_cell(Wt::WTable* table, int row, int col, const typed_column_t& column, size_t idx);
+  void add_styled_cell(Wt::WTable* table, int row, int col, const std::string& text, const Wt::WColor& color);
 
   std::string format_number(double value);
   std::string format_currency(double value, const std::string& suffix = "");